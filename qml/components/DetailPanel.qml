@@ -39,6 +39,17 @@ Rectangle {
         }
     }
     
+    // 批量标签操作只发出一次合并通知
+    Connections {
+        target: TagManager
+        
+        function onFilesTagsChanged(changedFileIds) {
+            if (currentFileId && changedFileIds.indexOf(currentFileId) !== -1) {
+                updateTags()
+            }
+        }
+    }
+    
     // 监听组件创建完成
     Component.onCompleted: {
         updateTags()
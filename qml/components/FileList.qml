@@ -41,6 +41,20 @@ Item {
         id: settings
     }
     
+    // 图标大小以模型为准，设置页修改后立即生效；模型按它与预览质量选择缩略图层级
+    readonly property var fileModel: fileManager ? fileManager.fileModel : null
+    readonly property int iconSize: fileModel ? fileModel.iconSize : settings.iconSize
+    
+    Component.onCompleted: syncPreviewSettings()
+    onFileModelChanged: syncPreviewSettings()
+    
+    function syncPreviewSettings() {
+        if (fileModel) {
+            fileModel.iconSize = settings.iconSize
+            fileModel.previewQuality = settings.previewQuality
+        }
+    }
+    
     Rectangle {
         id: mainContainer
         anchors.fill: parent
@@ -57,18 +71,41 @@ Item {
             cellWidth: {
                 if (!model || model.viewMode !== FileListModel.LargeIconView) 
                     return width
-                return settings.iconSize + 20  // 添加边距
+                return root.iconSize + 20  // 添加边距
             }
             
             cellHeight: {
                 if (!model || model.viewMode !== FileListModel.LargeIconView) 
                     return 40
-                return settings.iconSize + 40  // 为文件名预留空间
+                return root.iconSize + 40  // 为文件名预留空间
             }
             
             ScrollBar.vertical: verticalScrollBar
             ScrollBar.horizontal: horizontalScrollBar
             
+            // 可见范围变化后稍作合并再通知预览调度器，滚动过程中不逐帧提交
+            onContentYChanged: previewViewportTimer.restart()
+            onHeightChanged: previewViewportTimer.restart()
+            onWidthChanged: previewViewportTimer.restart()
+            onCountChanged: previewViewportTimer.restart()
+            onCellHeightChanged: previewViewportTimer.restart()
+            
+            Timer {
+                id: previewViewportTimer
+                interval: 50
+                onTriggered: gridView.reportVisibleRows()
+            }
+            
+            function reportVisibleRows() {
+                if (!root.fileManager || !model || model.viewMode !== FileListModel.LargeIconView || count === 0)
+                    return
+                let first = indexAt(contentX + 1, contentY + 1)
+                let last = indexAt(contentX + width - 1, contentY + height - 1)
+                if (first < 0) first = 0
+                if (last < 0) last = Math.min(count - 1, first + Math.ceil(height / cellHeight + 1) * Math.max(1, Math.floor(width / cellWidth)))
+                root.fileManager.updateVisiblePreviews(first, last)
+            }
+            
             delegate: ItemDelegate {
                 id: delegateItem
                 width: gridView.cellWidth
@@ -85,6 +122,7 @@ Item {
                 required property string previewPath
                 required property bool previewLoading
                 required property string fileId
+                required property string placeholder
                 
                 contentItem: Loader {
                     sourceComponent: gridView.model && 
@@ -146,24 +184,40 @@ Item {
                         
                         Item {
                             Layout.fillWidth: true
-                            Layout.preferredHeight: settings.iconSize
+                            Layout.preferredHeight: root.iconSize
                             Layout.alignment: Qt.AlignHCenter
                             
+                            // 低清占位图，缩略图就绪前垫在下面
+                            Image {
+                                id: placeholderImage
+                                anchors.centerIn: parent
+                                width: root.iconSize
+                                height: root.iconSize
+                                fillMode: Image.PreserveAspectFit
+                                smooth: true
+                                source: delegateItem.placeholder
+                                visible: delegateItem.placeholder !== "" && previewImage.status !== Image.Ready
+                            }
+                            
                             Image {
                                 id: previewImage
                                 anchors.centerIn: parent
-                                width: settings.iconSize
-                                height: settings.iconSize
+                                width: root.iconSize
+                                height: root.iconSize
                                 fillMode: Image.PreserveAspectFit
                                 asynchronous: true
                                 cache: true
                                 
                                 property string currentSource: {
+                                    // 有占位图时生成和读取期间都显示占位图
                                     if (delegateItem.previewLoading) {
-                                        return "qrc:/resources/images/loading.svg";
+                                        return delegateItem.placeholder !== "" ? "" : "qrc:/resources/images/loading.svg";
                                     }
                                     if (delegateItem.previewPath && delegateItem.previewPath !== "") {
-                                        return "file:///" + delegateItem.previewPath;
+                                        return delegateItem.previewPath;
+                                    }
+                                    if (delegateItem.placeholder !== "") {
+                                        return "";
                                     }
                                     return getFileIcon(delegateItem);
                                 }
@@ -449,6 +503,101 @@ Item {
                         }
                     }
                     
+                    MenuItem {
+                        id: similarMenuItem
+                        text: isVideo ? qsTr("查找相似视频") : qsTr("查找相似图片")
+                        icon.source: "qrc:/resources/images/search.svg"
+                        icon.width: 14
+                        icon.height: 14
+                        
+                        background: Rectangle {
+                            implicitWidth: 180
+                            implicitHeight: 28
+                            color: "transparent"
+                        }
+                        
+                        contentItem: RowLayout {
+                            spacing: 6
+                            Image {
+                                source: similarMenuItem.icon.source
+                                sourceSize.width: similarMenuItem.icon.width
+                                sourceSize.height: similarMenuItem.icon.height
+                                Layout.alignment: Qt.AlignVCenter
+                            }
+                            Text {
+                                text: similarMenuItem.text
+                                color: similarMenuItem.enabled ? "#000000" : "#999999"
+                                font.family: "Microsoft YaHei"
+                                font.pixelSize: 12
+                                Layout.fillWidth: true
+                                Layout.alignment: Qt.AlignVCenter
+                                Layout.leftMargin: 2
+                            }
+                        }
+                        
+                        readonly property bool isVideo: !!delegateItem.fileType &&
+                            settings.videoFilter.includes(String(delegateItem.fileType).toLowerCase())
+                        
+                        enabled: {
+                            if (!delegateItem.fileId || !delegateItem.fileType) return false
+                            const type = String(delegateItem.fileType).toLowerCase()
+                            return settings.imageFilter.includes(type) || settings.videoFilter.includes(type)
+                        }
+                        
+                        onTriggered: {
+                            Utils.Logger.logOperation(fileManager, similarMenuItem.text, delegateItem.fileName)
+                            // 结果中保留当前文件，便于对照
+                            const similar = SimilarityIndex.findSimilar(delegateItem.fileId)
+                            root.setFilterByFileIds([delegateItem.fileId].concat(similar))
+                        }
+                    }
+                    
+                    MenuItem {
+                        id: duplicateVideosMenuItem
+                        text: qsTr("查找所有重复视频")
+                        icon.source: "qrc:/resources/images/search.svg"
+                        icon.width: 14
+                        icon.height: 14
+                        visible: similarMenuItem.isVideo
+                        height: visible ? implicitHeight : 0
+                        
+                        background: Rectangle {
+                            implicitWidth: 180
+                            implicitHeight: 28
+                            color: "transparent"
+                        }
+                        
+                        contentItem: RowLayout {
+                            spacing: 6
+                            Image {
+                                source: duplicateVideosMenuItem.icon.source
+                                sourceSize.width: duplicateVideosMenuItem.icon.width
+                                sourceSize.height: duplicateVideosMenuItem.icon.height
+                                Layout.alignment: Qt.AlignVCenter
+                            }
+                            Text {
+                                text: duplicateVideosMenuItem.text
+                                color: duplicateVideosMenuItem.enabled ? "#000000" : "#999999"
+                                font.family: "Microsoft YaHei"
+                                font.pixelSize: 12
+                                Layout.fillWidth: true
+                                Layout.alignment: Qt.AlignVCenter
+                                Layout.leftMargin: 2
+                            }
+                        }
+                        
+                        onTriggered: {
+                            Utils.Logger.logOperation(fileManager, duplicateVideosMenuItem.text, delegateItem.fileName)
+                            // 各组按大小降序依次排列，只显示有重复的视频
+                            const groups = SimilarityIndex.duplicateVideoGroups()
+                            let fileIds = []
+                            for (const group of groups) {
+                                fileIds = fileIds.concat(group)
+                            }
+                            root.setFilterByFileIds(fileIds)
+                        }
+                    }
+                    
                     MenuItem {
                         id: showInFolderMenuItem
                         text: qsTr("在文件夹中显示")
@@ -795,6 +944,10 @@ Item {
                 Utils.Logger.logOperation(fileManager, "视图模式变更", 
                     model.viewMode === FileListModel.ListView ? "列表视图" : "大图标视图")
             }
+            previewViewportTimer.restart()
+        }
+        function onModelReset() {
+            previewViewportTimer.restart()
         }
     }
     
@@ -26,7 +26,7 @@ Settings {
     property string fileFilter: ""   // 文件筛选器设置
 
     // 设置文件格式
-    property var imageFilter: ["jpg", "jpeg", "png", "gif", "bmp", "webp", "tiff", "svg", "ico"]  // 图片文件格式
+    property var imageFilter: ["jpg", "jpeg", "png", "gif", "bmp", "webp", "tiff", "svg", "ico", "cr2", "nef", "arw", "dng"]  // 图片文件格式
     property var videoFilter: ["mp4", "avi", "mkv", "mov", "wmv", "flv", "webm", "m4v", "mpg", "mpeg"]  // 视频文件格式
     property var audioFilter: ["mp3", "wav", "flac", "m4a", "aac", "ogg", "wma"]  // 音频文件格式
     property var documentFilter: ["txt", "doc", "docx", "pdf", "xls", "xlsx", "ppt", "pptx", "md"]  // 文档文件格式
@@ -2,6 +2,7 @@ import QtQuick
 import QtQuick.Controls.Basic
 import QtQuick.Layouts
 import FileManager 1.0
+import "../dialogs" as Dialogs
 import ".." 1.0
 
 Rectangle {
@@ -20,6 +21,8 @@ Rectangle {
     // 内部属性
     property var selectedTagIds: []
     property var tagList: TagManager.getAllTags()
+    // 当前选中的智能文件夹，-1 表示未选中
+    property int activeFolderId: -1
 
     // 添加 fileList 属性声明
     required property var fileList
@@ -39,6 +42,62 @@ Rectangle {
         }
         spacing: 8
 
+        // 智能文件夹，数量来自物化的结果集
+        Row {
+            spacing: 4
+            Layout.fillHeight: true
+            visible: SmartFolderManager.folders.length > 0
+
+            Repeater {
+                model: SmartFolderManager.folders
+
+                Rectangle {
+                    property bool active: root.activeFolderId === modelData.id
+
+                    width: folderLabel.width + 16
+                    height: parent.height - 4
+                    anchors.verticalCenter: parent.verticalCenter
+                    radius: height / 6
+                    color: active ? Style.accentColor :
+                           folderMouseArea.containsMouse ? Style.hoverColor : Style.backgroundColor
+                    border.color: active ? Style.accentColor : Style.borderColor
+                    border.width: 1
+
+                    Label {
+                        id: folderLabel
+                        anchors.centerIn: parent
+                        text: modelData.name + " (" + modelData.count + ")"
+                        font.family: Style.fontFamily
+                        font.pixelSize: Style.fontSizeNormal - 1
+                        color: parent.active ? "white" : Style.textColor
+                    }
+
+                    ToolTip {
+                        visible: folderMouseArea.containsMouse
+                        text: qsTr("右键编辑")
+                        delay: 800
+                    }
+
+                    MouseArea {
+                        id: folderMouseArea
+                        anchors.fill: parent
+                        hoverEnabled: true
+                        cursorShape: Qt.PointingHandCursor
+                        acceptedButtons: Qt.LeftButton | Qt.RightButton
+                        onClicked: function(mouse) {
+                            // 右键打开编辑对话框
+                            if (mouse.button === Qt.RightButton) {
+                                smartFolderDialog.openFor(modelData)
+                                return
+                            }
+                            root.activeFolderId = parent.active ? -1 : modelData.id
+                            updateFileFilter()
+                        }
+                    }
+                }
+            }
+        }
+
         // 标签水平滚动区域
         ScrollView {
             Layout.fillWidth: true
@@ -164,7 +223,7 @@ Rectangle {
                 icon.width: 14
                 icon.height: 14
                 padding: 6
-                visible: root.selectedTagIds.length > 0
+                visible: root.selectedTagIds.length > 0 || root.activeFolderId !== -1
                 
                 ToolTip {
                     visible: parent.hovered
@@ -185,10 +244,39 @@ Rectangle {
 
                 onClicked: {
                     root.selectedTagIds = []
+                    root.activeFolderId = -1
                     updateFileFilter()
                 }
             }
 
+            // 新建智能文件夹按钮
+            Button {
+                id: newFolderButton
+                icon.source: "qrc:/resources/images/add.svg"
+                icon.width: 14
+                icon.height: 14
+                padding: 6
+
+                ToolTip {
+                    visible: parent.hovered
+                    text: "新建智能文件夹"
+                    delay: 500
+                }
+
+                background: Rectangle {
+                    implicitWidth: 32
+                    implicitHeight: 28
+                    color: newFolderButton.down ? Qt.darker(Style.backgroundColor, 1.1) :
+                           newFolderButton.hovered ? Style.hoverColor : Style.backgroundColor
+                    border.color: newFolderButton.down ? Style.accentColor :
+                                newFolderButton.hovered ? Style.accentColor : Style.borderColor
+                    border.width: 1
+                    radius: 3
+                }
+
+                onClicked: smartFolderDialog.openFor(null)
+            }
+
             // 标签管理按钮
             Button {
                 id: tagManageButton
@@ -236,42 +324,65 @@ Rectangle {
         }
     }
 
+    // 智能文件夹的新建、编辑与删除，显示在窗口中央
+    Dialogs.SmartFolderDialog {
+        id: smartFolderDialog
+        parent: Overlay.overlay
+
+        onFolderSaved: function(id) {
+            if (id === root.activeFolderId) {
+                updateFileFilter()
+            }
+        }
+    }
+
     // 更新文件过滤器
     function updateFileFilter() {
+        // 选中的智能文件夹优先，直接使用物化的结果集
+        if (root.activeFolderId !== -1) {
+            root.fileList.setFilterByFileIds(SmartFolderManager.folderFiles(root.activeFolderId))
+            return
+        }
+        
         if (root.selectedTagIds.length === 0) {
             root.fileList.clearFilter()
             return
         }
         
-        let filteredFiles = new Set()
-        let isFirst = true
-        
+        // 选中的标签按 AND 组合，交给 TagManager 的查询规划器求值
+        let terms = []
         for (let tagId of root.selectedTagIds) {
-            let fileIds = TagManager.getFilesByTagId(tagId)
-            if (!fileIds) {
-                // 无法获取标签关联的文件ID
-                continue
-            }
-            
-            if (isFirst) {
-                fileIds.forEach(fileId => filteredFiles.add(fileId))
-                isFirst = false
-            } else {
-                let intersection = new Set()
-                fileIds.forEach(fileId => {
-                    if (filteredFiles.has(fileId)) {
-                        intersection.add(fileId)
-                    }
-                })
-                filteredFiles = intersection
+            let tag = TagManager.getTagById(tagId)
+            if (tag) {
+                terms.push('"' + tag.name.replace(/\\/g, '\\\\').replace(/"/g, '\\"') + '"')
             }
         }
         
-        if (filteredFiles.size === 0) {
-            // 没有找到匹配的文件
+        if (terms.length === 0) {
+            root.fileList.clearFilter()
+            return
         }
         
-        root.fileList.setFilterByFileIds(Array.from(filteredFiles))
+        root.fileList.setFilterByFileIds(TagManager.queryFiles(terms.join(" AND ")))
+    }
+
+    // 智能文件夹的结果变化时刷新筛选
+    Connections {
+        target: SmartFolderManager
+        
+        function onFolderCountChanged(folderId, count) {
+            if (folderId === root.activeFolderId) {
+                updateFileFilter()
+            }
+        }
+        
+        function onFoldersChanged() {
+            if (root.activeFolderId !== -1 &&
+                !SmartFolderManager.folders.some(folder => folder.id === root.activeFolderId)) {
+                root.activeFolderId = -1
+                updateFileFilter()
+            }
+        }
     }
 
     // 监听标签变化
@@ -24,6 +24,11 @@ Dialog {
         selectedTags = TagManager.getFileTagsById(fileId)
     }
     
+    // 已选标签变化后重新计算建议
+    onSelectedTagsChanged: {
+        suggestedTags = fileId ? TagManager.suggestTags(fileId, filePath) : []
+    }
+    
     // 窗口大小改变时保持居中
     Connections {
         target: parent
@@ -52,6 +57,7 @@ Dialog {
     property string fileId: ""
     property string filePath: ""
     property var selectedTags: []
+    property var suggestedTags: []
     
     // 背景设置
     background: Rectangle {
@@ -98,6 +104,62 @@ Dialog {
             color: Style.borderColor
         }
         
+        // 建议标签区域
+        ColumnLayout {
+            Layout.fillWidth: true
+            spacing: 8
+            visible: root.suggestedTags.length > 0
+            
+            Label {
+                text: qsTr("建议标签")
+                font {
+                    family: Style.fontFamily
+                    pixelSize: Style.fontSizeNormal
+                    bold: true
+                }
+                color: Style.textColor
+            }
+            
+            Flow {
+                Layout.fillWidth: true
+                spacing: 8
+                
+                Repeater {
+                    model: root.suggestedTags
+                    
+                    Rectangle {
+                        width: suggestionLabel.width + 24
+                        height: 28
+                        color: "transparent"
+                        radius: height / 2
+                        border.width: 1
+                        border.color: modelData.color
+                        opacity: suggestionMouseArea.containsMouse ? 1.0 : 0.8
+                        
+                        Label {
+                            id: suggestionLabel
+                            anchors.centerIn: parent
+                            text: "+ " + modelData.name
+                            color: modelData.color
+                            font.family: Style.fontFamily
+                            font.pixelSize: Style.fontSizeNormal
+                        }
+                        
+                        MouseArea {
+                            id: suggestionMouseArea
+                            anchors.fill: parent
+                            hoverEnabled: true
+                            cursorShape: Qt.PointingHandCursor
+                            onClicked: {
+                                root.addTag(modelData.id)
+                                root.tagsUpdated(fileId)
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        
         // 标签列表区域
         ColumnLayout {
             Layout.fillWidth: true
@@ -331,6 +393,13 @@ Dialog {
             }
         }
         
+        function onFilesTagsChanged(changedFileIds) {
+            if (changedFileIds.indexOf(fileId) !== -1) {
+                // 批量操作涉及当前文件时更新
+                selectedTags = TagManager.getFileTagsById(fileId)
+            }
+        }
+        
         function onTagError(message) {
             // 显示错误消息
             console.error(message)
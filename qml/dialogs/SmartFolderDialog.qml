@@ -0,0 +1,324 @@
+import QtQuick
+import QtQuick.Controls.Basic
+import QtQuick.Layouts
+import FileManager 1.0
+import ".." 1.0
+
+// 智能文件夹的新建、编辑与删除
+Dialog {
+    id: root
+    title: editMode ? qsTr("编辑智能文件夹") : qsTr("新建智能文件夹")
+    width: 420
+    height: 440
+    modal: true
+
+    // 在对话框打开时居中显示
+    onOpened: {
+        centerDialog()
+        nameField.forceActiveFocus()
+    }
+
+    // 窗口大小改变时保持居中
+    Connections {
+        target: parent
+        function onWidthChanged() {
+            centerDialog()
+        }
+        function onHeightChanged() {
+            centerDialog()
+        }
+    }
+
+    // 居中显示函数
+    function centerDialog() {
+        if (!parent) return
+
+        x = Math.max(0, (parent.width - width) / 2)
+        y = Math.max(0, (parent.height - height) / 2)
+    }
+
+    property bool editMode: false
+    property int folderId: -1
+
+    // 保存或删除成功后发出
+    signal folderSaved(int id)
+    signal folderRemoved(int id)
+
+    readonly property real bytesPerMb: 1024 * 1024
+
+    // folder 为 SmartFolderManager.folders 中的一项，为空时新建
+    function openFor(folder) {
+        editMode = !!folder
+        folderId = folder ? folder.id : -1
+        nameField.text = folder ? folder.name : ""
+        queryField.text = folder ? folder.tagQuery : ""
+        minSizeField.text = folder && folder.minSize >= 0 ? String(folder.minSize / bytesPerMb) : ""
+        maxSizeField.text = folder && folder.maxSize >= 0 ? String(folder.maxSize / bytesPerMb) : ""
+        daysField.text = folder && folder.modifiedWithinDays >= 0 ? String(folder.modifiedWithinDays) : ""
+        extensionsField.text = folder ? folder.extensions.join(", ") : ""
+        errorLabel.visible = false
+        open()
+    }
+
+    // 背景设置
+    background: Rectangle {
+        color: Style.backgroundColor
+        border.color: Style.borderColor
+        border.width: 1
+        radius: 6
+    }
+
+    // 输入框的统一样式
+    component FolderField: TextField {
+        id: field
+        Layout.fillWidth: true
+        selectByMouse: true
+        font.family: Style.fontFamily
+        font.pixelSize: Style.fontSizeNormal
+        color: Style.textColor
+
+        background: Rectangle {
+            implicitHeight: 32
+            color: Style.backgroundColor
+            border.color: field.activeFocus ? Style.accentColor : Style.borderColor
+            border.width: field.activeFocus ? 2 : 1
+            radius: 4
+        }
+    }
+
+    component FieldLabel: Label {
+        font {
+            family: Style.fontFamily
+            pixelSize: Style.fontSizeNormal
+            bold: true
+        }
+        color: Style.textColor
+    }
+
+    ColumnLayout {
+        anchors.fill: parent
+        anchors.margins: 16
+        spacing: 10
+
+        FieldLabel { text: qsTr("名称") }
+        FolderField {
+            id: nameField
+            placeholderText: qsTr("输入智能文件夹名称")
+        }
+
+        FieldLabel { text: qsTr("标签条件") }
+        FolderField {
+            id: queryField
+            placeholderText: qsTr("如 (holiday OR travel) AND NOT blurry，留空不按标签筛选")
+        }
+
+        FieldLabel { text: qsTr("文件大小 (MB)") }
+        RowLayout {
+            Layout.fillWidth: true
+            spacing: 8
+
+            FolderField {
+                id: minSizeField
+                placeholderText: qsTr("最小")
+                validator: DoubleValidator { bottom: 0 }
+            }
+            Label {
+                text: "-"
+                color: Style.textColor
+            }
+            FolderField {
+                id: maxSizeField
+                placeholderText: qsTr("最大")
+                validator: DoubleValidator { bottom: 0 }
+            }
+        }
+
+        FieldLabel { text: qsTr("最近修改天数") }
+        FolderField {
+            id: daysField
+            placeholderText: qsTr("留空不限")
+            validator: IntValidator { bottom: 0 }
+        }
+
+        FieldLabel { text: qsTr("扩展名") }
+        FolderField {
+            id: extensionsField
+            placeholderText: qsTr("如 jpg, png，留空不限")
+        }
+
+        // 错误提示标签
+        Label {
+            id: errorLabel
+            visible: false
+            color: "#dc3545"
+            font.pixelSize: Style.fontSizeNormal - 1
+            Layout.fillWidth: true
+            wrapMode: Text.WordWrap
+        }
+
+        Item { Layout.fillHeight: true }
+
+        // 按钮区域
+        RowLayout {
+            Layout.fillWidth: true
+            spacing: 8
+
+            Button {
+                text: qsTr("删除")
+                padding: 8
+                visible: root.editMode
+
+                background: Rectangle {
+                    implicitWidth: 80
+                    implicitHeight: 32
+                    color: parent.down ? Qt.darker("#dc3545", 1.1) :
+                           parent.hovered ? Qt.lighter("#dc3545", 1.1) : "#dc3545"
+                    border.width: 0
+                    radius: 4
+                }
+
+                contentItem: Label {
+                    text: parent.text
+                    font.family: Style.fontFamily
+                    font.pixelSize: Style.fontSizeNormal
+                    color: "white"
+                    horizontalAlignment: Text.AlignHCenter
+                }
+
+                onClicked: deleteConfirmDialog.open()
+            }
+
+            Item { Layout.fillWidth: true }
+
+            Button {
+                text: qsTr("取消")
+                padding: 8
+
+                background: Rectangle {
+                    implicitWidth: 80
+                    implicitHeight: 32
+                    color: parent.down ? Qt.darker(Style.backgroundColor, 1.1) :
+                           parent.hovered ? Style.hoverColor : Style.backgroundColor
+                    border.color: parent.down ? Style.accentColor :
+                                parent.hovered ? Style.accentColor : Style.borderColor
+                    border.width: 1
+                    radius: 4
+                }
+
+                contentItem: Label {
+                    text: parent.text
+                    font.family: Style.fontFamily
+                    font.pixelSize: Style.fontSizeNormal
+                    color: Style.textColor
+                    horizontalAlignment: Text.AlignHCenter
+                }
+
+                onClicked: root.reject()
+            }
+
+            Button {
+                text: qsTr("保存")
+                padding: 8
+
+                background: Rectangle {
+                    implicitWidth: 80
+                    implicitHeight: 32
+                    color: parent.down ? Qt.darker(Style.accentColor, 1.1) :
+                           parent.hovered ? Qt.lighter(Style.accentColor, 1.1) : Style.accentColor
+                    border.width: 0
+                    radius: 4
+                }
+
+                contentItem: Label {
+                    text: parent.text
+                    font.family: Style.fontFamily
+                    font.pixelSize: Style.fontSizeNormal
+                    color: "white"
+                    horizontalAlignment: Text.AlignHCenter
+                }
+
+                onClicked: validateAndSave()
+            }
+        }
+    }
+
+    // 删除确认
+    Dialog {
+        id: deleteConfirmDialog
+        title: qsTr("删除智能文件夹")
+        modal: true
+        anchors.centerIn: parent
+        standardButtons: Dialog.Yes | Dialog.No
+
+        Label {
+            text: qsTr("确定删除“%1”吗？文件和标签不受影响。").arg(nameField.text)
+            font.family: Style.fontFamily
+            font.pixelSize: Style.fontSizeNormal
+            color: Style.textColor
+        }
+
+        onAccepted: {
+            if (SmartFolderManager.removeFolder(root.folderId)) {
+                root.folderRemoved(root.folderId)
+                root.accept()
+            }
+        }
+    }
+
+    // 保存或删除失败的原因来自管理器，格式为 "系统|智能文件夹|<操作>|<原因>"
+    Connections {
+        target: SmartFolderManager
+        enabled: root.opened
+
+        function onFolderError(message) {
+            let parts = message.split("|")
+            showError(parts.length > 3 ? parts[2] + ": " + parts.slice(3).join("|") : message)
+        }
+    }
+
+    // 未填写的条件传 -1 或空
+    function sizeBytes(text) {
+        return text.trim() === "" ? -1 : Math.round(Number(text) * bytesPerMb)
+    }
+
+    function validateAndSave() {
+        errorLabel.visible = false
+
+        const name = nameField.text.trim()
+        if (!name) {
+            showError(qsTr("名称不能为空"))
+            return
+        }
+
+        const minSize = sizeBytes(minSizeField.text)
+        const maxSize = sizeBytes(maxSizeField.text)
+        if (minSize >= 0 && maxSize >= 0 && minSize > maxSize) {
+            showError(qsTr("最小文件大小不能超过最大文件大小"))
+            return
+        }
+        const days = daysField.text.trim() === "" ? -1 : parseInt(daysField.text)
+        const extensions = extensionsField.text.split(/[,，\s]+/).filter(extension => extension.length > 0)
+
+        if (editMode) {
+            if (!SmartFolderManager.updateFolder(folderId, name, queryField.text, minSize, maxSize,
+                                                 days, extensions)) {
+                return
+            }
+            folderSaved(folderId)
+        } else {
+            const id = SmartFolderManager.createFolder(name, queryField.text, minSize, maxSize,
+                                                       days, extensions)
+            if (id < 0) {
+                return
+            }
+            folderSaved(id)
+        }
+
+        root.accept()
+    }
+
+    function showError(message) {
+        errorLabel.text = message
+        errorLabel.visible = true
+    }
+}
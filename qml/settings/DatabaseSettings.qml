@@ -1,6 +1,7 @@
 import QtQuick
 import QtQuick.Controls.Basic
 import QtQuick.Layouts
+import QtQuick.Dialogs
 import FileManager 1.0
 
 ColumnLayout {
@@ -46,79 +47,65 @@ ColumnLayout {
         Layout.topMargin: settingsStyle.defaultItemSpacing
         spacing: 8
         
-        Button {
+        DatabaseToolButton {
+            style: settingsStyle
             text: qsTr("备份数据库")
             icon.source: "qrc:/resources/images/backup.svg"
-            icon.width: 14
-            icon.height: 14
-            
-            background: Rectangle {
-                implicitWidth: 100
-                implicitHeight: settingsStyle.defaultButtonHeight
-                color: parent.down ? settingsStyle.defaultButtonPressedColor :
-                       parent.hovered ? settingsStyle.defaultButtonHoverColor :
-                       settingsStyle.defaultButtonNormalColor
-                border.color: parent.down ? settingsStyle.defaultButtonPressedBorderColor :
-                            parent.hovered ? settingsStyle.defaultButtonHoverBorderColor :
-                            settingsStyle.defaultButtonNormalBorderColor
-                border.width: 1
-                radius: settingsStyle.defaultRadius
+            onClicked: {
+                fileDialog.operation = DatabaseBackup.Backup
+                fileDialog.open()
             }
-            
-            contentItem: RowLayout {
-                spacing: 4
-                Image {
-                    source: parent.parent.icon.source
-                    sourceSize.width: parent.parent.icon.width
-                    sourceSize.height: parent.parent.icon.height
-                }
-                Label {
-                    text: parent.parent.text
-                    font.family: settingsStyle.defaultFontFamily
-                    font.pixelSize: settingsStyle.defaultFontSize
-                    color: settingsStyle.defaultTextColor
-                }
+        }
+        
+        DatabaseToolButton {
+            style: settingsStyle
+            text: qsTr("导出标签")
+            icon.source: "qrc:/resources/images/backup.svg"
+            onClicked: {
+                fileDialog.operation = DatabaseBackup.Export
+                fileDialog.open()
             }
         }
         
-        Button {
-            text: qsTr("恢复数据库")
+        DatabaseToolButton {
+            style: settingsStyle
+            text: qsTr("导入标签")
             icon.source: "qrc:/resources/images/restore.svg"
-            icon.width: 14
-            icon.height: 14
-            
-            background: Rectangle {
-                implicitWidth: 100
-                implicitHeight: settingsStyle.defaultButtonHeight
-                color: parent.down ? settingsStyle.defaultButtonPressedColor :
-                       parent.hovered ? settingsStyle.defaultButtonHoverColor :
-                       settingsStyle.defaultButtonNormalColor
-                border.color: parent.down ? settingsStyle.defaultButtonPressedBorderColor :
-                            parent.hovered ? settingsStyle.defaultButtonHoverBorderColor :
-                            settingsStyle.defaultButtonNormalBorderColor
-                border.width: 1
-                radius: settingsStyle.defaultRadius
-            }
-            
-            contentItem: RowLayout {
-                spacing: 4
-                Image {
-                    source: parent.parent.icon.source
-                    sourceSize.width: parent.parent.icon.width
-                    sourceSize.height: parent.parent.icon.height
-                }
-                Label {
-                    text: parent.parent.text
-                    font.family: settingsStyle.defaultFontFamily
-                    font.pixelSize: settingsStyle.defaultFontSize
-                    color: settingsStyle.defaultTextColor
-                }
+            onClicked: {
+                fileDialog.operation = DatabaseBackup.Import
+                fileDialog.open()
             }
         }
         
         Item { Layout.fillWidth: true }
     }
     
+    // 操作状态
+    RowLayout {
+        Layout.fillWidth: true
+        spacing: 8
+        visible: databaseBackup.busy || statusLabel.text !== ""
+        
+        ProgressBar {
+            id: progressBar
+            visible: databaseBackup.busy
+            indeterminate: to <= 0
+            from: 0
+            to: 0
+            value: 0
+            Layout.preferredWidth: 160
+        }
+        
+        Label {
+            id: statusLabel
+            font.family: settingsStyle.defaultFontFamily
+            font.pixelSize: settingsStyle.descriptionFontSize
+            color: settingsStyle.defaultSecondaryTextColor
+            elide: Text.ElideRight
+            Layout.fillWidth: true
+        }
+    }
+    
     // 标签页
     TabBar {
         id: tabBar
@@ -175,6 +162,7 @@ ColumnLayout {
         
         // 标签列表
         ListView {
+            id: tagListView
             model: TagManager.getAllTags()
             clip: true
             
@@ -222,6 +210,7 @@ ColumnLayout {
         
         // 统计视图
         ListView {
+            id: statsListView
             model: TagManager.getTagStats()
             clip: true
             
@@ -264,6 +253,7 @@ ColumnLayout {
         
         // 最近文件视图
         ListView {
+            id: recentListView
             model: TagManager.getRecentFiles(10)
             clip: true
             
@@ -292,4 +282,135 @@ ColumnLayout {
             }
         }
     }
-} 
\ No newline at end of file
+    
+    function refreshViews() {
+        tagListView.model = TagManager.getAllTags()
+        statsListView.model = TagManager.getTagStats()
+        recentListView.model = TagManager.getRecentFiles(10)
+    }
+    
+    function operationName(operation) {
+        switch (operation) {
+        case DatabaseBackup.Backup: return qsTr("备份")
+        case DatabaseBackup.Export: return qsTr("导出")
+        default: return qsTr("导入")
+        }
+    }
+    
+    DatabaseBackup {
+        id: databaseBackup
+        
+        onProgressChanged: function(done, total) {
+            progressBar.to = total
+            progressBar.value = done
+        }
+        
+        onFinished: function(operation, success, message) {
+            if (success) {
+                statusLabel.text = qsTr("%1完成").arg(root.operationName(operation))
+                if (operation === DatabaseBackup.Import) {
+                    root.refreshViews()
+                }
+            } else {
+                statusLabel.text = qsTr("%1失败").arg(root.operationName(operation))
+                errorDialog.text = message
+                errorDialog.open()
+            }
+        }
+    }
+    
+    // 文件选择对话框，备份与导出选择保存位置，导入选择已导出的文件
+    FileDialog {
+        id: fileDialog
+        
+        property int operation: DatabaseBackup.Backup
+        
+        title: operation === DatabaseBackup.Backup ? qsTr("备份数据库到") :
+               operation === DatabaseBackup.Export ? qsTr("导出标签到") :
+               qsTr("选择要导入的标签文件")
+        fileMode: operation === DatabaseBackup.Import ? FileDialog.OpenFile : FileDialog.SaveFile
+        nameFilters: operation === DatabaseBackup.Backup ? [qsTr("数据库文件 (*.db)")] :
+                     [qsTr("标签文件 (*.ftag)")]
+        defaultSuffix: operation === DatabaseBackup.Backup ? "db" : "ftag"
+        
+        onAccepted: {
+            let path = selectedFile.toString().replace(/^(file:\/{3})/,"")
+            path = decodeURIComponent(path)
+            if (Qt.platform.os === "windows") {
+                path = path.replace(/\//g, "\\")
+            }
+            
+            progressBar.to = 0
+            progressBar.value = 0
+            let started = false
+            if (operation === DatabaseBackup.Backup) {
+                started = databaseBackup.backupTo(path)
+            } else if (operation === DatabaseBackup.Export) {
+                started = databaseBackup.exportTo(path)
+            } else {
+                started = databaseBackup.importFrom(path)
+            }
+            statusLabel.text = started ? qsTr("正在%1…").arg(root.operationName(operation)) :
+                                         qsTr("已有操作正在进行")
+        }
+    }
+    
+    // 错误提示对话框
+    Dialog {
+        id: errorDialog
+        title: qsTr("错误")
+        modal: true
+        anchors.centerIn: parent
+        
+        property alias text: messageLabel.text
+        
+        Label {
+            id: messageLabel
+            width: parent.width
+            wrapMode: Text.Wrap
+            font.family: settingsStyle.defaultFontFamily
+            font.pixelSize: settingsStyle.defaultFontSize
+            color: settingsStyle.defaultTextColor
+        }
+        
+        standardButtons: Dialog.Ok
+    }
+    
+    // 工具栏按钮
+    component DatabaseToolButton: Button {
+        id: toolButton
+        
+        // 内联组件不共享外层作用域，样式由使用处传入
+        property SettingsStyle style
+        icon.width: 14
+        icon.height: 14
+        
+        background: Rectangle {
+            implicitWidth: 100
+            implicitHeight: style.defaultButtonHeight
+            color: toolButton.down ? style.defaultButtonPressedColor :
+                   toolButton.hovered ? style.defaultButtonHoverColor :
+                   style.defaultButtonNormalColor
+            border.color: toolButton.down ? style.defaultButtonPressedBorderColor :
+                        toolButton.hovered ? style.defaultButtonHoverBorderColor :
+                        style.defaultButtonNormalBorderColor
+            border.width: 1
+            radius: style.defaultRadius
+        }
+        
+        contentItem: RowLayout {
+            spacing: 4
+            Image {
+                source: toolButton.icon.source
+                sourceSize.width: toolButton.icon.width
+                sourceSize.height: toolButton.icon.height
+            }
+            Label {
+                text: toolButton.text
+                font.family: style.defaultFontFamily
+                font.pixelSize: style.defaultFontSize
+                color: style.defaultTextColor
+            }
+        }
+    }
+}
@@ -0,0 +1,455 @@
+#include "databasebackup.h"
+#include "databasemanager.h"
+#include "tagmanager.h"
+
+// Qt Core
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QVector>
+#include <QtConcurrent>
+#include <functional>
+
+// Qt SQL
+#include <QSqlQuery>
+#include <QSqlError>
+
+namespace {
+
+const auto STREAM_VERSION = QDataStream::Qt_6_0;
+// 多行语句每块的行数，受 SQLite 默认 999 个绑定参数的限制
+const int ROWS_PER_STATEMENT = 400;
+
+struct TagRecord {
+    qint32 id = -1;
+    QString name;
+    QString color;
+    QString description;
+    qint32 parentId = -1;
+};
+
+// 按块执行多行语句，整块的 SQL 相同，由语句缓存复用
+QString execRows(int total, int rowsPerStatement,
+                 const std::function<QString(int count)> &buildSql,
+                 const std::function<void(SqlStatement &statement, int offset, int count)> &bind,
+                 const std::function<void(SqlStatement &statement)> &consume = nullptr)
+{
+    for (int offset = 0; offset < total; offset += rowsPerStatement) {
+        const int count = qMin(rowsPerStatement, total - offset);
+        SqlStatement statement = DatabaseManager::instance().statement(buildSql(count));
+        bind(statement, offset, count);
+        if (!statement.exec()) {
+            return statement.errorText();
+        }
+        if (consume) {
+            consume(statement);
+        }
+    }
+    return QString();
+}
+
+// 按名称合并标签：同名标签复用已有的ID，其余新建；新建标签的父子关系在全部建好后再设置
+QString importTags(QDataStream &in, QHash<qint32, int> *tagMap, QVector<TagRecord> *created)
+{
+    qint32 count = 0;
+    in >> count;
+    QVector<TagRecord> records;
+    records.reserve(qMax(count, 0));
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        TagRecord record;
+        in >> record.id >> record.name >> record.color >> record.description >> record.parentId;
+        records.append(record);
+    }
+    if (in.status() != QDataStream::Ok) {
+        return "标签数据不完整";
+    }
+
+    QHash<QString, int> existing;
+    SqlStatement names = DatabaseManager::instance().statement("SELECT id, name FROM tags");
+    if (!names.exec()) {
+        return names.errorText();
+    }
+    while (names.next()) {
+        existing.insert(names.stringAt(1), names.intAt(0));
+    }
+
+    for (const TagRecord &record : records) {
+        auto it = existing.constFind(record.name);
+        if (it != existing.cend()) {
+            tagMap->insert(record.id, it.value());
+            continue;
+        }
+
+        SqlStatement insert = DatabaseManager::instance().statement(
+            "INSERT INTO tags (name, color, description, created_at, updated_at) "
+            "VALUES (?, ?, ?, CURRENT_TIMESTAMP, CURRENT_TIMESTAMP)");
+        insert.bind(0, record.name).bind(1, record.color).bind(2, record.description);
+        if (!insert.exec()) {
+            return insert.errorText();
+        }
+        const int tagId = int(insert.lastInsertId());
+        tagMap->insert(record.id, tagId);
+        existing.insert(record.name, tagId);
+
+        TagRecord added = record;
+        added.id = tagId;
+        created->append(added);
+    }
+
+    // 只为新建的标签设置父标签，已有标签的层级保持不变；闭包表由触发器维护
+    for (const TagRecord &record : *created) {
+        auto parent = tagMap->constFind(record.parentId);
+        if (record.parentId < 0 || parent == tagMap->cend()) {
+            continue;
+        }
+        SqlStatement update = DatabaseManager::instance().statement(
+            "UPDATE tags SET parent_id = ? WHERE id = ?");
+        update.bind(0, parent.value()).bind(1, record.id);
+        if (!update.exec()) {
+            return update.errorText();
+        }
+    }
+    return QString();
+}
+
+QString importAssociations(const QByteArray &block, const QHash<qint32, int> &tagMap)
+{
+    QDataStream in(block);
+    in.setVersion(STREAM_VERSION);
+
+    qint32 fileCount = 0;
+    in >> fileCount;
+
+    QStringList identities;
+    QVector<QPair<int, int>> pairs;  // identities 中的下标, 本库标签ID
+    identities.reserve(qMax(fileCount, 0));
+    for (qint32 i = 0; i < fileCount && in.status() == QDataStream::Ok; ++i) {
+        QString identity;
+        quint16 tagCount = 0;
+        in >> identity >> tagCount;
+        const int fileIndex = identities.size();
+        identities.append(identity);
+        for (quint16 j = 0; j < tagCount; ++j) {
+            qint32 tagId = -1;
+            in >> tagId;
+            auto it = tagMap.constFind(tagId);
+            if (it != tagMap.cend()) {
+                pairs.append({fileIndex, it.value()});
+            }
+        }
+    }
+    if (in.status() != QDataStream::Ok) {
+        return "关联数据不完整";
+    }
+
+    auto bindIdentities = [&identities](SqlStatement &statement, int offset, int count) {
+        for (int i = 0; i < count; ++i) {
+            statement.bind(i, identities.at(offset + i));
+        }
+    };
+
+    QString error = execRows(identities.size(), ROWS_PER_STATEMENT * 2,
+        [](int count) {
+            return "INSERT OR IGNORE INTO files (identity) VALUES " + SqlStatement::placeholders(count, "(?)");
+        }, bindIdentities);
+    if (!error.isEmpty()) {
+        return error;
+    }
+
+    QHash<QString, qint64> fileIds;
+    fileIds.reserve(identities.size());
+    error = execRows(identities.size(), ROWS_PER_STATEMENT * 2,
+        [](int count) {
+            return "SELECT id, identity FROM files WHERE identity IN (" + SqlStatement::placeholders(count) + ")";
+        }, bindIdentities,
+        [&fileIds](SqlStatement &statement) {
+            while (statement.next()) {
+                fileIds.insert(statement.stringAt(1), statement.int64At(0));
+            }
+        });
+    if (!error.isEmpty()) {
+        return error;
+    }
+
+    // 已存在的关联被忽略，重复导入不会产生重复行
+    return execRows(pairs.size(), ROWS_PER_STATEMENT,
+        [](int count) {
+            return "INSERT OR IGNORE INTO file_tags (file_id, tag_id) VALUES " + SqlStatement::placeholders(count, "(?, ?)");
+        },
+        [&](SqlStatement &statement, int offset, int count) {
+            for (int i = 0; i < count; ++i) {
+                const auto &pair = pairs.at(offset + i);
+                statement.bind(i * 2, fileIds.value(identities.at(pair.first)));
+                statement.bind(i * 2 + 1, pair.second);
+            }
+        });
+}
+
+} // namespace
+
+DatabaseBackup::DatabaseBackup(QObject *parent)
+    : QObject(parent)
+    , m_watcher(new QFutureWatcher<QString>(this))
+    , m_operation(Backup)
+{
+    connect(m_watcher, &QFutureWatcher<QString>::finished, this, &DatabaseBackup::onTaskFinished);
+}
+
+DatabaseBackup::~DatabaseBackup()
+{
+    m_watcher->waitForFinished();
+}
+
+bool DatabaseBackup::isBusy() const
+{
+    return m_watcher->isRunning();
+}
+
+bool DatabaseBackup::backupTo(const QString &filePath)
+{
+    return start(Backup, filePath);
+}
+
+bool DatabaseBackup::exportTo(const QString &filePath)
+{
+    return start(Export, filePath);
+}
+
+bool DatabaseBackup::importFrom(const QString &filePath)
+{
+    return start(Import, filePath);
+}
+
+bool DatabaseBackup::start(Operation operation, const QString &filePath)
+{
+    if (isBusy()) {
+        return false;
+    }
+
+    m_operation = operation;
+    m_watcher->setFuture(QtConcurrent::run([this, operation, filePath]() {
+        QString error;
+        switch (operation) {
+            case Backup:
+                error = runBackup(filePath);
+                break;
+            case Export:
+                error = runExport(filePath);
+                break;
+            case Import:
+                error = runImport(filePath);
+                break;
+        }
+        // 线程池中的线程会被复用，用完即释放连接
+        DatabaseManager::instance().releaseThreadConnection();
+        return error;
+    }));
+    emit busyChanged();
+    return true;
+}
+
+void DatabaseBackup::onTaskFinished()
+{
+    const QString error = m_watcher->result();
+
+    // 导入直接写库，标签缓存与内存索引需要重新加载
+    if (m_operation == Import) {
+        TagManager::instance().reloadFromDatabase();
+    }
+
+    emit busyChanged();
+    emit finished(m_operation, error.isEmpty(), error);
+}
+
+QString DatabaseBackup::runBackup(const QString &filePath)
+{
+    QSqlDatabase db = DatabaseManager::instance().database();
+
+    // VACUUM INTO 要求目标文件不存在
+    if (QFile::exists(filePath) && !QFile::remove(filePath)) {
+        return QString("系统|数据库|备份失败|无法覆盖 %1").arg(filePath);
+    }
+
+    QSqlQuery query(db);
+    query.prepare("VACUUM INTO ?");
+    query.addBindValue(filePath);
+    if (!query.exec()) {
+        return QString("系统|数据库|备份失败|%1").arg(query.lastError().text());
+    }
+    return QString();
+}
+
+QString DatabaseBackup::runExport(const QString &filePath)
+{
+    QSqlDatabase db = DatabaseManager::instance().database();
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return QString("系统|数据库|导出失败|%1").arg(file.errorString());
+    }
+    QDataStream out(&file);
+    out.setVersion(STREAM_VERSION);
+    out << MAGIC << FORMAT_VERSION;
+
+    // 整个导出在一个读事务中进行，标签与关联来自同一快照
+    if (!db.transaction()) {
+        return QString("系统|数据库|导出失败|%1").arg(db.lastError().text());
+    }
+    auto fail = [&db](const QString &message) {
+        db.rollback();
+        return QString("系统|数据库|导出失败|%1").arg(message);
+    };
+
+    qint64 total = 0;
+    {
+        SqlStatement count = DatabaseManager::instance().statement("SELECT IFNULL(SUM(file_count), 0) FROM tag_usage");
+        if (count.exec() && count.next()) {
+            total = count.int64At(0);
+        }
+    }
+
+    {
+        SqlStatement tags = DatabaseManager::instance().statement(
+            "SELECT id, name, color, description, parent_id FROM tags ORDER BY id");
+        if (!tags.exec()) {
+            return fail(tags.errorText());
+        }
+        QVector<TagRecord> records;
+        while (tags.next()) {
+            TagRecord record;
+            record.id = tags.intAt(0);
+            record.name = tags.stringAt(1);
+            record.color = tags.stringAt(2);
+            record.description = tags.stringAt(3);
+            record.parentId = tags.isNull(4) ? -1 : tags.intAt(4);
+            records.append(record);
+        }
+        out << qint32(records.size());
+        for (const TagRecord &record : records) {
+            out << record.id << record.name << record.color << record.description << record.parentId;
+        }
+    }
+
+    // 按 file_id 顺序读取，同一文件的关联相邻，每个文件只写一次标识
+    SqlStatement rows = DatabaseManager::instance().statement(
+        "SELECT ft.file_id, f.identity, ft.tag_id "
+        "FROM file_tags ft JOIN files f ON f.id = ft.file_id "
+        "ORDER BY ft.file_id");
+    if (!rows.exec()) {
+        return fail(rows.errorText());
+    }
+
+    QVector<QPair<QString, QVector<qint32>>> files;
+    files.reserve(FILES_PER_BLOCK);
+    qint64 done = 0;
+
+    auto writeBlock = [&]() {
+        QByteArray data;
+        QDataStream blockOut(&data, QIODevice::WriteOnly);
+        blockOut.setVersion(STREAM_VERSION);
+        blockOut << qint32(files.size());
+        for (const auto &file : files) {
+            blockOut << file.first << quint16(file.second.size());
+            for (qint32 tagId : file.second) {
+                blockOut << tagId;
+                ++done;
+            }
+        }
+        const QByteArray compressed = qCompress(data);
+        out << quint32(compressed.size());
+        out.writeRawData(compressed.constData(), compressed.size());
+        files.clear();
+        emit progressChanged(done, total);
+    };
+
+    qint64 lastFileId = -1;
+    while (rows.next()) {
+        const qint64 fileId = rows.int64At(0);
+        if (fileId != lastFileId || files.last().second.size() == 0xFFFF) {
+            if (files.size() >= FILES_PER_BLOCK) {
+                writeBlock();
+            }
+            files.append({rows.stringAt(1), {}});
+            lastFileId = fileId;
+        }
+        files.last().second.append(rows.intAt(2));
+    }
+    if (!files.isEmpty()) {
+        writeBlock();
+    }
+    out << quint32(0);
+
+    db.commit();
+
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        return QString("系统|数据库|导出失败|%1").arg(file.errorString());
+    }
+    return QString();
+}
+
+QString DatabaseBackup::runImport(const QString &filePath)
+{
+    QSqlDatabase db = DatabaseManager::instance().database();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString("系统|数据库|导入失败|%1").arg(file.errorString());
+    }
+    QDataStream in(&file);
+    in.setVersion(STREAM_VERSION);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (magic != MAGIC || version != FORMAT_VERSION) {
+        return "系统|数据库|导入失败|文件格式不正确";
+    }
+
+    // 标签在一个事务中合并
+    QHash<qint32, int> tagMap;
+    QVector<TagRecord> created;
+    if (!db.transaction()) {
+        return QString("系统|数据库|导入失败|%1").arg(db.lastError().text());
+    }
+    QString error = importTags(in, &tagMap, &created);
+    if (!error.isEmpty() || !db.commit()) {
+        db.rollback();
+        return QString("系统|数据库|导入失败|%1").arg(error.isEmpty() ? db.lastError().text() : error);
+    }
+    for (const TagRecord &record : created) {
+        DatabaseManager::instance().indexTag(record.id, record.name, record.description);
+    }
+
+    // 关联逐块导入，每块一个事务；中途失败时已导入的块保留，重新导入会跳过它们
+    while (true) {
+        quint32 size = 0;
+        in >> size;
+        if (in.status() != QDataStream::Ok) {
+            return "系统|数据库|导入失败|文件不完整";
+        }
+        if (size == 0) {
+            break;
+        }
+
+        QByteArray compressed(int(size), Qt::Uninitialized);
+        if (in.readRawData(compressed.data(), int(size)) != int(size)) {
+            return "系统|数据库|导入失败|文件不完整";
+        }
+        const QByteArray block = qUncompress(compressed);
+        if (block.isEmpty()) {
+            return "系统|数据库|导入失败|数据块损坏";
+        }
+
+        if (!db.transaction()) {
+            return QString("系统|数据库|导入失败|%1").arg(db.lastError().text());
+        }
+        error = importAssociations(block, tagMap);
+        if (!error.isEmpty() || !db.commit()) {
+            db.rollback();
+            return QString("系统|数据库|导入失败|%1").arg(error.isEmpty() ? db.lastError().text() : error);
+        }
+        emit progressChanged(file.pos(), file.size());
+    }
+    return QString();
+}
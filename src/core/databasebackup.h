@@ -0,0 +1,63 @@
+#ifndef DATABASEBACKUP_H
+#define DATABASEBACKUP_H
+
+#include <QObject>
+#include <QString>
+#include <QFutureWatcher>
+
+// 数据库备份与标签导入导出，全部在后台线程中使用该线程自己的连接执行
+//
+// 热备份：VACUUM INTO 在一个读事务中把整个数据库写成新的文件。WAL 模式下读事务不阻塞写入，
+//   程序运行期间备份也得到一致的快照，界面线程和写线程都不等待。
+// 导出格式（QDataStream）：
+//   文件头  quint32 魔数 'FTAG'、quint16 版本
+//   标签    qint32 数量，逐个为 qint32 id、QString name、QString color、QString description、qint32 parentId
+//   关联    若干个数据块，每块为 quint32 压缩后长度 + qCompress 数据，长度为 0 表示结束；
+//           解压后为 qint32 文件数，逐个为 QString identity、quint16 标签数、qint32 标签id...
+// 导入时按名称合并标签，按文件标识合并文件，已有的关联保持不变，重复导入同一份文件结果不变。
+class DatabaseBackup : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool busy READ isBusy NOTIFY busyChanged)
+
+public:
+    enum Operation { Backup, Export, Import };
+    Q_ENUM(Operation)
+
+    explicit DatabaseBackup(QObject *parent = nullptr);
+    ~DatabaseBackup();
+
+    bool isBusy() const;
+
+    // 以下操作立即返回，完成后发出 finished；已有操作进行中时返回 false
+    Q_INVOKABLE bool backupTo(const QString &filePath);
+    Q_INVOKABLE bool exportTo(const QString &filePath);
+    Q_INVOKABLE bool importFrom(const QString &filePath);
+
+signals:
+    void busyChanged();
+    // 在后台线程中发出，done 与 total 的单位因操作而异（导出为关联数，导入为字节数）
+    void progressChanged(qint64 done, qint64 total);
+    void finished(DatabaseBackup::Operation operation, bool success, const QString &message);
+
+private slots:
+    void onTaskFinished();
+
+private:
+    bool start(Operation operation, const QString &filePath);
+
+    // 在后台线程执行，返回空字符串表示成功
+    QString runBackup(const QString &filePath);
+    QString runExport(const QString &filePath);
+    QString runImport(const QString &filePath);
+
+    QFutureWatcher<QString> *m_watcher;
+    Operation m_operation;
+
+    static const quint32 MAGIC = 0x46544147;  // 'FTAG'
+    static const quint16 FORMAT_VERSION = 1;
+    // 每个数据块包含的文件数
+    static const int FILES_PER_BLOCK = 20000;
+};
+
+#endif // DATABASEBACKUP_H
@@ -5,6 +5,8 @@
 #include <QDir>
 #include <QDebug>
 #include <QDateTime>
+#include <QStringList>
+#include <QThread>
 
 // Qt SQL
 #include <QSqlQuery>
@@ -13,6 +15,7 @@
 
 // Project includes
 #include "../utils/logger.h"
+#include "searchindex.h"
 
 DatabaseManager::DatabaseManager(QObject *parent)
     : QObject(parent)
@@ -45,15 +48,20 @@ bool DatabaseManager::initialize()
 
     m_db = QSqlDatabase::addDatabase("QSQLITE");
     m_db.setDatabaseName(dataPath + "/filetags.db");
+    m_db.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(BUSY_TIMEOUT_MS));
 
     if (!m_db.open()) {
         m_logger->error(QString("数据库连接失败: %1").arg(m_db.lastError().text()));
         return false;
     }
 
-    // 启用外键约束
-    QSqlQuery query(m_db);
-    query.exec("PRAGMA foreign_keys = ON");
+    // 启用外键约束、WAL 日志及缓存参数
+    if (!configureConnection(m_db)) {
+        m_logger->warning("数据库连接参数设置失败，继续使用默认参数");
+    }
+
+    // 全新的数据库直接建立最新结构，无需逐版本迁移
+    const bool freshDatabase = !m_db.tables().contains("settings");
 
     // 创建表结构
     if (!createTables()) {
@@ -61,15 +69,28 @@ bool DatabaseManager::initialize()
         return false;
     }
 
-    // 检查并执行数据库升级
-    int dbVersion = currentVersion();
-    if (dbVersion < CURRENT_DB_VERSION) {
-        m_logger->info(QString("数据库开始升级: 从 v%1 到 v%2").arg(dbVersion).arg(CURRENT_DB_VERSION));
-        if (!upgradeDatabase(dbVersion, CURRENT_DB_VERSION)) {
-            m_logger->error("数据库升级失败");
+    if (freshDatabase) {
+        if (!saveSchemaVersion(CURRENT_DB_VERSION)) {
+            m_logger->error("数据库版本写入失败");
             return false;
         }
-        m_logger->info("数据库升级完成");
+    } else {
+        // 检查并执行数据库升级
+        int dbVersion = currentVersion();
+        if (dbVersion < CURRENT_DB_VERSION) {
+            m_logger->info(QString("数据库开始升级: 从 v%1 到 v%2").arg(dbVersion).arg(CURRENT_DB_VERSION));
+            if (!upgradeDatabase(dbVersion, CURRENT_DB_VERSION)) {
+                m_logger->error("数据库升级失败");
+                return false;
+            }
+            m_logger->info("数据库升级完成");
+        }
+    }
+
+    // 索引与触发器依赖最新的表结构，升级完成后再创建
+    if (!createIndexes() || !createTriggers()) {
+        m_logger->error("数据库索引创建失败");
+        return false;
     }
 
     m_initialized = true;
@@ -77,11 +98,138 @@ bool DatabaseManager::initialize()
     return true;
 }
 
+bool DatabaseManager::configureConnection(QSqlDatabase &db) const
+{
+    QSqlQuery query(db);
+    bool success = true;
+
+    // journal_mode 返回实际生效的模式，网络盘等不支持 WAL 时会退回 delete
+    if (query.exec("PRAGMA journal_mode = WAL") && query.next()) {
+        success = query.value(0).toString().compare("wal", Qt::CaseInsensitive) == 0;
+    } else {
+        success = false;
+    }
+
+    const QStringList pragmas = {
+        "PRAGMA foreign_keys = ON",
+        "PRAGMA synchronous = NORMAL",
+        QString("PRAGMA cache_size = -%1").arg(CACHE_SIZE_KB),
+        QString("PRAGMA mmap_size = %1").arg(MMAP_SIZE_BYTES),
+        "PRAGMA temp_store = MEMORY"
+    };
+    for (const QString &pragma : pragmas) {
+        if (!query.exec(pragma)) {
+            success = false;
+        }
+    }
+    return success;
+}
+
+QString DatabaseManager::connectionName(QThread *thread)
+{
+    return QString("filetags_%1").arg(reinterpret_cast<quintptr>(thread), 0, 16);
+}
+
+QSqlDatabase DatabaseManager::database() const
+{
+    QThread *current = QThread::currentThread();
+    if (current == thread()) {
+        return m_db;
+    }
+    return threadConnection(current);
+}
+
+QSqlDatabase DatabaseManager::threadConnection(QThread *thread) const
+{
+    const QString name = connectionName(thread);
+
+    {
+        QMutexLocker locker(&m_poolMutex);
+        if (m_threadConnections.contains(thread)) {
+            return QSqlDatabase::database(name, false);
+        }
+    }
+
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+    db.setDatabaseName(m_db.databaseName());
+    db.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(BUSY_TIMEOUT_MS));
+
+    if (!db.open()) {
+        logError(QString("系统|数据库|线程连接失败|%1").arg(db.lastError().text()));
+        // 注销失败的连接，下次调用可以用同一个名字重新创建；注销前先释放本地引用
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(name);
+        return db;
+    }
+    configureConnection(db);
+
+    {
+        QMutexLocker locker(&m_poolMutex);
+        m_threadConnections.insert(thread, name);
+    }
+
+    // 线程结束时在其自身上下文中关闭连接
+    connect(thread, &QThread::finished, thread, [this, thread, name]() {
+        m_statements.localData().clear();
+        {
+            QSqlDatabase connection = QSqlDatabase::database(name, false);
+            connection.close();
+        }
+        QSqlDatabase::removeDatabase(name);
+        QMutexLocker locker(&m_poolMutex);
+        m_threadConnections.remove(thread);
+    }, Qt::DirectConnection);
+
+    QMetaObject::invokeMethod(m_logger, "debug", Qt::QueuedConnection,
+                              Q_ARG(QString, QString("系统|数据库|创建线程连接|%1").arg(name)));
+    return db;
+}
+
+void DatabaseManager::logError(const QString &message) const
+{
+    // 日志对象属于 GUI 线程，其他线程排队调用
+    if (QThread::currentThread() == thread()) {
+        m_logger->error(message);
+    } else {
+        QMetaObject::invokeMethod(m_logger, "error", Qt::QueuedConnection, Q_ARG(QString, message));
+    }
+}
+
+void DatabaseManager::releaseThreadConnection()
+{
+    QThread *current = QThread::currentThread();
+    if (current == thread()) {
+        return;
+    }
+
+    const QString name = connectionName(current);
+    {
+        QMutexLocker locker(&m_poolMutex);
+        if (!m_threadConnections.remove(current)) {
+            return;
+        }
+    }
+    m_statements.localData().clear();
+
+    {
+        QSqlDatabase connection = QSqlDatabase::database(name, false);
+        connection.close();
+    }
+    QSqlDatabase::removeDatabase(name);
+}
+
 bool DatabaseManager::createTables()
 {
     return createSettingsTable() &&
            createTagsTable() &&
-           createFileTagsTable();
+           createFilesTable() &&
+           createFileTagsTable() &&
+           createUsageTables() &&
+           createTagClosureTable() &&
+           createSearchTables() &&
+           createSmartFolderTables() &&
+           createImageHashTable() &&
+           createVideoFingerprintTable();
 }
 
 bool DatabaseManager::createSettingsTable()
@@ -113,7 +261,8 @@ bool DatabaseManager::createTagsTable()
         "    color TEXT,"
         "    description TEXT,"
         "    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
-        "    updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP"
+        "    updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
+        "    parent_id INTEGER REFERENCES tags(id) ON DELETE SET NULL"
         ")"
     );
     
@@ -125,17 +274,43 @@ bool DatabaseManager::createTagsTable()
     return success;
 }
 
+bool DatabaseManager::createFilesTable()
+{
+    QSqlQuery query;
+    bool success = query.exec(
+        "CREATE TABLE IF NOT EXISTS files ("
+        "    id INTEGER PRIMARY KEY,"
+        "    identity TEXT NOT NULL UNIQUE,"
+        "    path TEXT,"
+        "    size INTEGER,"
+        "    mtime INTEGER,"
+        "    missing_since INTEGER,"
+        "    placeholder BLOB,"
+        "    updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP"
+        ")"
+    );
+    
+    if (!success) {
+        m_logger->error(QString("创建files表失败: %1").arg(query.lastError().text()));
+    } else {
+        m_logger->debug("创建files表成功");
+    }
+    return success;
+}
+
 bool DatabaseManager::createFileTagsTable()
 {
+    // 已存在的旧版 file_tags 保持原样，由 v3 迁移转换
     QSqlQuery query;
     bool success = query.exec(
         "CREATE TABLE IF NOT EXISTS file_tags ("
-        "    file_id TEXT NOT NULL,"
+        "    file_id INTEGER NOT NULL,"
         "    tag_id INTEGER NOT NULL,"
         "    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
         "    PRIMARY KEY (file_id, tag_id),"
+        "    FOREIGN KEY (file_id) REFERENCES files(id) ON DELETE CASCADE,"
         "    FOREIGN KEY (tag_id) REFERENCES tags(id) ON DELETE CASCADE"
-        ")"
+        ") WITHOUT ROWID"
     );
     
     if (!success) {
@@ -146,6 +321,268 @@ bool DatabaseManager::createFileTagsTable()
     return success;
 }
 
+bool DatabaseManager::createIndexes()
+{
+    // 主键 (file_id, tag_id) 覆盖按文件查询，按标签查询使用反向的覆盖索引
+    QSqlQuery query;
+    bool success = query.exec(
+        "CREATE INDEX IF NOT EXISTS idx_file_tags_tag_file ON file_tags(tag_id, file_id)"
+    ) && query.exec(
+        // 祖先查询与移动子树时按 descendant_id 查找
+        "CREATE INDEX IF NOT EXISTS idx_tag_closure_descendant ON tag_closure(descendant_id, ancestor_id)"
+    ) && query.exec(
+        "CREATE INDEX IF NOT EXISTS idx_tags_parent ON tags(parent_id)"
+    ) && query.exec(
+        // 只索引已标记为缺失的文件，孤儿回收按缺失时间查找
+        "CREATE INDEX IF NOT EXISTS idx_files_missing ON files(missing_since) WHERE missing_since IS NOT NULL"
+    );
+    
+    if (!success) {
+        m_logger->error(QString("创建file_tags索引失败: %1").arg(query.lastError().text()));
+    }
+    return success;
+}
+
+bool DatabaseManager::createUsageTables()
+{
+    QSqlQuery query;
+    bool success = query.exec(
+        "CREATE TABLE IF NOT EXISTS tag_usage ("
+        "    tag_id INTEGER PRIMARY KEY,"
+        "    file_count INTEGER NOT NULL DEFAULT 0,"
+        "    FOREIGN KEY (tag_id) REFERENCES tags(id) ON DELETE CASCADE"
+        ")"
+    ) && query.exec(
+        // seq 单调递增，按 seq 倒序即为最近的标记顺序
+        "CREATE TABLE IF NOT EXISTS recent_files ("
+        "    seq INTEGER PRIMARY KEY,"
+        "    file_id INTEGER NOT NULL UNIQUE,"
+        "    FOREIGN KEY (file_id) REFERENCES files(id) ON DELETE CASCADE"
+        ")"
+    ) && query.exec(
+        // 标签共现矩阵：同时出现在一个文件上的标签对及其文件数，只存 tag_a < tag_b 的一半
+        "CREATE TABLE IF NOT EXISTS tag_cooccurrence ("
+        "    tag_a INTEGER NOT NULL,"
+        "    tag_b INTEGER NOT NULL,"
+        "    count INTEGER NOT NULL,"
+        "    PRIMARY KEY (tag_a, tag_b),"
+        "    FOREIGN KEY (tag_a) REFERENCES tags(id) ON DELETE CASCADE,"
+        "    FOREIGN KEY (tag_b) REFERENCES tags(id) ON DELETE CASCADE"
+        ") WITHOUT ROWID"
+    );
+    
+    if (!success) {
+        m_logger->error(QString("创建统计表失败: %1").arg(query.lastError().text()));
+    } else {
+        m_logger->debug("创建统计表成功");
+    }
+    return success;
+}
+
+bool DatabaseManager::createTagClosureTable()
+{
+    // 闭包表：每个标签与它的每个祖先（含自身，depth 为 0）各占一行，子树查询只需按 ancestor_id 查主键
+    QSqlQuery query;
+    bool success = query.exec(
+        "CREATE TABLE IF NOT EXISTS tag_closure ("
+        "    ancestor_id INTEGER NOT NULL,"
+        "    descendant_id INTEGER NOT NULL,"
+        "    depth INTEGER NOT NULL,"
+        "    PRIMARY KEY (ancestor_id, descendant_id),"
+        "    FOREIGN KEY (ancestor_id) REFERENCES tags(id) ON DELETE CASCADE,"
+        "    FOREIGN KEY (descendant_id) REFERENCES tags(id) ON DELETE CASCADE"
+        ") WITHOUT ROWID"
+    );
+    
+    if (!success) {
+        m_logger->error(QString("创建tag_closure表失败: %1").arg(query.lastError().text()));
+    } else {
+        m_logger->debug("创建tag_closure表成功");
+    }
+    return success;
+}
+
+bool DatabaseManager::createSearchTables()
+{
+    // 内容由 SearchIndex::segment 预先切分，rowid 分别对应 files.id 与 tags.id；
+    // prefix 选项为两三个字符的前缀建立额外索引，输入过程中的前缀查询不必扫描词表
+    QSqlQuery query;
+    bool success = query.exec(
+        "CREATE VIRTUAL TABLE IF NOT EXISTS file_search USING fts5("
+        "    name, path,"
+        "    tokenize = 'unicode61 remove_diacritics 2', prefix = '2 3'"
+        ")"
+    ) && query.exec(
+        "CREATE VIRTUAL TABLE IF NOT EXISTS tag_search USING fts5("
+        "    name, description,"
+        "    tokenize = 'unicode61 remove_diacritics 2', prefix = '2 3'"
+        ")"
+    );
+    
+    if (!success) {
+        m_logger->error(QString("创建全文索引表失败: %1").arg(query.lastError().text()));
+    } else {
+        m_logger->debug("创建全文索引表成功");
+    }
+    return success;
+}
+
+bool DatabaseManager::createSmartFolderTables()
+{
+    // 智能文件夹：保存的查询定义与物化的结果集，结果随文件与标签变化增量维护
+    QSqlQuery query;
+    bool success = query.exec(
+        "CREATE TABLE IF NOT EXISTS smart_folders ("
+        "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "    name TEXT NOT NULL,"
+        "    tag_query TEXT NOT NULL DEFAULT '',"
+        "    min_size INTEGER,"
+        "    max_size INTEGER,"
+        "    modified_within_days INTEGER,"
+        "    extensions TEXT NOT NULL DEFAULT '',"
+        "    refreshed_at TIMESTAMP,"
+        "    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP"
+        ")"
+    ) && query.exec(
+        "CREATE TABLE IF NOT EXISTS smart_folder_members ("
+        "    folder_id INTEGER NOT NULL,"
+        "    file_id INTEGER NOT NULL,"
+        "    PRIMARY KEY (folder_id, file_id),"
+        "    FOREIGN KEY (folder_id) REFERENCES smart_folders(id) ON DELETE CASCADE,"
+        "    FOREIGN KEY (file_id) REFERENCES files(id) ON DELETE CASCADE"
+        ") WITHOUT ROWID"
+    );
+    
+    if (!success) {
+        m_logger->error(QString("创建智能文件夹表失败: %1").arg(query.lastError().text()));
+    } else {
+        m_logger->debug("创建智能文件夹表成功");
+    }
+    return success;
+}
+
+bool DatabaseManager::createImageHashTable()
+{
+    // 相似图片：每个文件预览上计算的 dHash / pHash，按位存为有符号整数
+    QSqlQuery query;
+    bool success = query.exec(
+        "CREATE TABLE IF NOT EXISTS image_hashes ("
+        "    file_id INTEGER PRIMARY KEY,"
+        "    dhash INTEGER NOT NULL,"
+        "    phash INTEGER NOT NULL,"
+        "    FOREIGN KEY (file_id) REFERENCES files(id) ON DELETE CASCADE"
+        ")"
+    );
+
+    if (!success) {
+        m_logger->error(QString("创建图片哈希表失败: %1").arg(query.lastError().text()));
+    } else {
+        m_logger->debug("创建图片哈希表成功");
+    }
+    return success;
+}
+
+bool DatabaseManager::createVideoFingerprintTable()
+{
+    // 相似视频：按时间顺序抽取的若干关键帧的 pHash，每帧 8 字节小端序连续存放
+    QSqlQuery query;
+    bool success = query.exec(
+        "CREATE TABLE IF NOT EXISTS video_fingerprints ("
+        "    file_id INTEGER PRIMARY KEY,"
+        "    frames BLOB NOT NULL,"
+        "    FOREIGN KEY (file_id) REFERENCES files(id) ON DELETE CASCADE"
+        ")"
+    );
+
+    if (!success) {
+        m_logger->error(QString("创建视频指纹表失败: %1").arg(query.lastError().text()));
+    } else {
+        m_logger->debug("创建视频指纹表成功");
+    }
+    return success;
+}
+
+bool DatabaseManager::createTriggers()
+{
+    const QStringList statements = {
+        // 新增关联：标签计数加一，文件移到最近列表末尾（REPLACE 会分配新的 seq）
+        "CREATE TRIGGER IF NOT EXISTS trg_file_tags_insert AFTER INSERT ON file_tags BEGIN "
+        "    INSERT INTO tag_usage (tag_id, file_count) VALUES (NEW.tag_id, 1) "
+        "        ON CONFLICT(tag_id) DO UPDATE SET file_count = file_count + 1; "
+        "    INSERT OR REPLACE INTO recent_files (file_id) VALUES (NEW.file_id); "
+        "END",
+        // 删除关联：标签计数减一，文件失去全部标签时移出最近列表
+        "CREATE TRIGGER IF NOT EXISTS trg_file_tags_delete AFTER DELETE ON file_tags BEGIN "
+        "    UPDATE tag_usage SET file_count = file_count - 1 WHERE tag_id = OLD.tag_id; "
+        "    DELETE FROM recent_files WHERE file_id = OLD.file_id "
+        "        AND NOT EXISTS (SELECT 1 FROM file_tags WHERE file_id = OLD.file_id); "
+        "END",
+        QString("CREATE TRIGGER IF NOT EXISTS trg_recent_files_trim AFTER INSERT ON recent_files "
+                "WHEN NEW.seq % %1 = 0 BEGIN "
+                "    DELETE FROM recent_files WHERE seq <= NEW.seq - %2; "
+                "END").arg(RECENT_FILES_TRIM_INTERVAL).arg(RECENT_FILES_CAPACITY),
+        // 共现矩阵：新关联与文件已有的每个标签配对加一，删除时减一，归零的行删除
+        "CREATE TRIGGER IF NOT EXISTS trg_file_tags_insert_pairs AFTER INSERT ON file_tags BEGIN "
+        "    INSERT INTO tag_cooccurrence (tag_a, tag_b, count) "
+        "    SELECT MIN(NEW.tag_id, tag_id), MAX(NEW.tag_id, tag_id), 1 FROM file_tags "
+        "    WHERE file_id = NEW.file_id AND tag_id <> NEW.tag_id "
+        "        ON CONFLICT(tag_a, tag_b) DO UPDATE SET count = count + 1; "
+        "END",
+        "CREATE TRIGGER IF NOT EXISTS trg_file_tags_delete_pairs AFTER DELETE ON file_tags BEGIN "
+        "    UPDATE tag_cooccurrence SET count = count - 1 WHERE (tag_a, tag_b) IN ("
+        "        SELECT MIN(OLD.tag_id, tag_id), MAX(OLD.tag_id, tag_id) FROM file_tags WHERE file_id = OLD.file_id); "
+        "    DELETE FROM tag_cooccurrence WHERE count <= 0 AND (tag_a, tag_b) IN ("
+        "        SELECT MIN(OLD.tag_id, tag_id), MAX(OLD.tag_id, tag_id) FROM file_tags WHERE file_id = OLD.file_id); "
+        "END",
+        // 新建标签：自身一行，加上父标签的每个祖先各一行
+        "CREATE TRIGGER IF NOT EXISTS trg_tags_insert_closure AFTER INSERT ON tags BEGIN "
+        "    INSERT INTO tag_closure (ancestor_id, descendant_id, depth) "
+        "    SELECT NEW.id, NEW.id, 0 "
+        "    UNION ALL "
+        "    SELECT ancestor_id, NEW.id, depth + 1 FROM tag_closure WHERE descendant_id = NEW.parent_id; "
+        "END",
+        // 不允许把标签移动到自己的子树下
+        "CREATE TRIGGER IF NOT EXISTS trg_tags_check_parent BEFORE UPDATE OF parent_id ON tags "
+        "WHEN NEW.parent_id IS NOT NULL AND EXISTS ("
+        "    SELECT 1 FROM tag_closure WHERE ancestor_id = NEW.id AND descendant_id = NEW.parent_id) "
+        "BEGIN "
+        "    SELECT RAISE(ABORT, 'tag hierarchy cycle'); "
+        "END",
+        // 移动标签：整棵子树先断开与原祖先的连接，再与新父标签的祖先逐一连接，均为集合操作
+        "CREATE TRIGGER IF NOT EXISTS trg_tags_move_closure AFTER UPDATE OF parent_id ON tags "
+        "WHEN OLD.parent_id IS NOT NEW.parent_id BEGIN "
+        "    DELETE FROM tag_closure "
+        "    WHERE descendant_id IN (SELECT descendant_id FROM tag_closure WHERE ancestor_id = NEW.id) "
+        "      AND ancestor_id IN (SELECT ancestor_id FROM tag_closure "
+        "                          WHERE descendant_id = NEW.id AND ancestor_id != NEW.id); "
+        "    INSERT INTO tag_closure (ancestor_id, descendant_id, depth) "
+        "    SELECT up.ancestor_id, down.descendant_id, up.depth + down.depth + 1 "
+        "    FROM tag_closure up JOIN tag_closure down "
+        "    WHERE up.descendant_id = NEW.parent_id AND down.ancestor_id = NEW.id; "
+        "END",
+        // 删除标签：子标签先挂到被删标签的父标签下，子树保持完整
+        "CREATE TRIGGER IF NOT EXISTS trg_tags_delete_reparent BEFORE DELETE ON tags BEGIN "
+        "    UPDATE tags SET parent_id = OLD.parent_id WHERE parent_id = OLD.id; "
+        "END",
+        // 全文索引的写入需要在程序中切分文本，删除则直接跟随主表
+        "CREATE TRIGGER IF NOT EXISTS trg_files_delete_search AFTER DELETE ON files BEGIN "
+        "    DELETE FROM file_search WHERE rowid = OLD.id; "
+        "END",
+        "CREATE TRIGGER IF NOT EXISTS trg_tags_delete_search AFTER DELETE ON tags BEGIN "
+        "    DELETE FROM tag_search WHERE rowid = OLD.id; "
+        "END"
+    };
+
+    QSqlQuery query;
+    for (const QString &statement : statements) {
+        if (!query.exec(statement)) {
+            m_logger->error(QString("创建触发器失败: %1").arg(query.lastError().text()));
+            return false;
+        }
+    }
+    return true;
+}
+
 int DatabaseManager::currentVersion() const
 {
     QSqlQuery query;
@@ -158,29 +595,51 @@ int DatabaseManager::currentVersion() const
 
 bool DatabaseManager::upgradeDatabase(int fromVersion, int toVersion)
 {
-    m_db.transaction();
-
+    // 每个版本单独提交并记录版本号，中途失败后重新启动时从失败的版本继续
     for (int version = fromVersion + 1; version <= toVersion; ++version) {
         m_logger->info(QString("[DatabaseManager] 正在应用数据库迁移: 版本 %1").arg(version));
-        if (!applyMigration(version)) {
+
+        // 分批迁移自行管理事务，并在最后一个事务中写入版本号
+        if (version == FILES_TABLE_VERSION) {
+            if (!applyMigration(version)) {
+                m_logger->error(QString("[DatabaseManager] 数据库迁移失败: 版本 %1").arg(version));
+                return false;
+            }
+            continue;
+        }
+
+        if (!m_db.transaction()) {
+            m_logger->error(QString("[DatabaseManager] 开始事务失败: %1").arg(m_db.lastError().text()));
+            return false;
+        }
+
+        if (!applyMigration(version) || !saveSchemaVersion(version)) {
             m_logger->error(QString("[DatabaseManager] 数据库迁移失败: 版本 %1").arg(version));
             m_db.rollback();
             return false;
         }
+
+        if (!m_db.commit()) {
+            m_logger->error(QString("[DatabaseManager] 提交迁移失败: %1").arg(m_db.lastError().text()));
+            m_db.rollback();
+            return false;
+        }
     }
 
-    // 更新数据库版本
+    return true;
+}
+
+bool DatabaseManager::saveSchemaVersion(int version)
+{
     QSqlQuery query;
     query.prepare("INSERT OR REPLACE INTO settings (key, value) VALUES ('schema_version', :version)");
-    query.bindValue(":version", toVersion);
+    query.bindValue(":version", version);
     
     if (!query.exec()) {
         m_logger->error(QString("[DatabaseManager] 更新数据库版本失败: %1").arg(query.lastError().text()));
-        m_db.rollback();
         return false;
     }
-
-    return m_db.commit();
+    return true;
 }
 
 bool DatabaseManager::applyMigration(int version)
@@ -192,47 +651,94 @@ bool DatabaseManager::applyMigration(int version)
             return true;
             
         case 2:
-            // 创建临时表
-            if (!query.exec("CREATE TABLE file_tags_temp ("
-                          "file_id TEXT NOT NULL,"
-                          "tag_id INTEGER NOT NULL,"
-                          "created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
-                          "PRIMARY KEY (file_id, tag_id),"
-                          "FOREIGN KEY (tag_id) REFERENCES tags(id) ON DELETE CASCADE)")) {
-                m_logger->error(QString("[DatabaseManager] 创建临时表失败: %1").arg(query.lastError().text()));
-                return false;
-            }
+            // 原先在这里整表重建 file_tags，v3 会分批把它再改写一遍，这一步的结果随即被丢弃；
+            // 两者表结构相同，直接交给 v3 处理，避免在大库上多一次无法续传的长事务
+            return true;
             
-            // 复制数据
-            if (!query.exec("INSERT INTO file_tags_temp (file_id, tag_id, created_at) "
-                          "SELECT file_id, tag_id, created_at FROM file_tags")) {
-                m_logger->error(QString("[DatabaseManager] 复制数据失败: %1").arg(query.lastError().text()));
-                return false;
+        case 3:
+            return migrateToFilesTable();
+            
+        case 4: {
+            // 统计表由 createTables 建好，这里按现有数据回填一次，之后由触发器维护
+            const QStringList statements = {
+                "DELETE FROM tag_usage",
+                "INSERT INTO tag_usage (tag_id, file_count) "
+                "SELECT tag_id, COUNT(*) FROM file_tags GROUP BY tag_id",
+                "DELETE FROM recent_files",
+                QString("INSERT INTO recent_files (file_id) "
+                        "SELECT file_id FROM ("
+                        "    SELECT file_id, MAX(created_at) AS touched FROM file_tags "
+                        "    GROUP BY file_id ORDER BY touched DESC LIMIT %1"
+                        ") ORDER BY touched ASC").arg(RECENT_FILES_CAPACITY)
+            };
+            for (const QString &statement : statements) {
+                if (!query.exec(statement)) {
+                    m_logger->error(QString("[DatabaseManager] 回填统计表失败: %1").arg(query.lastError().text()));
+                    return false;
+                }
             }
+            return true;
+        }
+            
+        case 5:
+            return migrateToTagHierarchy();
             
-            // 删除旧表
-            if (!query.exec("DROP TABLE file_tags")) {
-                m_logger->error(QString("[DatabaseManager] 删除旧表失败: %1").arg(query.lastError().text()));
+        case 6:
+            return rebuildSearchIndex();
+            
+        case 7: {
+            // 从 v3 之前升级时 files 表由 createTables 新建，已经带有该列
+            bool hasColumn = false;
+            if (query.exec("PRAGMA table_info(files)")) {
+                while (query.next()) {
+                    hasColumn = hasColumn || query.value(1).toString() == "missing_since";
+                }
+            }
+            if (!hasColumn && !query.exec("ALTER TABLE files ADD COLUMN missing_since INTEGER")) {
+                m_logger->error(QString("[DatabaseManager] 添加missing_since列失败: %1").arg(query.lastError().text()));
                 return false;
             }
+            return true;
+        }
             
-            // 重命名新表
-            if (!query.exec("ALTER TABLE file_tags_temp RENAME TO file_tags")) {
-                m_logger->error(QString("[DatabaseManager] 重命名表失败: %1").arg(query.lastError().text()));
+        case 8:
+            // 共现矩阵由 createTables 建好，这里按现有关联一次性生成，之后由触发器维护
+            if (!query.exec("DELETE FROM tag_cooccurrence") ||
+                !query.exec("INSERT INTO tag_cooccurrence (tag_a, tag_b, count) "
+                            "SELECT a.tag_id, b.tag_id, COUNT(*) FROM file_tags a "
+                            "JOIN file_tags b ON b.file_id = a.file_id AND b.tag_id > a.tag_id "
+                            "GROUP BY a.tag_id, b.tag_id")) {
+                m_logger->error(QString("[DatabaseManager] 生成共现矩阵失败: %1").arg(query.lastError().text()));
                 return false;
             }
+            return true;
             
-            // 重新创建索引
-            if (!query.exec("CREATE INDEX idx_file_tags_file_id ON file_tags(file_id)")) {
-                m_logger->error(QString("[DatabaseManager] 创建file_id索引失败: %1").arg(query.lastError().text()));
-                return false;
+        case 9:
+            // 智能文件夹表由 createTables 建好，没有需要迁移的数据
+            return true;
+            
+        case 10:
+            // 图片哈希表由 createTables 建好，哈希在之后生成预览时写入
+            return true;
+            
+        case 11:
+            // 视频指纹表由 createTables 建好，指纹在之后生成预览时写入
+            return true;
+            
+        case 12: {
+            // 与 v7 相同，新建的 files 表已经带有该列
+            bool hasColumn = false;
+            if (query.exec("PRAGMA table_info(files)")) {
+                while (query.next()) {
+                    hasColumn = hasColumn || query.value(1).toString() == "placeholder";
+                }
             }
-            if (!query.exec("CREATE INDEX idx_file_tags_tag_id ON file_tags(tag_id)")) {
-                m_logger->error(QString("[DatabaseManager] 创建tag_id索引失败: %1").arg(query.lastError().text()));
+            if (!hasColumn && !query.exec("ALTER TABLE files ADD COLUMN placeholder BLOB")) {
+                m_logger->error(QString("[DatabaseManager] 添加placeholder列失败: %1").arg(query.lastError().text()));
                 return false;
             }
-            
             return true;
+        }
             
         default:
             m_logger->error(QString("[DatabaseManager] 未知的数据库版本: %1").arg(version));
@@ -240,29 +746,466 @@ bool DatabaseManager::applyMigration(int version)
     }
 }
 
+bool DatabaseManager::migrateToFilesTable()
+{
+    QSqlQuery query;
+
+    // 新表与旧表并存直到最后一步；重新执行时 IF NOT EXISTS 保留已迁移的部分
+    if (!createFilesTable()) {
+        return false;
+    }
+    if (!query.exec("CREATE TABLE IF NOT EXISTS file_tags_v3 ("
+                    "file_id INTEGER NOT NULL,"
+                    "tag_id INTEGER NOT NULL,"
+                    "created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
+                    "PRIMARY KEY (file_id, tag_id),"
+                    "FOREIGN KEY (file_id) REFERENCES files(id) ON DELETE CASCADE,"
+                    "FOREIGN KEY (tag_id) REFERENCES tags(id) ON DELETE CASCADE"
+                    ") WITHOUT ROWID")) {
+        m_logger->error(QString("[DatabaseManager] 创建file_tags_v3表失败: %1").arg(query.lastError().text()));
+        return false;
+    }
+
+    // 旧表按 rowid 分批复制，每批一个事务，并在同一事务中记录已完成的 rowid
+    qint64 cursor = 0;
+    if (query.exec("SELECT value FROM settings WHERE key = 'migration_v3_cursor'") && query.next()) {
+        cursor = query.value(0).toLongLong();
+        m_logger->info(QString("[DatabaseManager] 从 rowid %1 继续迁移file_tags").arg(cursor));
+    }
+
+    if (!query.exec("SELECT IFNULL(MAX(rowid), 0) FROM file_tags") || !query.next()) {
+        m_logger->error(QString("[DatabaseManager] 读取file_tags失败: %1").arg(query.lastError().text()));
+        return false;
+    }
+    const qint64 lastRowId = query.value(0).toLongLong();
+
+    QSqlQuery insertFiles;
+    QSqlQuery copyTags;
+    QSqlQuery saveCursor;
+    if (!insertFiles.prepare("INSERT OR IGNORE INTO files (identity) "
+                             "SELECT file_id FROM file_tags WHERE rowid > ? AND rowid <= ?") ||
+        !copyTags.prepare("INSERT OR IGNORE INTO file_tags_v3 (file_id, tag_id, created_at) "
+                          "SELECT f.id, ft.tag_id, ft.created_at FROM file_tags ft "
+                          "JOIN files f ON f.identity = ft.file_id "
+                          "WHERE ft.rowid > ? AND ft.rowid <= ?") ||
+        !saveCursor.prepare("INSERT OR REPLACE INTO settings (key, value) VALUES ('migration_v3_cursor', ?)")) {
+        m_logger->error(QString("[DatabaseManager] 准备迁移语句失败: %1").arg(m_db.lastError().text()));
+        return false;
+    }
+
+    while (cursor < lastRowId) {
+        const qint64 end = qMin<qint64>(cursor + MIGRATION_BATCH_ROWS, lastRowId);
+
+        if (!m_db.transaction()) {
+            m_logger->error(QString("[DatabaseManager] 开始事务失败: %1").arg(m_db.lastError().text()));
+            return false;
+        }
+
+        insertFiles.bindValue(0, cursor);
+        insertFiles.bindValue(1, end);
+        copyTags.bindValue(0, cursor);
+        copyTags.bindValue(1, end);
+        saveCursor.bindValue(0, end);
+
+        QSqlQuery *failed = nullptr;
+        if (!insertFiles.exec()) {
+            failed = &insertFiles;
+        } else if (!copyTags.exec()) {
+            failed = &copyTags;
+        } else if (!saveCursor.exec()) {
+            failed = &saveCursor;
+        }
+
+        if (failed || !m_db.commit()) {
+            m_logger->error(QString("[DatabaseManager] 迁移file_tags失败: %1")
+                            .arg(failed ? failed->lastError().text() : m_db.lastError().text()));
+            m_db.rollback();
+            return false;
+        }
+
+        cursor = end;
+        m_logger->info(QString("[DatabaseManager] file_tags迁移进度: %1/%2").arg(cursor).arg(lastRowId));
+    }
+
+    // 仍引用旧表的语句必须先释放，否则 DROP TABLE 会因表被锁定而失败
+    insertFiles.finish();
+    copyTags.finish();
+    saveCursor.finish();
+
+    // 最后在一个事务中替换旧表、清除进度并写入版本号
+    if (!m_db.transaction()) {
+        m_logger->error(QString("[DatabaseManager] 开始事务失败: %1").arg(m_db.lastError().text()));
+        return false;
+    }
+
+    const QStringList statements = {
+        "DROP TABLE file_tags",
+        "ALTER TABLE file_tags_v3 RENAME TO file_tags",
+        "DELETE FROM settings WHERE key = 'migration_v3_cursor'"
+    };
+    for (const QString &statement : statements) {
+        if (!query.exec(statement)) {
+            m_logger->error(QString("[DatabaseManager] 替换file_tags失败: %1").arg(query.lastError().text()));
+            m_db.rollback();
+            return false;
+        }
+    }
+
+    if (!saveSchemaVersion(FILES_TABLE_VERSION)) {
+        m_db.rollback();
+        return false;
+    }
+    if (!m_db.commit()) {
+        m_logger->error(QString("[DatabaseManager] 提交迁移失败: %1").arg(m_db.lastError().text()));
+        m_db.rollback();
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::migrateToTagHierarchy()
+{
+    QSqlQuery query;
+
+    if (!query.exec("ALTER TABLE tags ADD COLUMN parent_id INTEGER REFERENCES tags(id) ON DELETE SET NULL")) {
+        m_logger->error(QString("[DatabaseManager] 添加parent_id列失败: %1").arg(query.lastError().text()));
+        return false;
+    }
+
+    // 以前用 "project/client/year" 这样的名称前缀表示层级，父名称存在时据此设置父标签
+    QHash<QString, int> idsByName;
+    if (!query.exec("SELECT id, name FROM tags")) {
+        m_logger->error(QString("[DatabaseManager] 读取标签失败: %1").arg(query.lastError().text()));
+        return false;
+    }
+    while (query.next()) {
+        idsByName.insert(query.value(1).toString(), query.value(0).toInt());
+    }
+
+    QSqlQuery setParent;
+    setParent.prepare("UPDATE tags SET parent_id = ? WHERE id = ?");
+    for (auto it = idsByName.cbegin(); it != idsByName.cend(); ++it) {
+        const int separator = it.key().lastIndexOf('/');
+        if (separator <= 0) {
+            continue;
+        }
+        auto parent = idsByName.constFind(it.key().left(separator));
+        if (parent == idsByName.cend()) {
+            continue;
+        }
+        setParent.addBindValue(parent.value());
+        setParent.addBindValue(it.value());
+        if (!setParent.exec()) {
+            m_logger->error(QString("[DatabaseManager] 设置父标签失败: %1").arg(setParent.lastError().text()));
+            return false;
+        }
+    }
+
+    // 触发器在升级完成后才创建，闭包表按现有层级一次性生成
+    if (!query.exec("DELETE FROM tag_closure") ||
+        !query.exec("INSERT INTO tag_closure (ancestor_id, descendant_id, depth) "
+                    "WITH RECURSIVE chain(ancestor_id, descendant_id, depth) AS ("
+                    "    SELECT id, id, 0 FROM tags "
+                    "    UNION ALL "
+                    "    SELECT t.parent_id, chain.descendant_id, chain.depth + 1 "
+                    "    FROM chain JOIN tags t ON t.id = chain.ancestor_id "
+                    "    WHERE t.parent_id IS NOT NULL"
+                    ") "
+                    "SELECT ancestor_id, descendant_id, depth FROM chain")) {
+        m_logger->error(QString("[DatabaseManager] 生成tag_closure失败: %1").arg(query.lastError().text()));
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::rebuildSearchIndex()
+{
+    QSqlQuery query;
+    QSqlQuery insert;
+
+    if (!query.exec("DELETE FROM file_search") || !query.exec("DELETE FROM tag_search")) {
+        m_logger->error(QString("[DatabaseManager] 清空全文索引失败: %1").arg(query.lastError().text()));
+        return false;
+    }
+
+    // 只有扫描过的文件才有路径
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT id, path FROM files WHERE path IS NOT NULL") ||
+        !insert.prepare("INSERT INTO file_search (rowid, name, path) VALUES (?, ?, ?)")) {
+        m_logger->error(QString("[DatabaseManager] 重建文件索引失败: %1").arg(query.lastError().text()));
+        return false;
+    }
+    while (query.next()) {
+        const QString path = query.value(1).toString();
+        const int separator = path.lastIndexOf('/');
+        insert.addBindValue(query.value(0));
+        insert.addBindValue(SearchIndex::segment(path.mid(separator + 1)));
+        insert.addBindValue(SearchIndex::segment(path.left(qMax(separator, 0))));
+        if (!insert.exec()) {
+            m_logger->error(QString("[DatabaseManager] 重建文件索引失败: %1").arg(insert.lastError().text()));
+            return false;
+        }
+    }
+
+    if (!query.exec("SELECT id, name, description FROM tags") ||
+        !insert.prepare("INSERT INTO tag_search (rowid, name, description) VALUES (?, ?, ?)")) {
+        m_logger->error(QString("[DatabaseManager] 重建标签索引失败: %1").arg(query.lastError().text()));
+        return false;
+    }
+    while (query.next()) {
+        insert.addBindValue(query.value(0));
+        insert.addBindValue(SearchIndex::segment(query.value(1).toString()));
+        insert.addBindValue(SearchIndex::segment(query.value(2).toString()));
+        if (!insert.exec()) {
+            m_logger->error(QString("[DatabaseManager] 重建标签索引失败: %1").arg(insert.lastError().text()));
+            return false;
+        }
+    }
+    return true;
+}
+
+SqlStatement DatabaseManager::statement(const QString &sql) const
+{
+    StatementCache &cache = m_statements.localData();
+    auto it = cache.entries.find(sql);
+    if (it != cache.entries.end()) {
+        // 释放上次未读完的结果，绑定值在下次执行前会被覆盖
+        it->lastUsed = ++cache.clock;
+        it->query->finish();
+        return SqlStatement(it->query, true);
+    }
+
+    auto query = QSharedPointer<QSqlQuery>::create(database());
+    query->setForwardOnly(true);
+    if (!query->prepare(sql)) {
+        logError(QString("系统|数据库|SQL准备失败|%1|%2").arg(query->lastError().text(), sql));
+        return SqlStatement(query, false);
+    }
+
+    // 缓存只有几十条，线性查找最久未用的一条即可；正在使用的语句由 SqlStatement 持有，不受影响
+    if (cache.entries.size() >= STATEMENT_CACHE_SIZE) {
+        auto oldest = cache.entries.begin();
+        for (auto entry = cache.entries.begin(); entry != cache.entries.end(); ++entry) {
+            if (entry->lastUsed < oldest->lastUsed) {
+                oldest = entry;
+            }
+        }
+        cache.entries.erase(oldest);
+    }
+    cache.entries.insert(sql, {query, ++cache.clock});
+    return SqlStatement(query, true);
+}
+
 bool DatabaseManager::execute(const QString& query, const QVariantList& params)
 {
-    QSqlQuery sqlQuery(m_db);
-    
-    if (!sqlQuery.prepare(query)) {
-        m_logger->error(QString("系统|数据库|SQL准备失败|%1|%2").arg(sqlQuery.lastError().text(), query));
+    SqlStatement sqlQuery = statement(query);
+    if (!sqlQuery.isPrepared()) {
         return false;
     }
     
-    for (const QVariant& param : params) {
-        sqlQuery.addBindValue(param);
+    for (int i = 0; i < params.size(); ++i) {
+        sqlQuery.bindVariant(i, params.at(i));
     }
     
     if (!sqlQuery.exec()) {
-        m_logger->error(QString("系统|数据库|SQL执行失败|%1|%2").arg(sqlQuery.lastError().text(), query));
+        logError(QString("系统|数据库|SQL执行失败|%1|%2").arg(sqlQuery.errorText(), query));
         return false;
     }
     
     return true;
 }
 
+bool DatabaseManager::upsertFiles(const QVector<FileRecord> &records)
+{
+    if (records.isEmpty()) {
+        return true;
+    }
+
+    QSqlDatabase db = database();
+    if (!db.transaction()) {
+        logError(QString("系统|数据库|开始事务失败|%1").arg(db.lastError().text()));
+        return false;
+    }
+
+    // 每行 4 个参数，按 SQLite 的绑定参数上限分块；整块复用同一条预编译语句
+    QSqlQuery query(db);
+    int preparedRows = 0;
+    for (int offset = 0; offset < records.size(); offset += UPSERT_ROWS_PER_STATEMENT) {
+        const int count = qMin(UPSERT_ROWS_PER_STATEMENT, int(records.size()) - offset);
+        if (count != preparedRows) {
+            QStringList rows;
+            rows.reserve(count);
+            for (int i = 0; i < count; ++i) {
+                rows.append("(?, ?, ?, ?)");
+            }
+            if (!query.prepare("INSERT INTO files (identity, path, size, mtime) VALUES " + rows.join(", ") +
+                               " ON CONFLICT(identity) DO UPDATE SET path = excluded.path, size = excluded.size,"
+                               " mtime = excluded.mtime, missing_since = NULL, updated_at = CURRENT_TIMESTAMP,"
+                               // 内容变化后旧的占位图作废
+                               " placeholder = CASE WHEN files.size IS excluded.size AND files.mtime IS excluded.mtime"
+                               " THEN files.placeholder END")) {
+                logError(QString("系统|数据库|SQL准备失败|%1").arg(query.lastError().text()));
+                db.rollback();
+                return false;
+            }
+            preparedRows = count;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            const FileRecord &record = records.at(offset + i);
+            query.bindValue(i * 4, record.identity);
+            query.bindValue(i * 4 + 1, record.path);
+            query.bindValue(i * 4 + 2, record.size);
+            query.bindValue(i * 4 + 3, record.mtime);
+        }
+
+        if (!query.exec()) {
+            logError(QString("系统|数据库|更新文件记录失败|%1").arg(query.lastError().text()));
+            db.rollback();
+            return false;
+        }
+    }
+
+    // 同步全文索引：FTS5 表不支持按 rowid 更新冲突，先删后插
+    QSqlQuery removeSearch(db);
+    QSqlQuery insertSearch(db);
+    if (!removeSearch.prepare("DELETE FROM file_search WHERE rowid = (SELECT id FROM files WHERE identity = ?)") ||
+        !insertSearch.prepare("INSERT INTO file_search (rowid, name, path) "
+                              "SELECT id, ?, ? FROM files WHERE identity = ?")) {
+        logError(QString("系统|数据库|SQL准备失败|%1").arg(db.lastError().text()));
+        db.rollback();
+        return false;
+    }
+    for (const FileRecord &record : records) {
+        const int separator = record.path.lastIndexOf('/');
+        removeSearch.addBindValue(record.identity);
+        insertSearch.addBindValue(SearchIndex::segment(record.path.mid(separator + 1)));
+        insertSearch.addBindValue(SearchIndex::segment(record.path.left(qMax(separator, 0))));
+        insertSearch.addBindValue(record.identity);
+        if (!removeSearch.exec() || !insertSearch.exec()) {
+            logError(QString("系统|数据库|更新全文索引失败|%1")
+                     .arg(removeSearch.lastError().isValid() ? removeSearch.lastError().text()
+                                                             : insertSearch.lastError().text()));
+            db.rollback();
+            return false;
+        }
+    }
+
+    if (!db.commit()) {
+        logError(QString("系统|数据库|提交失败|%1").arg(db.lastError().text()));
+        db.rollback();
+        return false;
+    }
+
+    QStringList identities;
+    identities.reserve(records.size());
+    for (const FileRecord &record : records) {
+        identities.append(record.identity);
+    }
+    emit filesUpserted(identities);
+    return true;
+}
+
+QHash<QString, QByteArray> DatabaseManager::placeholders(const QStringList &identities)
+{
+    QHash<QString, QByteArray> result;
+    if (identities.isEmpty()) {
+        return result;
+    }
+
+    // 参数个数固定，最后一批用末尾的标识补齐（IN 中重复无影响），语句缓存里只有这一条
+    const QString sql = "SELECT identity, placeholder FROM files WHERE placeholder IS NOT NULL AND identity IN ("
+                        + SqlStatement::placeholders(PLACEHOLDER_ROWS_PER_STATEMENT) + ")";
+    for (int offset = 0; offset < identities.size(); offset += PLACEHOLDER_ROWS_PER_STATEMENT) {
+        const int last = qMin(offset + PLACEHOLDER_ROWS_PER_STATEMENT, int(identities.size())) - 1;
+        SqlStatement query = statement(sql);
+        for (int i = 0; i < PLACEHOLDER_ROWS_PER_STATEMENT; ++i) {
+            query.bind(i, identities.at(qMin(offset + i, last)));
+        }
+        if (!query.exec()) {
+            logError(QString("系统|数据库|读取占位图失败|%1").arg(query.errorText()));
+            return result;
+        }
+        while (query.next()) {
+            result.insert(query.stringAt(0), query.blobAt(1));
+        }
+    }
+    return result;
+}
+
+bool DatabaseManager::storePlaceholders(const QHash<QString, QByteArray> &placeholders)
+{
+    if (placeholders.isEmpty()) {
+        return true;
+    }
+
+    QSqlDatabase db = database();
+    if (!db.transaction()) {
+        logError(QString("系统|数据库|开始事务失败|%1").arg(db.lastError().text()));
+        return false;
+    }
+
+    for (auto it = placeholders.cbegin(); it != placeholders.cend(); ++it) {
+        SqlStatement update = statement("INSERT INTO files (identity, placeholder) VALUES (?, ?)"
+                                        " ON CONFLICT(identity) DO UPDATE SET placeholder = excluded.placeholder");
+        update.bind(0, it.key()).bind(1, it.value());
+        if (!update.exec()) {
+            logError(QString("系统|数据库|保存占位图失败|%1").arg(update.errorText()));
+            db.rollback();
+            return false;
+        }
+    }
+
+    if (!db.commit()) {
+        logError(QString("系统|数据库|提交失败|%1").arg(db.lastError().text()));
+        db.rollback();
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::indexTag(int tagId, const QString &name, const QString &description)
+{
+    QSqlDatabase db = database();
+    if (!db.transaction()) {
+        logError(QString("系统|数据库|开始事务失败|%1").arg(db.lastError().text()));
+        return false;
+    }
+
+    SqlStatement remove = statement("DELETE FROM tag_search WHERE rowid = ?");
+    remove.bind(0, tagId);
+    SqlStatement insert = statement("INSERT INTO tag_search (rowid, name, description) VALUES (?, ?, ?)");
+    insert.bind(0, tagId).bind(1, SearchIndex::segment(name)).bind(2, SearchIndex::segment(description));
+
+    QString error;
+    if (!remove.exec()) {
+        error = remove.errorText();
+    } else if (!insert.exec()) {
+        error = insert.errorText();
+    } else if (!db.commit()) {
+        error = db.lastError().text();
+    } else {
+        return true;
+    }
+
+    logError(QString("系统|数据库|更新标签索引失败|%1").arg(error));
+    db.rollback();
+    return false;
+}
+
 DatabaseManager::~DatabaseManager()
 {
+    // 缓存的语句必须先于连接释放
+    if (m_statements.hasLocalData()) {
+        m_statements.localData().clear();
+    }
+    
+    // 关闭前执行一次检查点，把 WAL 中的内容合并回主库文件
+    if (m_db.isOpen()) {
+        QSqlQuery query(m_db);
+        query.exec("PRAGMA wal_checkpoint(TRUNCATE)");
+    }
+    
     if (m_db.isOpen()) {
         m_db.close();
         m_logger->info("系统|数据库|连接关闭");
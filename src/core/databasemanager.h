@@ -4,13 +4,46 @@
 #include <QtCore/QObject>
 #include <QtSql/QSqlDatabase>
 #include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QHash>
+#include <QtCore/QByteArray>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+#include <QtCore/QThreadStorage>
+#include <QtCore/QSharedPointer>
 #include "../utils/logger.h"
+#include "sqlstatement.h"
 
+// 数据库管理器
+//
+// 线程模型：
+//   - 每个线程通过 database() 取得自己独立的连接。GUI 线程使用默认连接，
+//     其他线程首次调用时从连接池中按线程创建，线程结束时自动关闭并移除。
+//   - 数据库以 WAL 模式运行，读连接不会被写事务阻塞，写事务之间仍然串行。
+//   - QSqlDatabase / QSqlQuery 对象不能跨线程传递，必须在使用它的线程内调用 database() 获取。
+//
+// 可以在后台线程调用的操作：
+//   - DatabaseManager::database()、statement()、execute()、upsertFiles()、indexTag()
+//   - SearchIndex::search()
+//   - TagManager::queryFiles()、streamQueryFiles()、getFilesByTag()、getFileTagIds()
+//   - FileTagIndex 的全部读取接口
+// 只能在 GUI 线程调用的操作：
+//   - initialize() 与数据库升级
+//   - TagManager 中修改标签或文件标签的接口，以及返回 Tag* 的接口（依赖 GUI 线程的标签缓存）
 class DatabaseManager : public QObject
 {
     Q_OBJECT
 
 public:
+    // files 表中的一行：identity 为文件系统给出的文件标识，跨重命名、移动保持不变
+    struct FileRecord {
+        QString identity;
+        QString path;
+        qint64 size = 0;
+        qint64 mtime = 0;  // 自 epoch 起的秒数
+    };
+
     static DatabaseManager& instance();
     
     bool initialize();
@@ -20,10 +53,28 @@ public:
     int currentVersion() const;
     bool upgradeDatabase(int fromVersion, int toVersion);
     
-    // 获取数据库连接
-    QSqlDatabase database() const { return m_db; }
+    // 获取当前线程的数据库连接
+    QSqlDatabase database() const;
+    // 提前释放当前线程的连接（非 GUI 线程）
+    void releaseThreadConnection();
+    
+    // 当前线程连接上按 SQL 文本缓存的预编译语句，取出时已重置上一次的结果
+    SqlStatement statement(const QString &sql) const;
     
     bool execute(const QString& query, const QVariantList& params = QVariantList());
+    
+    // 按 identity 插入或更新文件的路径、大小与修改时间，并同步全文索引，在一个事务中完成
+    bool upsertFiles(const QVector<FileRecord> &records);
+    // 按 identity 读取文件的低清占位图，没有的不出现在结果中
+    QHash<QString, QByteArray> placeholders(const QStringList &identities);
+    // 保存低清占位图，在一个事务中完成
+    bool storePlaceholders(const QHash<QString, QByteArray> &placeholders);
+    // 更新标签的全文索引；标签删除时由触发器移除
+    bool indexTag(int tagId, const QString &name, const QString &description);
+
+signals:
+    // upsertFiles 提交后发出，可能在后台线程中发出
+    void filesUpserted(const QStringList &identities);
 
 private:
     explicit DatabaseManager(QObject *parent = nullptr);
@@ -35,16 +86,70 @@ private:
 
     bool createTables();
     bool createTagsTable();
+    bool createFilesTable();
     bool createFileTagsTable();
     bool createSettingsTable();
+    bool createUsageTables();
+    bool createTagClosureTable();
+    bool createSearchTables();
+    bool createSmartFolderTables();
+    bool createImageHashTable();
+    bool createVideoFingerprintTable();
+    bool createIndexes();
+    bool createTriggers();
     
     // 数据库升级相关
     bool applyMigration(int version);
+    bool saveSchemaVersion(int version);
+    bool migrateToFilesTable();
+    bool migrateToTagHierarchy();
+    bool rebuildSearchIndex();
+    
+    // 连接池
+    QSqlDatabase threadConnection(QThread *thread) const;
+    bool configureConnection(QSqlDatabase &db) const;
+    static QString connectionName(QThread *thread);
+    void logError(const QString &message) const;
     
     QSqlDatabase m_db;
+    mutable QMutex m_poolMutex;
+    mutable QHash<QThread*, QString> m_threadConnections;
+    // 每个线程各自的语句缓存，满时淘汰最久未用的一条，连接关闭前清空
+    struct StatementCache {
+        struct Entry {
+            QSharedPointer<QSqlQuery> query;
+            quint64 lastUsed = 0;
+        };
+        QHash<QString, Entry> entries;
+        quint64 clock = 0;
+
+        void clear() { entries.clear(); }
+    };
+    mutable QThreadStorage<StatementCache> m_statements;
     bool m_initialized;
     Logger* m_logger;
-    static const int CURRENT_DB_VERSION = 1;
+    static const int CURRENT_DB_VERSION = 12;
+    // v3 起 file_tags 以 files.id 为键；该迁移分批提交，进度保存在 settings 中，中断后可继续
+    static const int FILES_TABLE_VERSION = 3;
+    static const int MIGRATION_BATCH_ROWS = 50000;
+    static const int UPSERT_ROWS_PER_STATEMENT = 200;
+    static const int PLACEHOLDER_ROWS_PER_STATEMENT = 500;
+    // v4 起标签使用次数与最近标记的文件由 file_tags 上的触发器增量维护
+    // recent_files 是一个环：保留最近 RECENT_FILES_CAPACITY 个文件，每插入 RECENT_FILES_TRIM_INTERVAL 次裁剪一次
+    static const int RECENT_FILES_CAPACITY = 1000;
+    static const int RECENT_FILES_TRIM_INTERVAL = 64;
+    // v8 起标签共现矩阵 tag_cooccurrence 同样由 file_tags 上的触发器维护
+    // v10 起 image_hashes 保存相似图片查找用的感知哈希，由 SimilarityIndex 写入
+    // v11 起 video_fingerprints 保存相似视频查找用的关键帧哈希序列，同样由 SimilarityIndex 写入
+    // v12 起 files.placeholder 保存低清占位图，文件大小或修改时间变化时清空
+    // v7 起 files.missing_since 记录文件在磁盘上消失的时间，由 OrphanCollector 维护，扫描到文件时清空
+    
+    // 连接参数：WAL 下 NORMAL 同步级别只在检查点时 fsync
+    static const int BUSY_TIMEOUT_MS = 5000;
+    static const int CACHE_SIZE_KB = 16384;
+    static const qint64 MMAP_SIZE_BYTES = 256LL * 1024 * 1024;
+    // 单个线程缓存的语句数上限，超出时整体清空
+    static const int STATEMENT_CACHE_SIZE = 64;
 };
 
 #endif // DATABASEMANAGER_H 
\ No newline at end of file
@@ -0,0 +1,347 @@
+#include "databasewriter.h"
+#include "databasemanager.h"
+
+// Qt Core
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QSet>
+
+// Qt SQL
+#include <QSqlQuery>
+#include <QSqlError>
+
+DatabaseWriter::DatabaseWriter(QObject *parent)
+    : QThread(parent)
+    , m_flushWaiters(0)
+    , m_busy(false)
+    , m_stopping(false)
+{
+    setObjectName("DatabaseWriter");
+}
+
+DatabaseWriter::~DatabaseWriter()
+{
+    stop();
+}
+
+void DatabaseWriter::enqueue(const Command &command)
+{
+    QMutexLocker locker(&m_mutex);
+    m_queue.append(command);
+    m_wakeWriter.wakeAll();
+}
+
+void DatabaseWriter::enqueue(const QVector<Command> &commands)
+{
+    if (commands.isEmpty()) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_queue.append(commands);
+    m_wakeWriter.wakeAll();
+}
+
+void DatabaseWriter::flush()
+{
+    if (!isRunning()) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    ++m_flushWaiters;
+    m_wakeWriter.wakeAll();
+    while (!m_queue.isEmpty() || m_busy) {
+        m_drained.wait(&m_mutex);
+    }
+    --m_flushWaiters;
+}
+
+void DatabaseWriter::stop()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_wakeWriter.wakeAll();
+    }
+    wait();
+}
+
+bool DatabaseWriter::hasPendingWrites() const
+{
+    QMutexLocker locker(&m_mutex);
+    return !m_queue.isEmpty() || m_busy;
+}
+
+QVector<DatabaseWriter::Command> DatabaseWriter::pendingCommands() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_inFlight + m_queue;
+}
+
+void DatabaseWriter::run()
+{
+    // 写线程使用连接池中属于自己的连接
+    QSqlDatabase db = DatabaseManager::instance().database();
+
+    QMutexLocker locker(&m_mutex);
+    while (true) {
+        while (m_queue.isEmpty() && !m_stopping) {
+            m_wakeWriter.wait(&m_mutex);
+        }
+        if (m_queue.isEmpty()) {
+            break;
+        }
+
+        // 在合并窗口内继续收集操作，有人等待 flush 或准备退出时立即提交
+        QDeadlineTimer deadline(COALESCE_WINDOW_MS);
+        while (!m_stopping && m_flushWaiters == 0 && m_queue.size() < MAX_BATCH_COMMANDS) {
+            if (!m_wakeWriter.wait(&m_mutex, deadline)) {
+                break;
+            }
+        }
+
+        QVector<Command> batch;
+        batch.swap(m_queue);
+        m_inFlight = batch;
+        m_busy = true;
+        locker.unlock();
+
+        QStringList affectedFiles;
+        QString error;
+        if (!commitBatch(db, batch, &affectedFiles, &error)) {
+            const QStringList failedFiles = batch.size() > 1 ? commitPerFile(db, batch, &error) : affectedFiles;
+            if (!failedFiles.isEmpty()) {
+                emit writeFailed(error, failedFiles);
+            }
+        }
+
+        locker.relock();
+        m_inFlight.clear();
+        m_busy = false;
+        m_drained.wakeAll();
+        if (m_queue.isEmpty()) {
+            emit drained();
+        }
+    }
+    m_drained.wakeAll();
+}
+
+bool DatabaseWriter::commitBatch(QSqlDatabase &db, const QVector<Command> &batch,
+                                 QStringList *affectedFiles, QString *error)
+{
+    // 合并：同一 (文件, 标签) 只保留最后一次操作，清除文件会使之前的操作失效。
+    // 执行顺序为 清除 -> 移除 -> 添加，与原始顺序的最终结果一致。
+    QSet<QString> clearedFiles;
+    QHash<QString, QHash<int, Command::Type>> pairs;
+    QSet<QString> affected;
+
+    for (const Command &command : batch) {
+        affected.insert(command.fileId);
+        if (command.type == Command::ClearFile) {
+            pairs.remove(command.fileId);
+            clearedFiles.insert(command.fileId);
+        } else {
+            pairs[command.fileId][command.tagId] = command.type;
+        }
+    }
+    *affectedFiles = QStringList(affected.begin(), affected.end());
+
+    QVector<QPair<QString, int>> inserts;
+    QHash<int, QStringList> removals;
+    QSet<QString> insertFiles;
+    for (auto fileIt = pairs.cbegin(); fileIt != pairs.cend(); ++fileIt) {
+        for (auto tagIt = fileIt->cbegin(); tagIt != fileIt->cend(); ++tagIt) {
+            if (tagIt.value() == Command::AddTag) {
+                inserts.append({fileIt.key(), tagIt.key()});
+                insertFiles.insert(fileIt.key());
+            } else {
+                removals[tagIt.key()].append(fileIt.key());
+            }
+        }
+    }
+
+    if (!db.transaction()) {
+        *error = db.lastError().text();
+        return false;
+    }
+
+    // file_tags 以 files.id 为键：添加时为新文件建行，清除与移除只需要已存在的行
+    QHash<QString, qint64> fileIds;
+    QStringList lookupOnly;
+    for (const QString &fileId : affected) {
+        if (!insertFiles.contains(fileId)) {
+            lookupOnly.append(fileId);
+        }
+    }
+    bool ok = resolveFileIds(db, QStringList(insertFiles.begin(), insertFiles.end()), true, &fileIds, error)
+              && resolveFileIds(db, lookupOnly, false, &fileIds, error);
+
+    QVector<qint64> cleared;
+    for (const QString &fileId : clearedFiles) {
+        auto it = fileIds.constFind(fileId);
+        if (it != fileIds.cend()) {
+            cleared.append(it.value());
+        }
+    }
+
+    ok = ok && execChunked(db, cleared.size(), BULK_ROWS_PER_STATEMENT * 2,
+        [&](int count) {
+            return "DELETE FROM file_tags WHERE file_id IN (" + SqlStatement::placeholders(count) + ")";
+        },
+        [&](QSqlQuery &query, int offset, int count) {
+            for (int i = 0; i < count; ++i) {
+                query.bindValue(i, cleared[offset + i]);
+            }
+        }, error);
+
+    // 第一个参数为 tag_id，其余为一块 file_id
+    for (auto it = removals.cbegin(); ok && it != removals.cend(); ++it) {
+        const int tagId = it.key();
+        QVector<qint64> rowIds;
+        for (const QString &fileId : it.value()) {
+            auto idIt = fileIds.constFind(fileId);
+            if (idIt != fileIds.cend()) {
+                rowIds.append(idIt.value());
+            }
+        }
+        ok = execChunked(db, rowIds.size(), BULK_ROWS_PER_STATEMENT * 2 - 1,
+            [&](int count) {
+                return "DELETE FROM file_tags WHERE tag_id = ? AND file_id IN ("
+                       + SqlStatement::placeholders(count) + ")";
+            },
+            [&](QSqlQuery &query, int offset, int count) {
+                query.bindValue(0, tagId);
+                for (int i = 0; i < count; ++i) {
+                    query.bindValue(i + 1, rowIds[offset + i]);
+                }
+            }, error);
+    }
+
+    ok = ok && execChunked(db, inserts.size(), BULK_ROWS_PER_STATEMENT,
+        [&](int count) {
+            return "INSERT OR IGNORE INTO file_tags (file_id, tag_id) VALUES "
+                   + SqlStatement::placeholders(count, "(?, ?)");
+        },
+        [&](QSqlQuery &query, int offset, int count) {
+            for (int i = 0; i < count; ++i) {
+                query.bindValue(i * 2, fileIds.value(inserts[offset + i].first));
+                query.bindValue(i * 2 + 1, inserts[offset + i].second);
+            }
+        }, error);
+
+    if (!ok) {
+        db.rollback();
+        return false;
+    }
+
+    if (!db.commit()) {
+        *error = db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return true;
+}
+
+QStringList DatabaseWriter::commitPerFile(QSqlDatabase &db, const QVector<Command> &batch, QString *error)
+{
+    // 不同文件的操作互不影响，同一文件保持原有顺序
+    QStringList order;
+    QHash<QString, QVector<Command>> groups;
+    for (const Command &command : batch) {
+        auto it = groups.find(command.fileId);
+        if (it == groups.end()) {
+            order.append(command.fileId);
+            it = groups.insert(command.fileId, {});
+        }
+        it->append(command);
+    }
+
+    QStringList failedFiles;
+    QStringList affected;
+    for (const QString &fileId : std::as_const(order)) {
+        const QVector<Command> &commands = groups[fileId];
+        if (commitBatch(db, commands, &affected, error)) {
+            continue;
+        }
+        // 同一文件内逐条提交，只跳过出错的那一条
+        bool failed = false;
+        for (const Command &command : commands) {
+            if (commands.size() == 1 || !commitBatch(db, {command}, &affected, error)) {
+                failed = true;
+            }
+        }
+        if (failed) {
+            failedFiles.append(fileId);
+        }
+    }
+    return failedFiles;
+}
+
+bool DatabaseWriter::resolveFileIds(QSqlDatabase &db, const QStringList &identities, bool create,
+                                    QHash<QString, qint64> *ids, QString *error)
+{
+    const int perStatement = BULK_ROWS_PER_STATEMENT * 2;
+    auto bindIdentities = [&identities](QSqlQuery &query, int offset, int count) {
+        for (int i = 0; i < count; ++i) {
+            query.bindValue(i, identities[offset + i]);
+        }
+    };
+
+    if (create && !execChunked(db, identities.size(), perStatement,
+            [](int count) {
+                return "INSERT OR IGNORE INTO files (identity) VALUES " + SqlStatement::placeholders(count, "(?)");
+            }, bindIdentities, error)) {
+        return false;
+    }
+
+    return execChunked(db, identities.size(), perStatement,
+        [](int count) {
+            return "SELECT id, identity FROM files WHERE identity IN (" + SqlStatement::placeholders(count) + ")";
+        }, bindIdentities, error,
+        [ids](QSqlQuery &query) {
+            while (query.next()) {
+                ids->insert(query.value(1).toString(), query.value(0).toLongLong());
+            }
+        });
+}
+
+bool DatabaseWriter::execChunked(QSqlDatabase &db, int total, int perStatement,
+                                 const std::function<QString(int count)> &buildSql,
+                                 const std::function<void(QSqlQuery &query, int offset, int count)> &bind,
+                                 QString *error,
+                                 const std::function<void(QSqlQuery &query)> &consume)
+{
+    // 整块复用同一条预编译语句，只有最后不足一块的部分单独准备
+    QSqlQuery chunkQuery(db);
+    bool chunkPrepared = false;
+
+    for (int offset = 0; offset < total; offset += perStatement) {
+        const int count = qMin(perStatement, total - offset);
+        QSqlQuery tailQuery(db);
+        QSqlQuery *query = &tailQuery;
+        bool prepared = false;
+        if (count == perStatement) {
+            query = &chunkQuery;
+            if (!chunkPrepared) {
+                chunkPrepared = chunkQuery.prepare(buildSql(count));
+            }
+            prepared = chunkPrepared;
+        } else {
+            prepared = tailQuery.prepare(buildSql(count));
+        }
+
+        if (prepared) {
+            bind(*query, offset, count);
+        }
+
+        if (!prepared || !query->exec()) {
+            *error = query->lastError().text();
+            return false;
+        }
+        if (consume) {
+            consume(*query);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef DATABASEWRITER_H
+#define DATABASEWRITER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QStringList>
+#include <QHash>
+#include <QSqlDatabase>
+#include <functional>
+
+class QSqlQuery;
+
+// 文件标签异步写入线程
+// 调用方先更新内存状态再把写操作入队，写线程在一个很短的合并窗口内收集连续的操作，
+// 去掉相互抵消的部分后在一个事务中提交，使界面延迟与磁盘同步时间无关。
+// 整批提交失败时按文件逐个重试，只丢弃出错文件的操作，其余修改照常提交。
+class DatabaseWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Command {
+        enum Type { AddTag, RemoveTag, ClearFile };
+        Type type;
+        QString fileId;
+        int tagId;
+    };
+
+    explicit DatabaseWriter(QObject *parent = nullptr);
+    ~DatabaseWriter();
+
+    void enqueue(const Command &command);
+    void enqueue(const QVector<Command> &commands);
+
+    // 阻塞直到队列中已有的操作全部提交
+    void flush();
+    // 提交剩余操作后结束线程
+    void stop();
+
+    bool hasPendingWrites() const;
+    // 尚未提交的操作（正在提交的一批在前），按入队顺序
+    QVector<Command> pendingCommands() const;
+
+signals:
+    // 在写线程中发出，连接方会以排队方式收到
+    void writeFailed(const QString &message, const QStringList &fileIds);
+    // 一批提交完成后队列为空
+    void drained();
+
+protected:
+    void run() override;
+
+private:
+    bool commitBatch(QSqlDatabase &db, const QVector<Command> &batch,
+                     QStringList *affectedFiles, QString *error);
+    // 按文件分组、组内再逐条提交，返回仍然失败的文件
+    QStringList commitPerFile(QSqlDatabase &db, const QVector<Command> &batch, QString *error);
+    // 把文件标识解析为 files.id，create 为 true 时为缺失的标识建行
+    bool resolveFileIds(QSqlDatabase &db, const QStringList &identities, bool create,
+                        QHash<QString, qint64> *ids, QString *error);
+    bool execChunked(QSqlDatabase &db, int total, int perStatement,
+                     const std::function<QString(int count)> &buildSql,
+                     const std::function<void(QSqlQuery &query, int offset, int count)> &bind,
+                     QString *error,
+                     const std::function<void(QSqlQuery &query)> &consume = nullptr);
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_wakeWriter;
+    QWaitCondition m_drained;
+    QVector<Command> m_queue;
+    QVector<Command> m_inFlight;
+    int m_flushWaiters;
+    bool m_busy;
+    bool m_stopping;
+
+    // 合并窗口与单批上限
+    static const int COALESCE_WINDOW_MS = 25;
+    static const int MAX_BATCH_COMMANDS = 50000;
+    // SQLite 默认最多 999 个绑定参数，多行语句按此分块
+    static const int BULK_ROWS_PER_STATEMENT = 400;
+};
+
+#endif // DATABASEWRITER_H
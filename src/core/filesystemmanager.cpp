@@ -10,6 +10,10 @@
 #include <QSettings>
 #include <QStandardPaths>
 #include "tagmanager.h"
+#include "databasemanager.h"
+#include "searchindex.h"
+#include "similarityindex.h"
+#include "orphancollector.h"
 #include <QtConcurrent>
 
 FileSystemManager::FileSystemManager(QObject *parent)
@@ -19,6 +23,7 @@ FileSystemManager::FileSystemManager(QObject *parent)
     , m_fileModel(new FileListModel(this))
     , m_previewGenerator(new PreviewGenerator(this))
     , m_scanWatcher(new QFutureWatcher<QVector<QSharedPointer<FileData>>>(this))
+    , m_placeholderTimer(new QTimer(this))
 {
     m_logger->setLogFilePath(Logger::getLogFilePath(Logger::FileSystem));
     m_logger->setLogLevel(Logger::Info);
@@ -39,13 +44,31 @@ FileSystemManager::FileSystemManager(QObject *parent)
             this, &FileSystemManager::spritesGenerated);
     connect(m_previewGenerator, &PreviewGenerator::spriteProgress,
             this, &FileSystemManager::spriteProgress);
+    connect(m_previewGenerator, &PreviewGenerator::imageHashed,
+            &SimilarityIndex::instance(), &SimilarityIndex::record);
+    connect(m_previewGenerator, &PreviewGenerator::videoFingerprinted,
+            &SimilarityIndex::instance(), &SimilarityIndex::recordVideo);
+    m_placeholderTimer->setSingleShot(true);
+    m_placeholderTimer->setInterval(PLACEHOLDER_FLUSH_MS);
+    connect(m_placeholderTimer, &QTimer::timeout, this, &FileSystemManager::flushPlaceholders);
+    connect(m_previewGenerator, &PreviewGenerator::placeholderReady,
+            this, [this](const QString &identity, const QByteArray &placeholder) {
+                if (placeholder.isEmpty()) {
+                    return;
+                }
+                m_pendingPlaceholders.insert(identity, placeholder);
+                if (!m_placeholderTimer->isActive()) {
+                    m_placeholderTimer->start();
+                }
+            });
             
     // 连接扫描完成信号
     connect(m_scanWatcher, &QFutureWatcher<QVector<QSharedPointer<FileData>>>::finished,
             this, [this]() {
                 QVector<QSharedPointer<FileData>> files = m_scanWatcher->result();
                 
-                // 在主线程中更新数据
+                // 在主线程中更新数据，上一个目录还没开始的预览任务不再需要
+                m_previewGenerator->cancelPending();
                 if (m_fileModel) {
                     m_fileModel->setFiles(files);
                 }
@@ -75,6 +98,7 @@ void FileSystemManager::setCurrentPath(const QString &path) {
     if (m_currentPath != path) {
         m_currentPath = path;
         if (!m_isScanning && !m_isUpdatingTree) {
+            m_previewGenerator->cancelPending();
             QVector<QSharedPointer<FileData>> files = scanDirectory(path);
             m_fileModel->setFiles(files);
         }
@@ -84,6 +108,7 @@ void FileSystemManager::setCurrentPath(const QString &path) {
 
 FileSystemManager::~FileSystemManager()
 {
+    flushPlaceholders();
     if (m_fileWatcher) {
         m_fileWatcher->deleteLater();
     }
@@ -251,6 +276,8 @@ QVector<QSharedPointer<FileData>> FileSystemManager::scanDirectoryInternal(const
         return QVector<QSharedPointer<FileData>>();
     }
 
+    const QDateTime startedAt = QDateTime::currentDateTimeUtc();
+
     // 设置文件筛选器
     dir.setNameFilters(actualFilters);
     dir.setFilter(QDir::Files | QDir::NoDotAndDotDot);
@@ -287,6 +314,8 @@ QVector<QSharedPointer<FileData>> FileSystemManager::scanDirectoryInternal(const
     int changedCount = 0;
     QVector<QSharedPointer<FileData>> batch;
     batch.reserve(BATCH_SIZE);
+    // 新增或修改的文件同步到 files 表，未变化的文件不重复写库
+    QVector<DatabaseManager::FileRecord> changedRecords;
     
     while (it.hasNext()) {
         QString filePath = it.next();
@@ -313,8 +342,17 @@ QVector<QSharedPointer<FileData>> FileSystemManager::scanDirectoryInternal(const
             previousFile->modifiedDate() != data.modifiedDate()) {  
             data.setFileId(getFileId(data.filePath()));
             changedCount++;
+            if (!data.fileId().isEmpty()) {
+                DatabaseManager::FileRecord record;
+                record.identity = data.fileId();
+                record.path = data.filePath();
+                record.size = data.fileSize();
+                record.mtime = data.modifiedDate().toSecsSinceEpoch();
+                changedRecords.append(record);
+            }
         } else {
             data.setFileId(previousFile->fileId()); 
+            data.setPlaceholder(previousFile->placeholder());
         }
         
         batch.append(QSharedPointer<FileData>::create(data));
@@ -325,12 +363,51 @@ QVector<QSharedPointer<FileData>> FileSystemManager::scanDirectoryInternal(const
             batch.clear();
             batch.reserve(BATCH_SIZE);
         }
+        if (changedRecords.size() >= BATCH_SIZE) {
+            DatabaseManager::instance().upsertFiles(changedRecords);
+            changedRecords.clear();
+        }
     }
     
     // 处理最后一批
     if (!batch.isEmpty()) {
         files.append(batch);
     }
+    DatabaseManager::instance().upsertFiles(changedRecords);
+
+    // 占位图随文件元数据一起读出，网格在任何缩略图读取之前就有内容可显示
+    QStringList placeholderIds;
+    for (const auto &file : std::as_const(files)) {
+        const QString type = file->fileType();
+        if (file->placeholder().isEmpty() && !file->fileId().isEmpty()
+            && (FileTypes::isImageFile(type) || FileTypes::isVideoFile(type))) {
+            placeholderIds.append(file->fileId());
+        }
+    }
+    if (!placeholderIds.isEmpty()) {
+        const QHash<QString, QByteArray> placeholders = DatabaseManager::instance().placeholders(placeholderIds);
+        for (const auto &file : std::as_const(files)) {
+            const auto found = placeholders.constFind(file->fileId());
+            if (found != placeholders.cend()) {
+                file->setPlaceholder(found.value());
+            }
+        }
+    }
+
+    // 登记本次看到的文件，孤儿回收只在扫描过的目录下判断缺失
+    OrphanCollector::Scan scan;
+    scan.root = dir.absolutePath();
+    scan.nameFilters = filters;
+    scan.startedAt = startedAt;
+    scan.identities.reserve(files.size());
+    scan.paths.reserve(files.size());
+    for (const auto &file : std::as_const(files)) {
+        if (!file->fileId().isEmpty()) {
+            scan.identities.insert(file->fileId());
+        }
+        scan.paths.insert(file->filePath());
+    }
+    OrphanCollector::recordScan(scan);
 
     // 发送最终进度
     emit scanProgressChanged(totalFiles, totalFiles);
@@ -342,6 +419,34 @@ QVector<QSharedPointer<FileData>> FileSystemManager::scanDirectoryInternal(const
     return files;
 }
 
+QVariantList FileSystemManager::searchLibrary(const QString &text, int limit)
+{
+    QString errorMessage;
+    const QVector<SearchIndex::Result> results =
+        SearchIndex::search(DatabaseManager::instance().database(), text, limit, &errorMessage);
+    if (!errorMessage.isEmpty()) {
+        m_logger->error(QString("系统|搜索|查询失败|%1").arg(errorMessage));
+    }
+
+    QVariantList items;
+    items.reserve(results.size());
+    for (const SearchIndex::Result &result : results) {
+        QVariantMap item;
+        item["kind"] = result.kind == SearchIndex::Result::File ? "file" : "tag";
+        item["id"] = result.id;
+        item["name"] = result.name;
+        item["score"] = result.score;
+        if (result.kind == SearchIndex::Result::File) {
+            item["fileId"] = result.identity;
+            item["path"] = result.path;
+        } else {
+            item["description"] = result.description;
+        }
+        items.append(item);
+    }
+    return items;
+}
+
 void FileSystemManager::openFileWithProgram(const QString &filePath, const QString &programPath)
 {
     QProcess *process = new QProcess(this);  // 使用指针并设置父对象
@@ -376,15 +481,41 @@ void FileSystemManager::generatePreviews()
 {
     if (!m_previewGenerator || !m_fileModel) return;
     
-    qDebug() << "开始为所有文件生成预览...";
+    // 视图随后会报告实际的可见范围并替换这批请求
+    updateVisiblePreviews(0, INITIAL_PREVIEW_ROWS - 1);
+}
+
+void FileSystemManager::updateVisiblePreviews(int firstRow, int lastRow)
+{
+    if (!m_previewGenerator || !m_fileModel) return;
+    if (m_fileModel->viewMode() != FileListModel::LargeIconView) {
+        m_previewGenerator->cancelPending();
+        return;
+    }
     
-    for (const auto &fileData : m_fileList) {
-        QString type = fileData->fileType().toLower();
-        if (FileTypes::isImageFile(type) || FileTypes::isVideoFile(type)) {
-            // qDebug() << "为文件生成预览:" << fileData->fileName();
-            m_previewGenerator->generatePreview(fileData);
-        }
+    const int rowCount = m_fileModel->rowCount();
+    if (rowCount == 0) {
+        m_previewGenerator->cancelPending();
+        return;
+    }
+    firstRow = qBound(0, firstRow, rowCount - 1);
+    lastRow = qBound(firstRow, lastRow, rowCount - 1);
+    
+    // 优先级：可见行 > 下一屏 > 上一屏（靠近可见区域的先生成）
+    const int span = lastRow - firstRow + 1;
+    QVector<QSharedPointer<FileData>> files;
+    files.reserve(span * 3);
+    for (int row = firstRow; row <= lastRow; ++row) {
+        files.append(m_fileModel->fileAt(row));
+    }
+    for (int row = lastRow + 1; row <= qMin(lastRow + span, rowCount - 1); ++row) {
+        files.append(m_fileModel->fileAt(row));
+    }
+    for (int row = firstRow - 1; row >= qMax(firstRow - span, 0); --row) {
+        files.append(m_fileModel->fileAt(row));
     }
+    
+    m_previewGenerator->schedule(files);
 }
 
 void FileSystemManager::openFile(const QString &filePath, const QString &fileType)
@@ -538,3 +669,17 @@ void FileSystemManager::onDirectoryChanged(const QString &path)
         m_logger->warning(QString("系统|目录删除|%1").arg(path));
     }
 }
+
+void FileSystemManager::flushPlaceholders()
+{
+    m_placeholderTimer->stop();
+    if (m_pendingPlaceholders.isEmpty()) {
+        return;
+    }
+    if (DatabaseManager::instance().storePlaceholders(m_pendingPlaceholders)) {
+        m_pendingPlaceholders.clear();
+    } else {
+        m_logger->warning("系统|占位图|保存失败，稍后重试");
+        m_placeholderTimer->start();
+    }
+}
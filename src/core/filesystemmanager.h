@@ -14,6 +14,8 @@
 #include <QFutureWatcher>
 #include <QtConcurrent>
 #include <QMutex>
+#include <QHash>
+#include <QTimer>
 #include "models/filedata.h"
 #include "utils/logger.h"
 #include "models/filelistmodel.h"
@@ -55,6 +57,11 @@ public:
     Q_INVOKABLE QString getFfmpegPath() const;
     Q_INVOKABLE void setFfmpegPath(const QString &path);
     Q_INVOKABLE void generateVideoSprites(const QString &filePath, int count);
+    // 在整个资料库中全文检索文件名、路径、标签名与标签描述，按相关度排序，不访问文件系统。
+    // 每项包含 kind（"file" 或 "tag"）、id、name、score，文件另有 fileId、path，标签另有 description
+    Q_INVOKABLE QVariantList searchLibrary(const QString &text, int limit = 50);
+    // 视图中可见的行范围变化时调用：可见行按顺序优先，其后预取下一屏与上一屏，滚出范围的请求被取消
+    Q_INVOKABLE void updateVisiblePreviews(int firstRow, int lastRow);
 
 public slots:
     Q_INVOKABLE void openFileWithProgram(const QString &filePath, const QString &programPath);
@@ -100,10 +107,18 @@ private:
     QFutureWatcher<QVector<QSharedPointer<FileData>>> *m_scanWatcher;
     QVector<QSharedPointer<FileData>> scanDirectoryInternal(const QString &path, const QStringList &filters);
     QMutex m_mutex;
+    // 新生成的占位图攒一批后再写库
+    QHash<QString, QByteArray> m_pendingPlaceholders;
+    QTimer *m_placeholderTimer;
+    
+    static const int PLACEHOLDER_FLUSH_MS = 2000;
+    // 尚未收到视图的可见范围时，先为前若干行生成预览
+    static const int INITIAL_PREVIEW_ROWS = 48;
 
 private slots:
     void onFileChanged(const QString &path);
     void onDirectoryChanged(const QString &path);
+    void flushPlaceholders();
 };
 
 #endif // FILESYSTEMMANAGER_H
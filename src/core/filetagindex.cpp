@@ -0,0 +1,492 @@
+#include "filetagindex.h"
+
+#include <algorithm>
+#include <utility>
+
+// Qt SQL
+#include <QSqlQuery>
+#include <QSqlError>
+
+bool FileTagIndex::isLoaded() const
+{
+    QReadLocker locker(&m_lock);
+    return m_loaded;
+}
+
+bool FileTagIndex::load(QSqlDatabase db, const QVector<Change> &pending, QString *error)
+{
+    // 加载期间的写入先记下，替换后重放；add/remove 都是幂等的，
+    // 已经包含在查询结果里的改动重放一次也不会重复计数
+    {
+        QWriteLocker locker(&m_lock);
+        ++m_loading;
+    }
+
+    // 不持锁读取数据库，结果先放进局部对象，完成后在锁内整体替换
+    FileTagIndex fresh;
+    const bool success = fresh.read(db, error);
+    QWriteLocker locker(&m_lock);
+    if (--m_loading == 0) {
+        if (fresh.m_loaded) {
+            swapUnlocked(fresh);
+            m_loaded = true;
+            for (const Change &change : pending) {
+                applyUnlocked(change);
+            }
+        }
+        const QVector<Change> journal = std::exchange(m_journal, QVector<Change>());
+        for (const Change &change : journal) {
+            applyUnlocked(change);
+        }
+    }
+    return success;
+}
+
+bool FileTagIndex::read(QSqlDatabase db, QString *error)
+{
+    // 关联与共现矩阵在同一个读事务中读取，两者一致
+    const bool snapshot = db.transaction();
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    // 按 files.id 排序读取，同一文件的行相邻，驻留时只需比较上一行
+    if (!query.exec("SELECT ft.file_id, ft.tag_id, f.identity, f.path "
+                    "FROM file_tags ft JOIN files f ON f.id = ft.file_id "
+                    "ORDER BY ft.file_id")) {
+        if (error) {
+            *error = query.lastError().text();
+        }
+        if (snapshot) {
+            db.rollback();
+        }
+        return false;
+    }
+
+    // 共现计数直接取自持久化的矩阵，这里不逐对累加
+    qint64 lastRowId = -1;
+    int handle = -1;
+    while (query.next()) {
+        const qint64 rowId = query.value(0).toLongLong();
+        if (rowId != lastRowId) {
+            handle = internUnlocked(query.value(2).toString());
+            m_locations[handle] = locateUnlocked(query.value(3).toString());
+            lastRowId = rowId;
+        }
+        const int tagId = query.value(1).toInt();
+        m_fileTags[handle].insert(tagId);
+        m_tagFiles[tagId].insert(handle);
+        countLocationUnlocked(handle, tagId, 1);
+    }
+
+    bool success = query.exec("SELECT tag_a, tag_b, count FROM tag_cooccurrence");
+    while (success && query.next()) {
+        const int tagA = query.value(0).toInt();
+        const int tagB = query.value(1).toInt();
+        const int count = query.value(2).toInt();
+        bump(m_pairs, tagA, tagB, count);
+        bump(m_pairs, tagB, tagA, count);
+    }
+    if (!success && error) {
+        *error = query.lastError().text();
+    }
+    if (snapshot) {
+        db.commit();
+    }
+
+    // 关联已完整读入，共现矩阵读取失败时仍可使用
+    m_loaded = true;
+    return success;
+}
+
+void FileTagIndex::swapUnlocked(FileTagIndex &other)
+{
+    m_handles.swap(other.m_handles);
+    m_identities.swap(other.m_identities);
+    m_fileTags.swap(other.m_fileTags);
+    m_tagFiles.swap(other.m_tagFiles);
+    m_locations.swap(other.m_locations);
+    m_folderKeys.swap(other.m_folderKeys);
+    m_extensionKeys.swap(other.m_extensionKeys);
+    m_pairs.swap(other.m_pairs);
+    m_folderTags.swap(other.m_folderTags);
+    m_extensionTags.swap(other.m_extensionTags);
+}
+
+void FileTagIndex::applyUnlocked(const Change &change)
+{
+    switch (change.type) {
+    case Change::Add:
+        insertUnlocked(internUnlocked(change.fileId), change.tagId);
+        break;
+    case Change::Remove: {
+        auto it = m_handles.constFind(change.fileId);
+        if (it != m_handles.cend()) {
+            removeUnlocked(it.value(), change.tagId);
+        }
+        break;
+    }
+    case Change::RemoveFile:
+        removeFileUnlocked(change.fileId);
+        break;
+    case Change::RemoveTag:
+        removeTagUnlocked(change.tagId);
+        break;
+    }
+}
+
+void FileTagIndex::clear()
+{
+    QWriteLocker locker(&m_lock);
+    m_handles.clear();
+    m_identities.clear();
+    m_fileTags.clear();
+    m_tagFiles.clear();
+    m_locations.clear();
+    m_folderKeys.clear();
+    m_extensionKeys.clear();
+    m_pairs.clear();
+    m_folderTags.clear();
+    m_extensionTags.clear();
+    m_loaded = false;
+}
+
+QSet<int> FileTagIndex::tagsOfFile(const QString &fileId) const
+{
+    QReadLocker locker(&m_lock);
+    auto it = m_handles.constFind(fileId);
+    return it != m_handles.cend() ? m_fileTags.value(it.value()) : QSet<int>();
+}
+
+QSet<int> FileTagIndex::filesWithTag(int tagId) const
+{
+    QReadLocker locker(&m_lock);
+    return m_tagFiles.value(tagId);
+}
+
+QSet<int> FileTagIndex::allFiles() const
+{
+    QReadLocker locker(&m_lock);
+    QSet<int> files;
+    files.reserve(m_fileTags.size());
+    for (auto it = m_fileTags.cbegin(); it != m_fileTags.cend(); ++it) {
+        files.insert(it.key());
+    }
+    return files;
+}
+
+bool FileTagIndex::contains(const QString &fileId, int tagId) const
+{
+    QReadLocker locker(&m_lock);
+    auto handleIt = m_handles.constFind(fileId);
+    if (handleIt == m_handles.cend()) {
+        return false;
+    }
+    auto it = m_fileTags.constFind(handleIt.value());
+    return it != m_fileTags.cend() && it->contains(tagId);
+}
+
+qint64 FileTagIndex::fileCount() const
+{
+    QReadLocker locker(&m_lock);
+    return m_fileTags.size();
+}
+
+QHash<int, qint64> FileTagIndex::cardinality() const
+{
+    QReadLocker locker(&m_lock);
+    QHash<int, qint64> counts;
+    counts.reserve(m_tagFiles.size());
+    for (auto it = m_tagFiles.cbegin(); it != m_tagFiles.cend(); ++it) {
+        counts.insert(it.key(), it->size());
+    }
+    return counts;
+}
+
+QString FileTagIndex::identity(int handle) const
+{
+    QReadLocker locker(&m_lock);
+    return handle >= 0 && handle < m_identities.size() ? m_identities.at(handle) : QString();
+}
+
+QStringList FileTagIndex::identities(const QSet<int> &handles) const
+{
+    QReadLocker locker(&m_lock);
+    QStringList result;
+    result.reserve(handles.size());
+    for (int handle : handles) {
+        if (handle >= 0 && handle < m_identities.size()) {
+            result.append(m_identities.at(handle));
+        }
+    }
+    return result;
+}
+
+void FileTagIndex::setLocation(const QString &fileId, const QString &path)
+{
+    QWriteLocker locker(&m_lock);
+    const int handle = internUnlocked(fileId);
+    const Location location = locateUnlocked(path);
+    const Location &current = m_locations.at(handle);
+    if (current.folder == location.folder && current.extension == location.extension) {
+        return;
+    }
+
+    const QSet<int> tagIds = m_fileTags.value(handle);
+    for (int tagId : tagIds) {
+        countLocationUnlocked(handle, tagId, -1);
+    }
+    m_locations[handle] = location;
+    for (int tagId : tagIds) {
+        countLocationUnlocked(handle, tagId, 1);
+    }
+}
+
+QHash<int, int> FileTagIndex::cooccurring(int tagId) const
+{
+    QReadLocker locker(&m_lock);
+    return m_pairs.value(tagId);
+}
+
+QVector<FileTagIndex::Suggestion> FileTagIndex::suggest(const QString &fileId, int limit) const
+{
+    QReadLocker locker(&m_lock);
+
+    QSet<int> ownTags;
+    Location location;
+    auto handleIt = m_handles.constFind(fileId);
+    if (handleIt != m_handles.cend()) {
+        ownTags = m_fileTags.value(handleIt.value());
+        location = m_locations.at(handleIt.value());
+    }
+
+    QHash<int, double> scores;
+
+    // 共现：对文件已有的每个标签 s 累加 P(t | s) = 共现文件数 / s 的文件数
+    for (int tagId : ownTags) {
+        auto pairIt = m_pairs.constFind(tagId);
+        auto filesIt = m_tagFiles.constFind(tagId);
+        if (pairIt == m_pairs.cend() || filesIt == m_tagFiles.cend() || filesIt->isEmpty()) {
+            continue;
+        }
+        const double usage = filesIt->size();
+        for (auto it = pairIt->cbegin(); it != pairIt->cend(); ++it) {
+            scores[it.key()] += COOCCURRENCE_WEIGHT * it.value() / usage;
+        }
+    }
+
+    // 同目录、同扩展名的文件：按分布中最常见的标签归一化
+    auto addDistribution = [&scores](const QHash<int, QHash<int, int>> &counts, int key, double weight) {
+        auto it = counts.constFind(key);
+        if (key < 0 || it == counts.cend()) {
+            return;
+        }
+        int maxCount = 0;
+        for (int count : *it) {
+            maxCount = qMax(maxCount, count);
+        }
+        for (auto tagIt = it->cbegin(); tagIt != it->cend(); ++tagIt) {
+            scores[tagIt.key()] += weight * tagIt.value() / maxCount;
+        }
+    };
+    addDistribution(m_folderTags, location.folder, FOLDER_WEIGHT);
+    addDistribution(m_extensionTags, location.extension, EXTENSION_WEIGHT);
+
+    QVector<Suggestion> result;
+    result.reserve(scores.size());
+    for (auto it = scores.cbegin(); it != scores.cend(); ++it) {
+        if (!ownTags.contains(it.key())) {
+            result.append({it.key(), it.value()});
+        }
+    }
+
+    auto byScore = [](const Suggestion &a, const Suggestion &b) {
+        return a.score != b.score ? a.score > b.score : a.tagId < b.tagId;
+    };
+    if (limit >= 0 && limit < result.size()) {
+        std::partial_sort(result.begin(), result.begin() + limit, result.end(), byScore);
+        result.resize(limit);
+    } else {
+        std::sort(result.begin(), result.end(), byScore);
+    }
+    return result;
+}
+
+void FileTagIndex::add(const QString &fileId, int tagId)
+{
+    record(Change{Change::Add, fileId, tagId});
+}
+
+void FileTagIndex::remove(const QString &fileId, int tagId)
+{
+    record(Change{Change::Remove, fileId, tagId});
+}
+
+void FileTagIndex::removeFile(const QString &fileId)
+{
+    record(Change{Change::RemoveFile, fileId, -1});
+}
+
+void FileTagIndex::removeTag(int tagId)
+{
+    record(Change{Change::RemoveTag, QString(), tagId});
+}
+
+void FileTagIndex::record(const Change &change)
+{
+    QWriteLocker locker(&m_lock);
+    if (m_loading > 0) {
+        m_journal.append(change);
+    }
+    applyUnlocked(change);
+}
+
+void FileTagIndex::removeFileUnlocked(const QString &fileId)
+{
+    auto handleIt = m_handles.constFind(fileId);
+    if (handleIt == m_handles.cend()) {
+        return;
+    }
+
+    const int handle = handleIt.value();
+    const QSet<int> tagIds = m_fileTags.value(handle);
+    for (int tagId : tagIds) {
+        removeUnlocked(handle, tagId);
+    }
+}
+
+void FileTagIndex::removeTagUnlocked(int tagId)
+{
+    const QSet<int> handles = m_tagFiles.take(tagId);
+    for (int handle : handles) {
+        countLocationUnlocked(handle, tagId, -1);
+        auto it = m_fileTags.find(handle);
+        if (it != m_fileTags.end()) {
+            it->remove(tagId);
+            if (it->isEmpty()) {
+                m_fileTags.erase(it);
+            }
+        }
+    }
+
+    // 与该标签相关的共现计数整行删除，对方一侧也随之删除
+    const QHash<int, int> partners = m_pairs.take(tagId);
+    for (auto it = partners.cbegin(); it != partners.cend(); ++it) {
+        bump(m_pairs, it.key(), tagId, -it.value());
+    }
+}
+
+int FileTagIndex::internUnlocked(const QString &fileId)
+{
+    // 句柄只增不减，文件失去全部标签后仍保留驻留项，再次标记时复用
+    auto it = m_handles.constFind(fileId);
+    if (it != m_handles.cend()) {
+        return it.value();
+    }
+    const int handle = m_identities.size();
+    m_identities.append(fileId);
+    m_locations.append(Location());
+    m_handles.insert(fileId, handle);
+    return handle;
+}
+
+void FileTagIndex::insertUnlocked(int handle, int tagId)
+{
+    QSet<int> &tagIds = m_fileTags[handle];
+    if (tagIds.contains(tagId)) {
+        return;
+    }
+
+    for (int other : std::as_const(tagIds)) {
+        bump(m_pairs, tagId, other, 1);
+        bump(m_pairs, other, tagId, 1);
+    }
+    tagIds.insert(tagId);
+    m_tagFiles[tagId].insert(handle);
+    countLocationUnlocked(handle, tagId, 1);
+}
+
+void FileTagIndex::removeUnlocked(int handle, int tagId)
+{
+    auto fileIt = m_fileTags.find(handle);
+    if (fileIt == m_fileTags.end() || !fileIt->remove(tagId)) {
+        return;
+    }
+
+    for (int other : std::as_const(*fileIt)) {
+        bump(m_pairs, tagId, other, -1);
+        bump(m_pairs, other, tagId, -1);
+    }
+    if (fileIt->isEmpty()) {
+        m_fileTags.erase(fileIt);
+    }
+
+    auto tagIt = m_tagFiles.find(tagId);
+    if (tagIt != m_tagFiles.end()) {
+        tagIt->remove(handle);
+        if (tagIt->isEmpty()) {
+            m_tagFiles.erase(tagIt);
+        }
+    }
+    countLocationUnlocked(handle, tagId, -1);
+}
+
+FileTagIndex::Location FileTagIndex::locateUnlocked(const QString &path)
+{
+    Location location;
+    const int slash = path.lastIndexOf('/');
+    if (slash <= 0) {
+        return location;
+    }
+
+    auto intern = [](QHash<QString, int> &keys, const QString &value) {
+        auto it = keys.constFind(value);
+        if (it != keys.cend()) {
+            return it.value();
+        }
+        const int key = keys.size();
+        keys.insert(value, key);
+        return key;
+    };
+
+    location.folder = intern(m_folderKeys, path.left(slash));
+    const int dot = path.lastIndexOf('.');
+    if (dot > slash + 1 && dot < path.size() - 1) {
+        location.extension = intern(m_extensionKeys, path.mid(dot + 1).toLower());
+    }
+    return location;
+}
+
+void FileTagIndex::countLocationUnlocked(int handle, int tagId, int delta)
+{
+    const Location &location = m_locations.at(handle);
+    if (location.folder >= 0) {
+        bump(m_folderTags, location.folder, tagId, delta);
+    }
+    if (location.extension >= 0) {
+        bump(m_extensionTags, location.extension, tagId, delta);
+    }
+}
+
+void FileTagIndex::bump(QHash<int, QHash<int, int>> &counts, int key, int tagId, int delta)
+{
+    if (delta > 0) {
+        counts[key][tagId] += delta;
+        return;
+    }
+
+    auto it = counts.find(key);
+    if (it == counts.end()) {
+        return;
+    }
+    auto tagIt = it->find(tagId);
+    if (tagIt == it->end()) {
+        return;
+    }
+    *tagIt += delta;
+    if (*tagIt <= 0) {
+        it->erase(tagIt);
+        if (it->isEmpty()) {
+            counts.erase(it);
+        }
+    }
+}
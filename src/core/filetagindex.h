@@ -0,0 +1,111 @@
+#ifndef FILETAGINDEX_H
+#define FILETAGINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QReadWriteLock>
+#include <QSqlDatabase>
+
+// 文件与标签的常驻双向索引：文件句柄 -> 标签ID集合，标签ID -> 文件句柄集合
+// 首次使用时从 file_tags 整表加载，之后由 TagManager 在每次写库成功后同步更新。
+// 加载时不持锁读库，结果在锁内整体替换；尚未提交的与加载期间的写入会在替换后重放，不会丢失。
+// 文件标识字符串只在驻留表中保存一份，两侧集合都只存放整数句柄，集合运算不再比较字符串。
+// 句柄只在本进程内有效，与 files 表的 id 无关；重新加载后全部失效。
+// 返回的集合是隐式共享的副本，读取本身不复制数据；内部读写锁保证跨线程读取安全。
+// 同时维护标签建议所需的统计：标签共现矩阵（加载自 tag_cooccurrence），以及按文件所在目录、
+// 扩展名汇总的标签分布；都随 add/remove 增量更新，建议只做几次哈希查找。
+class FileTagIndex
+{
+public:
+    FileTagIndex() = default;
+
+    // 一次写入；加载时用于重放尚未提交或加载期间发生的改动
+    struct Change {
+        enum Type { Add, Remove, RemoveFile, RemoveTag };
+        Type type;
+        QString fileId;
+        int tagId;
+    };
+
+    bool isLoaded() const;
+    // pending 为加载开始前已写入内存、但可能尚未提交到数据库的改动，替换后先于加载期间的改动重放
+    bool load(QSqlDatabase db, const QVector<Change> &pending = {}, QString *error = nullptr);
+    void clear();
+
+    // 查询
+    QSet<int> tagsOfFile(const QString &fileId) const;
+    QSet<int> filesWithTag(int tagId) const;
+    QSet<int> allFiles() const;
+    bool contains(const QString &fileId, int tagId) const;
+    qint64 fileCount() const;
+    QHash<int, qint64> cardinality() const;
+
+    // 句柄与文件标识互相转换，未知的句柄返回空字符串
+    QString identity(int handle) const;
+    QStringList identities(const QSet<int> &handles) const;
+
+    // 标签建议
+    struct Suggestion {
+        int tagId;
+        double score;
+    };
+    // 记录文件路径，用于按目录与扩展名统计；加载时取自 files.path，之后新标记的文件由调用方补充
+    void setLocation(const QString &fileId, const QString &path);
+    // 与 tagId 同时出现过的标签及共同出现的文件数
+    QHash<int, int> cooccurring(int tagId) const;
+    // 按共现、同目录文件与同扩展名文件的标签分布打分，不包含文件已有的标签
+    QVector<Suggestion> suggest(const QString &fileId, int limit) const;
+
+    // 写入（调用方保证数据库已写入成功）
+    void add(const QString &fileId, int tagId);
+    void remove(const QString &fileId, int tagId);
+    void removeFile(const QString &fileId);
+    void removeTag(int tagId);
+
+private:
+    // 目录与扩展名各自驻留为整数键，-1 表示未知
+    struct Location {
+        int folder = -1;
+        int extension = -1;
+    };
+
+    // 把数据库内容读入本对象，只用于尚未共享的局部对象，不加锁
+    bool read(QSqlDatabase db, QString *error);
+    void swapUnlocked(FileTagIndex &other);
+    void record(const Change &change);
+    void applyUnlocked(const Change &change);
+    void removeFileUnlocked(const QString &fileId);
+    void removeTagUnlocked(int tagId);
+    int internUnlocked(const QString &fileId);
+    void insertUnlocked(int handle, int tagId);
+    void removeUnlocked(int handle, int tagId);
+    Location locateUnlocked(const QString &path);
+    void countLocationUnlocked(int handle, int tagId, int delta);
+    static void bump(QHash<int, QHash<int, int>> &counts, int key, int tagId, int delta);
+
+    mutable QReadWriteLock m_lock;
+    QHash<QString, int> m_handles;
+    QVector<QString> m_identities;
+    QHash<int, QSet<int>> m_fileTags;
+    QHash<int, QSet<int>> m_tagFiles;
+    QVector<Location> m_locations;  // 按句柄
+    QHash<QString, int> m_folderKeys;
+    QHash<QString, int> m_extensionKeys;
+    // 计数表：键 -> (标签ID -> 计数)，计数归零的项会被删除；m_pairs 两个方向各存一份
+    QHash<int, QHash<int, int>> m_pairs;
+    QHash<int, QHash<int, int>> m_folderTags;
+    QHash<int, QHash<int, int>> m_extensionTags;
+    bool m_loaded = false;
+    int m_loading = 0;
+    QVector<Change> m_journal;
+
+    // 建议打分的权重
+    static constexpr double COOCCURRENCE_WEIGHT = 1.0;
+    static constexpr double FOLDER_WEIGHT = 0.6;
+    static constexpr double EXTENSION_WEIGHT = 0.3;
+};
+
+#endif // FILETAGINDEX_H
@@ -0,0 +1,402 @@
+#include "orphancollector.h"
+#include "databasemanager.h"
+#include "tagmanager.h"
+#include "similarityindex.h"
+
+// Qt Core
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include <QtConcurrent>
+
+// Qt SQL
+#include <QSqlError>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+namespace {
+
+// 尚未处理的扫描，按目录
+QMutex scansMutex;
+QHash<QString, OrphanCollector::Scan> pendingScans;
+
+enum class Presence { Present, Gone, Unknown };
+
+// 路径所在卷的根目录，如 "D:/" 或 "//server/share/"，无法识别时返回空
+QString volumeRoot(const QString &path)
+{
+    if (path.size() >= 3 && path.at(1) == ':' && path.at(2) == '/') {
+        return path.left(3);
+    }
+    if (path.startsWith("//")) {
+        const int server = path.indexOf('/', 2);
+        const int share = server > 2 ? path.indexOf('/', server + 1) : -1;
+        if (share > server + 1) {
+            return path.left(share + 1);
+        }
+    }
+    return QString();
+}
+
+// 按文件标识确认文件是否还在原来的卷上，与它现在的路径无关。
+// 标识是 "高位-低位" 形式的 NTFS 文件索引，其中含有序号，索引被新文件复用时不会误判。
+// 卷或原目录无法访问（移动硬盘拔出、网络共享离线、盘符换成了别的卷）时无法确认，返回 Unknown
+Presence locateByIdentity(const QString &identity, const QString &path)
+{
+#ifdef Q_OS_WIN
+    const QStringList parts = identity.split('-');
+    bool highOk = false;
+    bool lowOk = false;
+    const quint32 high = parts.value(0).toUInt(&highOk);
+    const quint32 low = parts.value(1).toUInt(&lowOk);
+    const QString root = volumeRoot(path);
+    if (parts.size() != 2 || !highOk || !lowOk || root.isEmpty()
+        || !QFileInfo(QFileInfo(path).path()).isDir()) {
+        return Presence::Unknown;
+    }
+
+    const QString nativeRoot = QDir::toNativeSeparators(root);
+    HANDLE volume = CreateFileW(reinterpret_cast<LPCWSTR>(nativeRoot.utf16()), FILE_READ_ATTRIBUTES,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (volume == INVALID_HANDLE_VALUE) {
+        return Presence::Unknown;
+    }
+
+    FILE_ID_DESCRIPTOR descriptor = {};
+    descriptor.dwSize = sizeof(descriptor);
+    descriptor.Type = FileIdType;
+    descriptor.FileId.QuadPart = LONGLONG((quint64(high) << 32) | low);
+    HANDLE file = OpenFileById(volume, &descriptor, FILE_READ_ATTRIBUTES,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, 0);
+    const DWORD lastError = file == INVALID_HANDLE_VALUE ? GetLastError() : ERROR_SUCCESS;
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+    CloseHandle(volume);
+
+    if (lastError == ERROR_SUCCESS) {
+        return Presence::Present;
+    }
+    // 索引不存在时系统返回 ERROR_INVALID_PARAMETER；拒绝访问等其他错误说明文件可能还在
+    if (lastError == ERROR_INVALID_PARAMETER || lastError == ERROR_FILE_NOT_FOUND) {
+        return Presence::Gone;
+    }
+    return Presence::Unknown;
+#else
+    // 其他平台的文件标识无法按索引打开，宁可不回收
+    Q_UNUSED(identity)
+    Q_UNUSED(path)
+    return Presence::Unknown;
+#endif
+}
+
+// 在一个事务中执行，ids 作为 IN 列表绑定在 leading 个参数之后
+bool execForIds(QSqlDatabase &db, const QStringList &statements, const QVector<qint64> &ids,
+                const QVariantList &leading, QString *error)
+{
+    if (ids.isEmpty()) {
+        return true;
+    }
+    if (!db.transaction()) {
+        *error = db.lastError().text();
+        return false;
+    }
+    for (const QString &sql : statements) {
+        SqlStatement statement = DatabaseManager::instance().statement(sql.arg(SqlStatement::placeholders(ids.size())));
+        int index = 0;
+        for (const QVariant &value : leading) {
+            statement.bindVariant(index++, value);
+        }
+        for (qint64 id : ids) {
+            statement.bind(index++, id);
+        }
+        if (!statement.exec()) {
+            *error = statement.errorText();
+            db.rollback();
+            return false;
+        }
+    }
+    if (!db.commit()) {
+        *error = db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+OrphanCollector::OrphanCollector(QObject *parent)
+    : QObject(parent)
+    , m_watcher(new QFutureWatcher<Result>(this))
+    , m_graceDays(DEFAULT_GRACE_DAYS)
+{
+    connect(m_watcher, &QFutureWatcher<Result>::finished, this, &OrphanCollector::onTaskFinished);
+}
+
+OrphanCollector::~OrphanCollector()
+{
+    m_watcher->waitForFinished();
+}
+
+bool OrphanCollector::isBusy() const
+{
+    return m_watcher->isRunning();
+}
+
+int OrphanCollector::graceDays() const
+{
+    return m_graceDays;
+}
+
+void OrphanCollector::setGraceDays(int days)
+{
+    days = qMax(0, days);
+    if (m_graceDays != days) {
+        m_graceDays = days;
+        emit graceDaysChanged();
+    }
+}
+
+void OrphanCollector::recordScan(const Scan &scan)
+{
+    if (scan.root.isEmpty()) {
+        return;
+    }
+    QMutexLocker locker(&scansMutex);
+    pendingScans.insert(scan.root, scan);
+}
+
+bool OrphanCollector::collect()
+{
+    if (isBusy()) {
+        return false;
+    }
+
+    QVector<Scan> scans;
+    {
+        QMutexLocker locker(&scansMutex);
+        scans.reserve(pendingScans.size());
+        for (auto it = pendingScans.cbegin(); it != pendingScans.cend(); ++it) {
+            scans.append(it.value());
+        }
+        pendingScans.clear();
+    }
+
+    const qint64 graceSeconds = qint64(m_graceDays) * 24 * 60 * 60;
+    const PurgeCursor cursor = m_purgeCursor;
+    m_watcher->setFuture(QtConcurrent::run([scans, graceSeconds, cursor]() {
+        Result result = run(scans, graceSeconds, cursor);
+        DatabaseManager::instance().releaseThreadConnection();
+        return result;
+    }));
+    emit busyChanged();
+    return true;
+}
+
+void OrphanCollector::onTaskFinished()
+{
+    const Result result = m_watcher->result();
+
+    // 已删除的文件从内存索引中移除，即使本次中途失败，已提交的批次也要同步
+    if (!result.purgedFiles.isEmpty()) {
+        TagManager::instance().forgetFiles(result.purgedFiles);
+        SimilarityIndex::instance().forget(result.purgedFiles);
+    }
+
+    // 超出预算时从停下的位置继续，直到没有剩余；出错则等下一次定期运行从头开始
+    if (result.unfinished && result.error.isEmpty()) {
+        m_purgeCursor = result.cursor;
+        QTimer::singleShot(PURGE_CONTINUE_MS, this, &OrphanCollector::collect);
+    } else {
+        m_purgeCursor = PurgeCursor();
+    }
+
+    emit busyChanged();
+    if (!result.error.isEmpty()) {
+        emit collectError(QString("系统|数据库|孤儿回收失败|%1").arg(result.error));
+    }
+    emit finished(result.marked, result.restored, result.purgedFiles.size());
+}
+
+OrphanCollector::Result OrphanCollector::run(const QVector<Scan> &scans, qint64 graceSeconds, PurgeCursor cursor)
+{
+    Result result;
+    for (const Scan &scan : scans) {
+        if (!markMissing(scan, &result)) {
+            return result;
+        }
+    }
+    purgeExpired(QDateTime::currentSecsSinceEpoch() - graceSeconds, cursor, &result);
+    return result;
+}
+
+bool OrphanCollector::markMissing(const Scan &scan, Result *result)
+{
+    // 扫描之后目录变得无法访问（移动硬盘拔出、网络共享离线），这次不下结论
+    if (!QFileInfo(scan.root).isDir()) {
+        return true;
+    }
+
+    QSqlDatabase db = DatabaseManager::instance().database();
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    // 目录下的路径范围：'0' 紧跟在 '/' 之后
+    const QString prefix = scan.root.endsWith('/') ? scan.root : scan.root + '/';
+    const QString upperBound = prefix.left(prefix.size() - 1) + '0';
+    // updated_at 由 CURRENT_TIMESTAMP 写入，为 UTC 文本
+    const QString startedAt = scan.startedAt.toUTC().toString("yyyy-MM-dd HH:mm:ss");
+
+    struct Entry {
+        qint64 id;
+        QString identity;
+        QString path;
+        bool markedMissing;
+    };
+
+    qint64 cursor = 0;
+    while (true) {
+        // 先读完一页再比对，比对期间不持有读快照
+        QVector<Entry> page;
+        page.reserve(SCAN_PAGE_FILES);
+        {
+            SqlStatement query = DatabaseManager::instance().statement(
+                "SELECT f.id, f.identity, f.path, f.missing_since IS NOT NULL FROM files f "
+                "WHERE f.id > ? AND f.path >= ? AND f.path < ? AND f.updated_at < ? "
+                "AND EXISTS (SELECT 1 FROM file_tags ft WHERE ft.file_id = f.id) "
+                "ORDER BY f.id LIMIT ?");
+            query.bind(0, cursor).bind(1, prefix).bind(2, upperBound).bind(3, startedAt).bind(4, SCAN_PAGE_FILES);
+            if (!query.exec()) {
+                result->error = query.errorText();
+                return false;
+            }
+            while (query.next()) {
+                page.append({query.int64At(0), query.stringAt(1), query.stringAt(2), query.intAt(3) != 0});
+            }
+        }
+        if (page.isEmpty()) {
+            return true;
+        }
+        cursor = page.last().id;
+
+        QVector<qint64> missing;
+        QVector<qint64> restored;
+        for (const Entry &entry : page) {
+            // 被名称过滤排除的文件这次扫描没有看过
+            if (!scan.nameFilters.isEmpty()
+                && !QDir::match(scan.nameFilters, entry.path.mid(entry.path.lastIndexOf('/') + 1))) {
+                continue;
+            }
+            const bool seen = scan.identities.contains(entry.identity) || scan.paths.contains(entry.path);
+            if (!seen && !entry.markedMissing) {
+                missing.append(entry.id);
+            } else if (seen && entry.markedMissing) {
+                restored.append(entry.id);
+            }
+        }
+
+        if (!execForIds(db, {"UPDATE files SET missing_since = ? WHERE id IN (%1) AND missing_since IS NULL"},
+                        missing, {now}, &result->error)
+            || !execForIds(db, {"UPDATE files SET missing_since = NULL WHERE id IN (%1)"},
+                           restored, {}, &result->error)) {
+            return false;
+        }
+        result->marked += missing.size();
+        result->restored += restored.size();
+    }
+}
+
+bool OrphanCollector::purgeExpired(qint64 cutoff, PurgeCursor cursor, Result *result)
+{
+    QSqlDatabase db = DatabaseManager::instance().database();
+    QElapsedTimer timer;
+    timer.start();
+
+    struct Entry {
+        qint64 id;
+        qint64 missingSince;
+        QString identity;
+        QString path;
+    };
+
+    // 按 (missing_since, id) 翻页，无法确认而跳过的行不会被反复读到；
+    // 上一次超出预算时从它停下的位置继续
+    qint64 lastMissingSince = cursor.missingSince;
+    qint64 lastId = cursor.id;
+    while (true) {
+        if (timer.elapsed() >= PURGE_BUDGET_MS) {
+            result->unfinished = true;
+            result->cursor = {lastMissingSince, lastId};
+            return true;
+        }
+
+        QVector<Entry> page;
+        page.reserve(PURGE_BATCH_FILES);
+        {
+            SqlStatement query = DatabaseManager::instance().statement(
+                "SELECT id, missing_since, identity, path FROM files "
+                "WHERE missing_since IS NOT NULL AND missing_since <= ? "
+                "AND (missing_since > ? OR (missing_since = ? AND id > ?)) "
+                "ORDER BY missing_since, id LIMIT ?");
+            query.bind(0, cutoff).bind(1, lastMissingSince).bind(2, lastMissingSince).bind(3, lastId)
+                 .bind(4, PURGE_BATCH_FILES);
+            if (!query.exec()) {
+                result->error = query.errorText();
+                return false;
+            }
+            while (query.next()) {
+                page.append({query.int64At(0), query.int64At(1), query.stringAt(2), query.stringAt(3)});
+            }
+        }
+        if (page.isEmpty()) {
+            return true;
+        }
+        lastMissingSince = page.last().missingSince;
+        lastId = page.last().id;
+
+        // 删除前按标识再确认一次，不看路径：文件可能只是换了位置
+        QVector<qint64> expired;
+        QVector<qint64> restored;
+        QStringList identities;
+        for (const Entry &entry : page) {
+            switch (locateByIdentity(entry.identity, entry.path)) {
+            case Presence::Present:
+                restored.append(entry.id);
+                break;
+            case Presence::Gone:
+                expired.append(entry.id);
+                identities.append(entry.identity);
+                break;
+            case Presence::Unknown:
+                break;
+            }
+        }
+
+        if (!execForIds(db, {"UPDATE files SET missing_since = NULL WHERE id IN (%1)"},
+                        restored, {}, &result->error)) {
+            return false;
+        }
+        result->restored += restored.size();
+
+        // 条件中再次检查 missing_since，读取之后被扫描重新登记的文件不会被删除
+        if (!execForIds(db, {
+                "DELETE FROM file_tags WHERE file_id IN "
+                "(SELECT id FROM files WHERE missing_since <= ? AND id IN (%1))",
+                "DELETE FROM files WHERE missing_since <= ? AND id IN (%1)"
+            }, expired, {cutoff}, &result->error)) {
+            return false;
+        }
+        result->purgedFiles.append(identities);
+
+        // 让出写锁，界面与写线程的写入不必等待整个回收结束
+        QThread::msleep(PURGE_PAUSE_MS);
+    }
+}
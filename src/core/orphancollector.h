@@ -0,0 +1,97 @@
+#ifndef ORPHANCOLLECTOR_H
+#define ORPHANCOLLECTOR_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QFutureWatcher>
+
+// 孤儿关联回收：在程序外被删除的文件，其 file_tags 行会一直留在库中
+//
+// files.path 只在扫描到文件时更新，可能早已过时：文件被移到未扫描的目录、所在的移动硬盘
+// 拔出或网络共享离线时，按旧路径都找不到，但文件仍在。因此不凭路径判断缺失：
+// 标记：只处理本次运行之前完整扫描过的目录（recordScan 登记），目录下带标签的文件
+//   若其标识与路径都不在扫描结果中，写入 missing_since；在扫描结果中的清空该列。
+//   目录当前无法访问时跳过，扫描开始后才写入的行也不处理。
+// 回收：缺失时间超过宽限期的文件按标识（卷内文件索引）再确认一次，文件仍在卷上的恢复，
+//   卷或原目录无法访问、无法确认的跳过，只有确认已不存在的才连同其关联分批删除。
+//   每批一个短事务，批与批之间让出写锁，总耗时超过预算即停止，稍后从停下的位置继续。
+class OrphanCollector : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool busy READ isBusy NOTIFY busyChanged)
+    Q_PROPERTY(int graceDays READ graceDays WRITE setGraceDays NOTIFY graceDaysChanged)
+
+public:
+    explicit OrphanCollector(QObject *parent = nullptr);
+    ~OrphanCollector();
+
+    bool isBusy() const;
+    int graceDays() const;
+    void setGraceDays(int days);
+
+    // 一次完整的目录扫描，由扫描线程登记，下次回收时用于标记
+    struct Scan {
+        QString root;
+        QStringList nameFilters;    // 为空表示不过滤
+        QSet<QString> identities;
+        QSet<QString> paths;
+        QDateTime startedAt;
+    };
+    // 同一目录只保留最近一次扫描，可以跨线程调用
+    static void recordScan(const Scan &scan);
+
+public slots:
+    // 在后台线程运行一次，已在运行时返回 false
+    bool collect();
+
+signals:
+    void busyChanged();
+    void graceDaysChanged();
+    void finished(int marked, int restored, int purged);
+    void collectError(const QString &message);
+
+private slots:
+    void onTaskFinished();
+
+private:
+    // 回收阶段的翻页位置 (missing_since, id)
+    struct PurgeCursor {
+        qint64 missingSince = -1;
+        qint64 id = 0;
+    };
+
+    struct Result {
+        int marked = 0;
+        int restored = 0;
+        QStringList purgedFiles;
+        QString error;
+        // 超出时间预算而停止，cursor 为下一次继续的位置
+        bool unfinished = false;
+        PurgeCursor cursor;
+    };
+
+    // 在后台线程执行
+    static Result run(const QVector<Scan> &scans, qint64 graceSeconds, PurgeCursor cursor);
+    static bool markMissing(const Scan &scan, Result *result);
+    static bool purgeExpired(qint64 cutoff, PurgeCursor cursor, Result *result);
+
+    QFutureWatcher<Result> *m_watcher;
+    int m_graceDays;
+    PurgeCursor m_purgeCursor;
+
+    static const int DEFAULT_GRACE_DAYS = 7;
+    // 标记阶段每页的文件数，每页只持有一个短读事务
+    static const int SCAN_PAGE_FILES = 1000;
+    // 回收阶段每批删除的文件数、总时间预算与批间停顿
+    static const int PURGE_BATCH_FILES = 500;
+    static const int PURGE_BUDGET_MS = 2000;
+    static const int PURGE_PAUSE_MS = 20;
+    // 超出预算时，隔多久继续剩余的回收
+    static const int PURGE_CONTINUE_MS = 10 * 1000;
+};
+
+#endif // ORPHANCOLLECTOR_H
@@ -0,0 +1,141 @@
+#include "searchindex.h"
+
+// Qt Core
+#include <QRegularExpression>
+#include <QStringList>
+#include <QVariant>
+
+// Qt SQL
+#include <QSqlQuery>
+#include <QSqlError>
+
+// STL
+#include <algorithm>
+
+namespace {
+
+bool isCjk(char32_t codePoint)
+{
+    return (codePoint >= 0x3040 && codePoint <= 0x30FF)      // 平假名、片假名
+        || (codePoint >= 0x3400 && codePoint <= 0x4DBF)      // CJK 扩展 A
+        || (codePoint >= 0x4E00 && codePoint <= 0x9FFF)      // CJK 统一汉字
+        || (codePoint >= 0xAC00 && codePoint <= 0xD7AF)      // 谚文音节
+        || (codePoint >= 0xF900 && codePoint <= 0xFAFF)      // CJK 兼容汉字
+        || (codePoint >= 0x20000 && codePoint <= 0x2FA1F);   // CJK 扩展 B 及以后
+}
+
+} // namespace
+
+QString SearchIndex::segment(const QString &text)
+{
+    QString result;
+    result.reserve(text.size() * 2);
+
+    const QList<uint> codePoints = text.toUcs4();
+    for (uint codePoint : codePoints) {
+        const char32_t ch = static_cast<char32_t>(codePoint);
+        if (isCjk(ch)) {
+            result += QLatin1Char(' ');
+            result += QString::fromUcs4(&ch, 1);
+            result += QLatin1Char(' ');
+        } else {
+            result += QString::fromUcs4(&ch, 1);
+        }
+    }
+    return result.simplified();
+}
+
+QString SearchIndex::matchExpression(const QString &text)
+{
+    QStringList terms;
+    const QStringList words = text.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
+    for (const QString &word : words) {
+        // 只含标点的词分词后为空，跳过
+        const bool searchable = std::any_of(word.cbegin(), word.cend(), [](QChar ch) {
+            return ch.isLetterOrNumber();
+        });
+        if (!searchable) {
+            continue;
+        }
+
+        // 每一项作为短语，双引号按 FTS5 规则转义
+        QString phrase = segment(word);
+        phrase.replace('"', "\"\"");
+        terms.append(QString("\"%1\"*").arg(phrase));
+    }
+    return terms.join(' ');
+}
+
+QVector<SearchIndex::Result> SearchIndex::search(QSqlDatabase db, const QString &text, int limit, QString *error)
+{
+    QVector<Result> results;
+    QVector<Result> files;
+    QVector<Result> tags;
+    const QString match = matchExpression(text);
+    if (match.isEmpty() || limit <= 0) {
+        return results;
+    }
+
+    auto fail = [error](const QSqlQuery &query) {
+        if (error) {
+            *error = query.lastError().text();
+        }
+    };
+
+    // 两张表各取前 limit 条并各自排序。bm25 依赖各表的文档数、平均长度与列权重，
+    // 跨表不可比较，合并时只按各自的名次交替排列
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT f.id, f.identity, f.path, bm25(file_search, %1, %2) AS score "
+                          "FROM file_search JOIN files f ON f.id = file_search.rowid "
+                          "WHERE file_search MATCH ? ORDER BY score LIMIT ?")
+                  .arg(NAME_WEIGHT).arg(PATH_WEIGHT));
+    query.addBindValue(match);
+    query.addBindValue(limit);
+    if (!query.exec()) {
+        fail(query);
+        return results;
+    }
+    while (query.next()) {
+        Result result;
+        result.kind = Result::File;
+        result.id = query.value(0).toLongLong();
+        result.identity = query.value(1).toString();
+        result.path = query.value(2).toString();
+        result.name = result.path.mid(result.path.lastIndexOf('/') + 1);
+        result.score = query.value(3).toDouble();
+        files.append(result);
+    }
+
+    query.prepare(QString("SELECT t.id, t.name, t.description, bm25(tag_search, %1, %2) AS score "
+                          "FROM tag_search JOIN tags t ON t.id = tag_search.rowid "
+                          "WHERE tag_search MATCH ? ORDER BY score LIMIT ?")
+                  .arg(NAME_WEIGHT).arg(DESCRIPTION_WEIGHT));
+    query.addBindValue(match);
+    query.addBindValue(limit);
+    if (!query.exec()) {
+        fail(query);
+        return files;
+    }
+    while (query.next()) {
+        Result result;
+        result.kind = Result::Tag;
+        result.id = query.value(0).toLongLong();
+        result.name = query.value(1).toString();
+        result.description = query.value(2).toString();
+        result.score = query.value(3).toDouble();
+        tags.append(result);
+    }
+
+    // 名次相同时标签在前：标签数量少，命中的标签通常正是要找的分类
+    results.reserve(qMin(limit, int(files.size() + tags.size())));
+    for (int rank = 0; results.size() < limit && (rank < files.size() || rank < tags.size()); ++rank) {
+        if (rank < tags.size()) {
+            results.append(tags.at(rank));
+        }
+        if (rank < files.size() && results.size() < limit) {
+            results.append(files.at(rank));
+        }
+    }
+    return results;
+}
@@ -0,0 +1,42 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QString>
+#include <QVector>
+#include <QSqlDatabase>
+
+// 全文检索（FTS5）
+// file_search 以 files.id 为 rowid，索引文件名与所在目录；tag_search 以 tags.id 为 rowid，索引标签名与描述。
+// unicode61 分词器不切分连续的中日韩文字，写入与查询前都先用 segment() 把这些字符逐字隔开，
+// 查询时连续的字按短语匹配，效果等同于子串匹配。索引由 DatabaseManager 在写入 files、tags 时同步维护。
+class SearchIndex
+{
+public:
+    struct Result {
+        enum Kind { File, Tag };
+        Kind kind = File;
+        qint64 id = 0;          // files.id 或 tags.id
+        QString identity;       // 文件标识，仅 File
+        QString name;           // 文件名或标签名
+        QString path;           // 文件完整路径，仅 File
+        QString description;    // 标签描述，仅 Tag
+        double score = 0;       // bm25 得分，越小越相关，只在同类结果之间可比
+    };
+
+    // 在中日韩文字之间插入空格，其余文本保持不变
+    static QString segment(const QString &text);
+
+    // 把用户输入转换为 FTS5 MATCH 表达式：空白分隔的每一项都必须出现，且每一项都按前缀匹配；
+    // 没有可检索的内容时返回空字符串
+    static QString matchExpression(const QString &text);
+
+    // 同时检索文件与标签，两类各按相关度排序后按名次交替合并，返回前 limit 条
+    static QVector<Result> search(QSqlDatabase db, const QString &text, int limit, QString *error = nullptr);
+
+    // 文件名权重高于目录，标签名权重高于描述
+    static constexpr double NAME_WEIGHT = 10.0;
+    static constexpr double PATH_WEIGHT = 1.0;
+    static constexpr double DESCRIPTION_WEIGHT = 2.0;
+};
+
+#endif // SEARCHINDEX_H
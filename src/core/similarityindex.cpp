@@ -0,0 +1,520 @@
+#include "similarityindex.h"
+#include "databasemanager.h"
+#include "../utils/perceptualhash.h"
+
+#include <QCoreApplication>
+#include <QTimer>
+#include <QSet>
+#include <QSqlError>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+QByteArray packFrames(const QVector<quint64> &frames)
+{
+    QByteArray data(frames.size() * int(sizeof(quint64)), Qt::Uninitialized);
+    for (int i = 0; i < frames.size(); ++i) {
+        qToLittleEndian(frames[i], data.data() + i * sizeof(quint64));
+    }
+    return data;
+}
+
+QVector<quint64> unpackFrames(const QByteArray &data)
+{
+    QVector<quint64> frames(data.size() / int(sizeof(quint64)));
+    for (int i = 0; i < frames.size(); ++i) {
+        frames[i] = qFromLittleEndian<quint64>(data.constData() + i * sizeof(quint64));
+    }
+    return frames;
+}
+
+} // namespace
+
+void SimilarityIndex::BkTree::insert(int item, quint64 hash)
+{
+    if (nodes.isEmpty()) {
+        nodes.append(Node{hash, item, 0});
+        return;
+    }
+
+    int current = 0;
+    while (true) {
+        const int distance = PerceptualHash::distance(nodes[current].hash, hash);
+        int child = nodes[current].firstChild;
+        while (child != -1 && nodes[child].distance != distance) {
+            child = nodes[child].nextSibling;
+        }
+        if (child == -1) {
+            Node node{hash, item, distance};
+            node.nextSibling = nodes[current].firstChild;
+            nodes.append(node);
+            nodes[current].firstChild = int(nodes.size()) - 1;
+            return;
+        }
+        current = child;
+    }
+}
+
+template <typename Visit>
+void SimilarityIndex::BkTree::search(quint64 hash, int radius, Visit visit) const
+{
+    if (nodes.isEmpty()) {
+        return;
+    }
+    QVector<int> stack = {0};
+    while (!stack.isEmpty()) {
+        const Node &node = nodes[stack.takeLast()];
+        const int distance = PerceptualHash::distance(node.hash, hash);
+        if (distance <= radius) {
+            visit(node, distance);
+        }
+        for (int child = node.firstChild; child != -1; child = nodes[child].nextSibling) {
+            if (qAbs(nodes[child].distance - distance) <= radius) {
+                stack.append(child);
+            }
+        }
+    }
+}
+
+SimilarityIndex::SimilarityIndex(QObject *parent)
+    : QObject(parent)
+    , m_flushTimer(new QTimer(this))
+    , m_loaded(false)
+    , m_removedItems(0)
+{
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(FLUSH_INTERVAL_MS);
+    connect(m_flushTimer, &QTimer::timeout, this, &SimilarityIndex::flush);
+    connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &SimilarityIndex::flush);
+}
+
+SimilarityIndex& SimilarityIndex::instance()
+{
+    static SimilarityIndex instance;
+    return instance;
+}
+
+void SimilarityIndex::record(const QString &fileId, quint64 dHash, quint64 pHash)
+{
+    if (fileId.isEmpty()) {
+        return;
+    }
+
+    m_pending.insert(fileId, Hashes{dHash, pHash});
+    if (m_loaded) {
+        // 新文件的 pHash 可能恰好与默认值 0 相同，不能只凭哈希变化判断
+        const bool known = m_items.contains(fileId);
+        const int item = itemFor(fileId);
+        const bool moved = !known || m_hashes[item].pHash != pHash;
+        m_hashes[item] = Hashes{dHash, pHash};
+        if (moved) {
+            m_tree.insert(item, pHash);
+        }
+    }
+
+    if (m_pending.size() + m_pendingVideos.size() >= FLUSH_BATCH) {
+        flush();
+    } else if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+}
+
+void SimilarityIndex::recordVideo(const QString &fileId, const QVector<quint64> &frames)
+{
+    if (fileId.isEmpty() || frames.isEmpty()) {
+        return;
+    }
+
+    m_pendingVideos.insert(fileId, frames);
+    if (m_loaded) {
+        const int item = videoItemFor(fileId);
+        const QVector<quint64> previous = m_videoFrames[item];
+        m_videoFrames[item] = frames;
+        for (quint64 frame : frames) {
+            if (!previous.contains(frame)) {
+                m_videoTree.insert(item, frame);
+            }
+        }
+    }
+
+    if (m_pending.size() + m_pendingVideos.size() >= FLUSH_BATCH) {
+        flush();
+    } else if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+}
+
+void SimilarityIndex::forget(const QStringList &fileIds)
+{
+    for (const QString &fileId : fileIds) {
+        // 未写库的哈希不能再写：写入时会把已删除的文件重新插入 files 表
+        m_pending.remove(fileId);
+        m_pendingVideos.remove(fileId);
+        if (!m_loaded) {
+            continue;
+        }
+
+        // 树上的节点无法单独删除，条目清空后查询时跳过
+        const auto image = m_items.constFind(fileId);
+        if (image != m_items.cend()) {
+            m_identities[image.value()].clear();
+            m_items.erase(image);
+            ++m_removedItems;
+        }
+        const auto video = m_videoItems.constFind(fileId);
+        if (video != m_videoItems.cend()) {
+            m_videoIdentities[video.value()].clear();
+            m_videoFrames[video.value()].clear();
+            m_videoItems.erase(video);
+            ++m_removedItems;
+        }
+    }
+
+    if (m_loaded && m_removedItems * 4 > m_identities.size() + m_videoIdentities.size()) {
+        rebuild();
+    }
+}
+
+QStringList SimilarityIndex::findSimilar(const QString &fileId, int maxDistance)
+{
+    ensureLoaded();
+    const int radius = qBound(0, maxDistance, 32);
+
+    const auto video = m_videoItems.constFind(fileId);
+    if (video != m_videoItems.cend()) {
+        QStringList result;
+        for (int item : findSimilarVideos(video.value(), radius)) {
+            result.append(m_videoIdentities[item]);
+        }
+        return result;
+    }
+
+    const auto image = m_items.constFind(fileId);
+    if (image != m_items.cend()) {
+        return findSimilarImages(image.value(), radius);
+    }
+    return QStringList();
+}
+
+QVariantList SimilarityIndex::duplicateVideoGroups(int maxDistance)
+{
+    ensureLoaded();
+    const int radius = qBound(0, maxDistance, 32);
+
+    // 并查集：相似关系不一定对称（按各自的帧数判断），任一方向成立即归为一组
+    QVector<int> parent(m_videoIdentities.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    auto root = [&parent](int item) {
+        while (parent[item] != item) {
+            parent[item] = parent[parent[item]];
+            item = parent[item];
+        }
+        return item;
+    };
+
+    for (int item = 0; item < m_videoIdentities.size(); ++item) {
+        if (m_videoFrames[item].isEmpty()) {
+            continue;
+        }
+        for (int other : findSimilarVideos(item, radius)) {
+            parent[root(other)] = root(item);
+        }
+    }
+
+    QHash<int, QStringList> groups;
+    for (int item = 0; item < m_videoIdentities.size(); ++item) {
+        if (!m_videoIdentities[item].isEmpty()) {
+            groups[root(item)].append(m_videoIdentities[item]);
+        }
+    }
+
+    QList<QStringList> sorted;
+    for (const QStringList &group : std::as_const(groups)) {
+        if (group.size() > 1) {
+            sorted.append(group);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const QStringList &a, const QStringList &b) {
+        return a.size() > b.size();
+    });
+
+    QVariantList result;
+    for (const QStringList &group : std::as_const(sorted)) {
+        result.append(group);
+    }
+    return result;
+}
+
+QStringList SimilarityIndex::findSimilarImages(int self, int radius) const
+{
+    const Hashes target = m_hashes[self];
+
+    struct Match {
+        int item;
+        int distance;
+        int combined;
+    };
+    QVector<Match> matches;
+    QSet<int> seen;
+    m_tree.search(target.pHash, radius, [&](const Node &node, int distance) {
+        // 哈希已更新的旧节点不再代表该文件
+        if (node.item == self || m_identities[node.item].isEmpty()
+            || m_hashes[node.item].pHash != node.hash || seen.contains(node.item)) {
+            return;
+        }
+        seen.insert(node.item);
+        matches.append({node.item, distance,
+                        distance + PerceptualHash::distance(m_hashes[node.item].dHash, target.dHash)});
+    });
+
+    std::sort(matches.begin(), matches.end(), [](const Match &a, const Match &b) {
+        return a.combined != b.combined ? a.combined < b.combined : a.distance < b.distance;
+    });
+    QStringList result;
+    result.reserve(matches.size());
+    for (const Match &match : std::as_const(matches)) {
+        result.append(m_identities[match.item]);
+    }
+    return result;
+}
+
+QVector<int> SimilarityIndex::findSimilarVideos(int self, int radius) const
+{
+    const QVector<quint64> &frames = m_videoFrames[self];
+    if (frames.isEmpty()) {
+        return QVector<int>();
+    }
+
+    // 候选视频 -> 目标每一帧在该视频中的最近距离，未对上为 -1
+    QHash<int, QVector<int>> nearest;
+    for (int i = 0; i < frames.size(); ++i) {
+        m_videoTree.search(frames[i], radius, [&](const Node &node, int distance) {
+            if (node.item == self || !m_videoFrames[node.item].contains(node.hash)) {
+                return;
+            }
+            QVector<int> &best = nearest[node.item];
+            if (best.isEmpty()) {
+                best.fill(-1, frames.size());
+            }
+            if (best[i] < 0 || distance < best[i]) {
+                best[i] = distance;
+            }
+        });
+    }
+
+    struct Match {
+        int item;
+        int matched;
+        int total;
+    };
+    QVector<Match> matches;
+    for (auto it = nearest.cbegin(); it != nearest.cend(); ++it) {
+        Match match{it.key(), 0, 0};
+        for (int distance : it.value()) {
+            if (distance >= 0) {
+                ++match.matched;
+                match.total += distance;
+            }
+        }
+        if (match.matched * 2 >= frames.size()) {
+            matches.append(match);
+        }
+    }
+
+    std::sort(matches.begin(), matches.end(), [](const Match &a, const Match &b) {
+        return a.matched != b.matched ? a.matched > b.matched : a.total < b.total;
+    });
+    QVector<int> result;
+    result.reserve(matches.size());
+    for (const Match &match : std::as_const(matches)) {
+        result.append(match.item);
+    }
+    return result;
+}
+
+void SimilarityIndex::flush()
+{
+    m_flushTimer->stop();
+    if (m_pending.isEmpty() && m_pendingVideos.isEmpty()) {
+        return;
+    }
+
+    QSqlDatabase db = DatabaseManager::instance().database();
+    if (!db.transaction()) {
+        qWarning() << "相似图片|写入哈希失败|" << db.lastError().text();
+        return;
+    }
+
+    if (!flushImages() || !flushVideos() || !db.commit()) {
+        db.rollback();
+        // 保留待写入的哈希，下次再试
+        m_flushTimer->start();
+        return;
+    }
+    m_pending.clear();
+    m_pendingVideos.clear();
+}
+
+bool SimilarityIndex::flushImages()
+{
+    DatabaseManager &manager = DatabaseManager::instance();
+    for (auto it = m_pending.cbegin(); it != m_pending.cend(); ++it) {
+        SqlStatement file = manager.statement(
+            "INSERT INTO files (identity) VALUES (?) ON CONFLICT(identity) DO NOTHING");
+        file.bind(0, it.key());
+        if (!file.exec()) {
+            qWarning() << "相似图片|写入哈希失败|" << file.errorText();
+            return false;
+        }
+
+        // SQLite 的整数为有符号 64 位，哈希按位原样保存
+        SqlStatement hash = manager.statement(
+            "INSERT OR REPLACE INTO image_hashes (file_id, dhash, phash) "
+            "SELECT id, ?, ? FROM files WHERE identity = ?");
+        hash.bind(0, qint64(it->dHash)).bind(1, qint64(it->pHash)).bind(2, it.key());
+        if (!hash.exec()) {
+            qWarning() << "相似图片|写入哈希失败|" << hash.errorText();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SimilarityIndex::flushVideos()
+{
+    DatabaseManager &manager = DatabaseManager::instance();
+    for (auto it = m_pendingVideos.cbegin(); it != m_pendingVideos.cend(); ++it) {
+        SqlStatement file = manager.statement(
+            "INSERT INTO files (identity) VALUES (?) ON CONFLICT(identity) DO NOTHING");
+        file.bind(0, it.key());
+        if (!file.exec()) {
+            qWarning() << "相似视频|写入指纹失败|" << file.errorText();
+            return false;
+        }
+
+        SqlStatement fingerprint = manager.statement(
+            "INSERT OR REPLACE INTO video_fingerprints (file_id, frames) "
+            "SELECT id, ? FROM files WHERE identity = ?");
+        fingerprint.bind(0, packFrames(it.value())).bind(1, it.key());
+        if (!fingerprint.exec()) {
+            qWarning() << "相似视频|写入指纹失败|" << fingerprint.errorText();
+            return false;
+        }
+    }
+    return true;
+}
+
+void SimilarityIndex::ensureLoaded()
+{
+    if (m_loaded) {
+        return;
+    }
+
+    DatabaseManager &manager = DatabaseManager::instance();
+    {
+        SqlStatement query = manager.statement(
+            "SELECT f.identity, h.dhash, h.phash FROM image_hashes h JOIN files f ON f.id = h.file_id");
+        if (query.exec()) {
+            while (query.next()) {
+                const int item = itemFor(query.stringAt(0));
+                m_hashes[item] = Hashes{quint64(query.int64At(1)), quint64(query.int64At(2))};
+            }
+        } else {
+            qWarning() << "相似图片|加载哈希失败|" << query.errorText();
+        }
+    }
+    {
+        SqlStatement query = manager.statement(
+            "SELECT f.identity, v.frames FROM video_fingerprints v JOIN files f ON f.id = v.file_id");
+        if (query.exec()) {
+            while (query.next()) {
+                m_videoFrames[videoItemFor(query.stringAt(0))] = unpackFrames(query.blobAt(1));
+            }
+        } else {
+            qWarning() << "相似视频|加载指纹失败|" << query.errorText();
+        }
+    }
+
+    // 尚未写库的哈希覆盖库中的旧值
+    for (auto it = m_pending.cbegin(); it != m_pending.cend(); ++it) {
+        m_hashes[itemFor(it.key())] = it.value();
+    }
+    for (auto it = m_pendingVideos.cbegin(); it != m_pendingVideos.cend(); ++it) {
+        m_videoFrames[videoItemFor(it.key())] = it.value();
+    }
+
+    rebuild();
+    m_loaded = true;
+}
+
+void SimilarityIndex::rebuild()
+{
+    QVector<QString> identities;
+    QVector<Hashes> hashes;
+    m_items.clear();
+    for (int item = 0; item < m_identities.size(); ++item) {
+        if (!m_identities[item].isEmpty()) {
+            m_items.insert(m_identities[item], int(identities.size()));
+            identities.append(m_identities[item]);
+            hashes.append(m_hashes[item]);
+        }
+    }
+    m_identities = identities;
+    m_hashes = hashes;
+
+    QVector<QString> videoIdentities;
+    QVector<QVector<quint64>> videoFrames;
+    m_videoItems.clear();
+    for (int item = 0; item < m_videoIdentities.size(); ++item) {
+        if (!m_videoIdentities[item].isEmpty()) {
+            m_videoItems.insert(m_videoIdentities[item], int(videoIdentities.size()));
+            videoIdentities.append(m_videoIdentities[item]);
+            videoFrames.append(m_videoFrames[item]);
+        }
+    }
+    m_videoIdentities = videoIdentities;
+    m_videoFrames = videoFrames;
+
+    // 两棵树按新编号重建，旧树中哈希已更新的节点也一并丢弃
+    m_tree.nodes.clear();
+    m_tree.nodes.reserve(m_hashes.size());
+    for (int item = 0; item < m_hashes.size(); ++item) {
+        m_tree.insert(item, m_hashes[item].pHash);
+    }
+    m_videoTree.nodes.clear();
+    for (int item = 0; item < m_videoFrames.size(); ++item) {
+        for (quint64 frame : std::as_const(m_videoFrames[item])) {
+            m_videoTree.insert(item, frame);
+        }
+    }
+    m_removedItems = 0;
+}
+
+int SimilarityIndex::itemFor(const QString &fileId)
+{
+    auto it = m_items.constFind(fileId);
+    if (it != m_items.cend()) {
+        return it.value();
+    }
+    const int item = int(m_identities.size());
+    m_identities.append(fileId);
+    m_hashes.append(Hashes());
+    m_items.insert(fileId, item);
+    return item;
+}
+
+int SimilarityIndex::videoItemFor(const QString &fileId)
+{
+    auto it = m_videoItems.constFind(fileId);
+    if (it != m_videoItems.cend()) {
+        return it.value();
+    }
+    const int item = int(m_videoIdentities.size());
+    m_videoIdentities.append(fileId);
+    m_videoFrames.append(QVector<quint64>());
+    m_videoItems.insert(fileId, item);
+    return item;
+}
@@ -0,0 +1,112 @@
+#ifndef SIMILARITYINDEX_H
+#define SIMILARITYINDEX_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <QVariantList>
+
+class QTimer;
+
+// 相似图片与相似视频索引
+// 预览生成时在缩略图上计算的感知哈希（PerceptualHash）按文件标识保存在 image_hashes 表中；
+// 视频的指纹是按时间顺序抽取的若干关键帧的 pHash，保存在 video_fingerprints 表中。
+// 首次查询时整表读入，分别建 BK 树：树上每条边记录子节点与父节点的汉明距离，
+// 查询半径 r 时只需进入距离落在 [d - r, d + r] 内的子树，百万级条目的小半径查询只访问其中很小一部分。
+// 视频的每一帧单独入树，查询时统计候选视频与目标有多少帧相近，重新编码、缩放过的副本大部分帧仍能对上。
+// 采样位置按时长的比例选取，首尾被截取过的副本采到的是另一批画面，不保证能找到。
+// 文件哈希更新时旧节点不删除，只在查询时按当前哈希过滤；文件被删除时条目标记为空，
+// 空条目超过四分之一时整体重建两棵树。新哈希先写入内存，攒满一批或
+// 定时器到期后在一个事务中写库。只能在 GUI 线程使用。
+class SimilarityIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    static SimilarityIndex& instance();
+
+    // 记录文件的哈希；fileId 为文件标识
+    void record(const QString &fileId, quint64 dHash, quint64 pHash);
+    // 记录视频的关键帧哈希，按时间顺序
+    void recordVideo(const QString &fileId, const QVector<quint64> &frames);
+    // 文件已从库中删除（如孤儿回收），库中的哈希随外键级联删除，这里同步内存索引
+    void forget(const QStringList &fileIds);
+
+    // 与 fileId 相似的文件，由近到远，不含 fileId 本身。
+    // 图片按 pHash 距离不超过 maxDistance 查找，两个哈希都接近的排在前面；
+    // 视频要求至少一半关键帧在 maxDistance 内找到对应帧，对上的帧多的排在前面
+    Q_INVOKABLE QStringList findSimilar(const QString &fileId, int maxDistance = 10);
+    // 互为相似的视频分组，每组为文件标识列表，按组大小降序
+    Q_INVOKABLE QVariantList duplicateVideoGroups(int maxDistance = 10);
+
+public slots:
+    // 把尚未写库的哈希写入数据库
+    void flush();
+
+private:
+    explicit SimilarityIndex(QObject *parent = nullptr);
+    ~SimilarityIndex() = default;
+
+    SimilarityIndex(const SimilarityIndex&) = delete;
+    SimilarityIndex& operator=(const SimilarityIndex&) = delete;
+
+    struct Hashes {
+        quint64 dHash = 0;
+        quint64 pHash = 0;
+    };
+
+    // BK 树节点，子节点以单链表存放
+    struct Node {
+        quint64 hash;
+        int item;          // 所属条目的下标
+        int distance;      // 与父节点的距离
+        int firstChild = -1;
+        int nextSibling = -1;
+    };
+
+    struct BkTree {
+        QVector<Node> nodes;
+
+        void insert(int item, quint64 hash);
+        // 对距离不超过 radius 的每个节点调用 visit(node, distance)
+        template <typename Visit>
+        void search(quint64 hash, int radius, Visit visit) const;
+    };
+
+    void ensureLoaded();
+    // 丢弃已删除的条目，重新编号并重建两棵树
+    void rebuild();
+    int itemFor(const QString &fileId);
+    int videoItemFor(const QString &fileId);
+    QStringList findSimilarImages(int item, int radius) const;
+    // 相似视频的条目下标，已排序
+    QVector<int> findSimilarVideos(int item, int radius) const;
+    bool flushImages();
+    bool flushVideos();
+
+    // 图片
+    QVector<QString> m_identities;   // 按条目
+    QVector<Hashes> m_hashes;        // 按条目，当前值
+    QHash<QString, int> m_items;
+    BkTree m_tree;
+    QHash<QString, Hashes> m_pending;
+
+    // 视频
+    QVector<QString> m_videoIdentities;
+    QVector<QVector<quint64>> m_videoFrames;
+    QHash<QString, int> m_videoItems;
+    BkTree m_videoTree;
+    QHash<QString, QVector<quint64>> m_pendingVideos;
+
+    QTimer *m_flushTimer;
+    bool m_loaded;
+    // 已删除但仍在树中的条目数
+    int m_removedItems;
+
+    static const int FLUSH_INTERVAL_MS = 2000;
+    static const int FLUSH_BATCH = 500;
+};
+
+#endif // SIMILARITYINDEX_H
@@ -0,0 +1,561 @@
+#include "smartfoldermanager.h"
+#include "databasemanager.h"
+#include "tagmanager.h"
+
+// Qt Core
+#include <QDateTime>
+#include <QTimer>
+#include <QVariantMap>
+
+// Qt SQL
+#include <QSqlError>
+
+SmartFolderManager::SmartFolderManager(QObject *parent)
+    : QObject(parent)
+    , m_loaded(false)
+    , m_dayTimer(new QTimer(this))
+{
+    TagManager &tagManager = TagManager::instance();
+    connect(&tagManager, &TagManager::fileTagsChanged, this, &SmartFolderManager::onFileChanged);
+    connect(&tagManager, &TagManager::filesTagsChanged, this, &SmartFolderManager::onFilesChanged);
+    connect(&tagManager, &TagManager::tagRemoved, this, &SmartFolderManager::onTagRemoved);
+    connect(&tagManager, &TagManager::tagUpdated, this, &SmartFolderManager::onTagUpdated);
+    // 扫描在后台线程写入 files 表，信号以排队方式到达
+    connect(&DatabaseManager::instance(), &DatabaseManager::filesUpserted,
+            this, &SmartFolderManager::onFilesChanged);
+
+    m_dayTimer->setInterval(DAY_CHECK_INTERVAL_MS);
+    connect(m_dayTimer, &QTimer::timeout, this, &SmartFolderManager::refreshExpiredFolders);
+    m_dayTimer->start();
+}
+
+SmartFolderManager& SmartFolderManager::instance()
+{
+    static SmartFolderManager instance;
+    return instance;
+}
+
+QVariantList SmartFolderManager::folders()
+{
+    ensureLoaded();
+
+    QVariantList result;
+    for (const Folder &folder : std::as_const(m_folders)) {
+        const Definition &definition = folder.definition;
+        QVariantMap item;
+        item["id"] = definition.id;
+        item["name"] = definition.name;
+        item["count"] = folder.members.size();
+        item["tagQuery"] = definition.tagQuery;
+        item["minSize"] = definition.minSize;
+        item["maxSize"] = definition.maxSize;
+        item["modifiedWithinDays"] = definition.modifiedWithinDays;
+        item["extensions"] = definition.extensions;
+        result.append(item);
+    }
+    return result;
+}
+
+int SmartFolderManager::createFolder(const QString &name, const QString &tagQuery,
+                                     qint64 minSize, qint64 maxSize,
+                                     int modifiedWithinDays, const QStringList &extensions)
+{
+    ensureLoaded();
+
+    Folder folder;
+    folder.definition = {-1, name, tagQuery, minSize, maxSize, modifiedWithinDays, extensions};
+    if (!validate(folder.definition, &folder.query)) {
+        return -1;
+    }
+
+    const Definition &definition = folder.definition;
+    SqlStatement query = DatabaseManager::instance().statement(
+        "INSERT INTO smart_folders (name, tag_query, min_size, max_size, modified_within_days, extensions) "
+        "VALUES (?, ?, ?, ?, ?, ?)");
+    query.bind(0, definition.name).bind(1, definition.tagQuery);
+    definition.minSize >= 0 ? query.bind(2, definition.minSize) : query.bindNull(2);
+    definition.maxSize >= 0 ? query.bind(3, definition.maxSize) : query.bindNull(3);
+    definition.modifiedWithinDays >= 0 ? query.bind(4, definition.modifiedWithinDays) : query.bindNull(4);
+    query.bind(5, definition.extensions.join(','));
+    if (!query.exec()) {
+        emit folderError(QString("系统|智能文件夹|创建失败|%1").arg(query.errorText()));
+        return -1;
+    }
+
+    const int folderId = int(query.lastInsertId());
+    folder.definition.id = folderId;
+    m_folders.insert(folderId, folder);
+    refreshFolder(folderId);
+    return folderId;
+}
+
+bool SmartFolderManager::updateFolder(int folderId, const QString &name, const QString &tagQuery,
+                                      qint64 minSize, qint64 maxSize,
+                                      int modifiedWithinDays, const QStringList &extensions)
+{
+    ensureLoaded();
+    auto it = m_folders.find(folderId);
+    if (it == m_folders.end()) {
+        emit folderError(QString("系统|智能文件夹|更新失败|文件夹不存在: %1").arg(folderId));
+        return false;
+    }
+
+    Definition definition{folderId, name, tagQuery, minSize, maxSize, modifiedWithinDays, extensions};
+    TagQuery::NodePtr parsed;
+    if (!validate(definition, &parsed)) {
+        return false;
+    }
+
+    SqlStatement query = DatabaseManager::instance().statement(
+        "UPDATE smart_folders SET name = ?, tag_query = ?, min_size = ?, max_size = ?, "
+        "modified_within_days = ?, extensions = ? WHERE id = ?");
+    query.bind(0, definition.name).bind(1, definition.tagQuery);
+    definition.minSize >= 0 ? query.bind(2, definition.minSize) : query.bindNull(2);
+    definition.maxSize >= 0 ? query.bind(3, definition.maxSize) : query.bindNull(3);
+    definition.modifiedWithinDays >= 0 ? query.bind(4, definition.modifiedWithinDays) : query.bindNull(4);
+    query.bind(5, definition.extensions.join(',')).bind(6, folderId);
+    if (!query.exec()) {
+        emit folderError(QString("系统|智能文件夹|更新失败|%1").arg(query.errorText()));
+        return false;
+    }
+
+    it->definition = definition;
+    it->query = parsed;
+    return refreshFolder(folderId);
+}
+
+bool SmartFolderManager::removeFolder(int folderId)
+{
+    ensureLoaded();
+
+    // 成员行随外键级联删除
+    SqlStatement query = DatabaseManager::instance().statement("DELETE FROM smart_folders WHERE id = ?");
+    query.bind(0, folderId);
+    if (!query.exec()) {
+        emit folderError(QString("系统|智能文件夹|删除失败|%1").arg(query.errorText()));
+        return false;
+    }
+
+    if (m_folders.remove(folderId) > 0) {
+        emit foldersChanged();
+    }
+    return true;
+}
+
+QStringList SmartFolderManager::folderFiles(int folderId)
+{
+    ensureLoaded();
+    auto it = m_folders.constFind(folderId);
+    return it != m_folders.cend() ? QStringList(it->members.cbegin(), it->members.cend()) : QStringList();
+}
+
+int SmartFolderManager::folderCount(int folderId)
+{
+    ensureLoaded();
+    auto it = m_folders.constFind(folderId);
+    return it != m_folders.cend() ? int(it->members.size()) : 0;
+}
+
+bool SmartFolderManager::refreshFolder(int folderId)
+{
+    ensureLoaded();
+    auto it = m_folders.find(folderId);
+    if (it == m_folders.end()) {
+        return false;
+    }
+    Folder &folder = *it;
+    const Definition &definition = folder.definition;
+
+    // 表达式中的标签可能已被删除或改名，每次整体重算都重新解析
+    if (!definition.tagQuery.isEmpty()) {
+        QString error;
+        folder.query = TagQuery::parse(definition.tagQuery, [](const QString &name) {
+            Tag *tag = TagManager::instance().getTagByName(name);
+            return tag ? tag->id() : -1;
+        }, &error);
+        if (!folder.query) {
+            emit folderError(QString("系统|智能文件夹|条件无效|%1").arg(error));
+        }
+    }
+
+    // 有标签条件时候选文件来自标签查询，否则为 files 表中全部已扫描的文件
+    QHash<QString, FileFacts> facts;
+    if (!definition.tagQuery.isEmpty()) {
+        if (folder.query) {
+            facts = loadFacts(TagManager::instance().queryFiles(definition.tagQuery));
+        }
+    } else {
+        SqlStatement query = DatabaseManager::instance().statement(
+            "SELECT identity, path, size, mtime FROM files WHERE path IS NOT NULL");
+        if (!query.exec()) {
+            emit folderError(QString("系统|智能文件夹|刷新失败|%1").arg(query.errorText()));
+            return false;
+        }
+        while (query.next()) {
+            FileFacts &entry = facts[query.stringAt(0)];
+            entry.known = true;
+            entry.path = query.stringAt(1);
+            entry.size = query.isNull(2) ? -1 : query.int64At(2);
+            entry.mtime = query.isNull(3) ? -1 : query.int64At(3);
+        }
+    }
+
+    // 候选文件已满足标签条件，这里只判断文件属性
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    QSet<QString> members;
+    for (auto factIt = facts.cbegin(); factIt != facts.cend(); ++factIt) {
+        if (matches(folder, factIt.value(), nullptr, now)) {
+            members.insert(factIt.key());
+        }
+    }
+
+    if (!saveMembers(folderId, QStringList(members.cbegin(), members.cend()), QStringList(), true)) {
+        return false;
+    }
+
+    const QDateTime refreshedAt = QDateTime::currentDateTime();
+    SqlStatement query = DatabaseManager::instance().statement(
+        "UPDATE smart_folders SET refreshed_at = ? WHERE id = ?");
+    query.bind(0, refreshedAt).bind(1, folderId);
+    query.exec();
+
+    folder.members = members;
+    folder.refreshedOn = refreshedAt.date();
+    emit folderCountChanged(folderId, int(members.size()));
+    emit foldersChanged();
+    return true;
+}
+
+void SmartFolderManager::onFileChanged(const QString &fileId)
+{
+    onFilesChanged(QStringList{fileId});
+}
+
+void SmartFolderManager::onFilesChanged(const QStringList &fileIds)
+{
+    if (fileIds.isEmpty()) {
+        return;
+    }
+    ensureLoaded();
+    if (m_folders.isEmpty()) {
+        return;
+    }
+
+    // 只重新判断涉及的文件：属性取自 files 表，标签取自内存索引
+    const QHash<QString, FileFacts> facts = loadFacts(fileIds);
+    QHash<QString, QSet<int>> tags;
+    tags.reserve(fileIds.size());
+    for (const QString &fileId : fileIds) {
+        const QList<int> tagIds = TagManager::instance().getFileTagIds(fileId);
+        tags.insert(fileId, QSet<int>(tagIds.cbegin(), tagIds.cend()));
+    }
+
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    bool changed = false;
+    for (auto it = m_folders.begin(); it != m_folders.end(); ++it) {
+        Folder &folder = *it;
+        QStringList added;
+        QStringList removed;
+        for (const QString &fileId : fileIds) {
+            const bool member = matches(folder, facts.value(fileId), &tags[fileId], now);
+            if (member && !folder.members.contains(fileId)) {
+                added.append(fileId);
+            } else if (!member && folder.members.contains(fileId)) {
+                removed.append(fileId);
+            }
+        }
+        if (added.isEmpty() && removed.isEmpty()) {
+            continue;
+        }
+        if (!saveMembers(it.key(), added, removed, false)) {
+            continue;
+        }
+
+        for (const QString &fileId : std::as_const(added)) {
+            folder.members.insert(fileId);
+        }
+        for (const QString &fileId : std::as_const(removed)) {
+            folder.members.remove(fileId);
+        }
+        emit folderCountChanged(it.key(), int(folder.members.size()));
+        changed = true;
+    }
+
+    if (changed) {
+        emit foldersChanged();
+    }
+}
+
+void SmartFolderManager::onTagRemoved(int tagId)
+{
+    if (!m_loaded) {
+        return;
+    }
+
+    const QList<int> folderIds = m_folders.keys();
+    for (int folderId : folderIds) {
+        const Folder &folder = m_folders[folderId];
+        if (folder.query && references(folder.query, tagId)) {
+            refreshFolder(folderId);
+        }
+    }
+}
+
+void SmartFolderManager::onTagUpdated(Tag *tag)
+{
+    if (!m_loaded || !tag) {
+        return;
+    }
+
+    // 保存的表达式按名称引用标签，改名后以解析结果中的标签ID重新生成，否则下次解析会失败
+    auto nameOf = [](int tagId) {
+        Tag *current = TagManager::instance().getTagById(tagId);
+        return current ? current->name() : QString();
+    };
+
+    bool changed = false;
+    for (auto it = m_folders.begin(); it != m_folders.end(); ++it) {
+        Folder &folder = *it;
+        if (!folder.query || !references(folder.query, tag->id())) {
+            continue;
+        }
+        const QString tagQuery = TagQuery::format(folder.query, nameOf);
+        if (tagQuery == folder.definition.tagQuery) {
+            continue;
+        }
+
+        SqlStatement query = DatabaseManager::instance().statement(
+            "UPDATE smart_folders SET tag_query = ? WHERE id = ?");
+        query.bind(0, tagQuery).bind(1, it.key());
+        if (!query.exec()) {
+            emit folderError(QString("系统|智能文件夹|更新失败|%1").arg(query.errorText()));
+            continue;
+        }
+        folder.definition.tagQuery = tagQuery;
+        changed = true;
+    }
+
+    if (changed) {
+        emit foldersChanged();
+    }
+}
+
+void SmartFolderManager::refreshExpiredFolders()
+{
+    if (!m_loaded) {
+        return;
+    }
+
+    const QDate today = QDate::currentDate();
+    const QList<int> folderIds = m_folders.keys();
+    for (int folderId : folderIds) {
+        const Folder &folder = m_folders[folderId];
+        if (folder.definition.modifiedWithinDays >= 0 && folder.refreshedOn != today) {
+            refreshFolder(folderId);
+        }
+    }
+}
+
+void SmartFolderManager::ensureLoaded()
+{
+    if (m_loaded) {
+        return;
+    }
+    m_loaded = true;
+
+    SqlStatement definitions = DatabaseManager::instance().statement(
+        "SELECT id, name, tag_query, min_size, max_size, modified_within_days, extensions, refreshed_at "
+        "FROM smart_folders ORDER BY id");
+    if (!definitions.exec()) {
+        emit folderError(QString("系统|智能文件夹|加载失败|%1").arg(definitions.errorText()));
+        return;
+    }
+    while (definitions.next()) {
+        Folder folder;
+        Definition &definition = folder.definition;
+        definition.id = definitions.intAt(0);
+        definition.name = definitions.stringAt(1);
+        definition.tagQuery = definitions.stringAt(2);
+        definition.minSize = definitions.isNull(3) ? -1 : definitions.int64At(3);
+        definition.maxSize = definitions.isNull(4) ? -1 : definitions.int64At(4);
+        definition.modifiedWithinDays = definitions.isNull(5) ? -1 : definitions.intAt(5);
+        definition.extensions = definitions.stringAt(6).split(',', Qt::SkipEmptyParts);
+        if (!definitions.isNull(7)) {
+            folder.refreshedOn = definitions.dateTimeAt(7).date();
+        }
+        if (!definition.tagQuery.isEmpty()) {
+            folder.query = TagQuery::parse(definition.tagQuery, [](const QString &name) {
+                Tag *tag = TagManager::instance().getTagByName(name);
+                return tag ? tag->id() : -1;
+            }, nullptr);
+        }
+        m_folders.insert(definition.id, folder);
+    }
+
+    SqlStatement members = DatabaseManager::instance().statement(
+        "SELECT m.folder_id, f.identity FROM smart_folder_members m JOIN files f ON f.id = m.file_id");
+    if (!members.exec()) {
+        emit folderError(QString("系统|智能文件夹|加载失败|%1").arg(members.errorText()));
+        return;
+    }
+    while (members.next()) {
+        auto it = m_folders.find(members.intAt(0));
+        if (it != m_folders.end()) {
+            it->members.insert(members.stringAt(1));
+        }
+    }
+
+    // 上次运行之后日期已变化的文件夹推迟到事件循环中重算，不拖慢首次读取
+    QTimer::singleShot(0, this, &SmartFolderManager::refreshExpiredFolders);
+}
+
+bool SmartFolderManager::references(const TagQuery::NodePtr &node, int tagId)
+{
+    if (node->type == TagQuery::Node::Term) {
+        return node->tagId == tagId;
+    }
+    for (const TagQuery::NodePtr &child : node->children) {
+        if (references(child, tagId)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SmartFolderManager::validate(Definition &definition, TagQuery::NodePtr *query)
+{
+    definition.name = definition.name.trimmed();
+    definition.tagQuery = definition.tagQuery.trimmed();
+    if (definition.name.isEmpty()) {
+        emit folderError("系统|智能文件夹|条件无效|名称为空");
+        return false;
+    }
+
+    QStringList extensions;
+    for (QString extension : std::as_const(definition.extensions)) {
+        extension = extension.trimmed().toLower();
+        while (extension.startsWith('.')) {
+            extension.remove(0, 1);
+        }
+        if (!extension.isEmpty() && !extensions.contains(extension)) {
+            extensions.append(extension);
+        }
+    }
+    definition.extensions = extensions;
+
+    query->reset();
+    if (!definition.tagQuery.isEmpty()) {
+        QString error;
+        *query = TagQuery::parse(definition.tagQuery, [](const QString &name) {
+            Tag *tag = TagManager::instance().getTagByName(name);
+            return tag ? tag->id() : -1;
+        }, &error);
+        if (!*query) {
+            emit folderError(QString("系统|智能文件夹|条件无效|%1").arg(error));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SmartFolderManager::matches(const Folder &folder, const FileFacts &facts,
+                                 const QSet<int> *tagIds, qint64 now) const
+{
+    const Definition &definition = folder.definition;
+    if (!facts.known) {
+        return false;
+    }
+    if (definition.minSize >= 0 && facts.size < definition.minSize) {
+        return false;
+    }
+    if (definition.maxSize >= 0 && (facts.size < 0 || facts.size > definition.maxSize)) {
+        return false;
+    }
+    if (definition.modifiedWithinDays >= 0 &&
+        (facts.mtime < 0 || facts.mtime < now - qint64(definition.modifiedWithinDays) * 24 * 60 * 60)) {
+        return false;
+    }
+    if (!definition.extensions.isEmpty()) {
+        const int slash = facts.path.lastIndexOf('/');
+        const int dot = facts.path.lastIndexOf('.');
+        if (dot <= slash + 1 || !definition.extensions.contains(facts.path.mid(dot + 1).toLower())) {
+            return false;
+        }
+    }
+    if (!definition.tagQuery.isEmpty() && tagIds) {
+        return folder.query && TagQuery::matches(folder.query, *tagIds);
+    }
+    return true;
+}
+
+QHash<QString, SmartFolderManager::FileFacts> SmartFolderManager::loadFacts(const QStringList &fileIds) const
+{
+    QHash<QString, FileFacts> facts;
+    facts.reserve(fileIds.size());
+
+    for (int offset = 0; offset < fileIds.size(); offset += LOOKUP_CHUNK) {
+        const int count = qMin(LOOKUP_CHUNK, int(fileIds.size()) - offset);
+        SqlStatement query = DatabaseManager::instance().statement(
+            "SELECT identity, path, size, mtime FROM files WHERE identity IN ("
+            + SqlStatement::placeholders(count) + ")");
+        for (int i = 0; i < count; ++i) {
+            query.bind(i, fileIds.at(offset + i));
+        }
+        if (!query.exec()) {
+            continue;
+        }
+        while (query.next()) {
+            FileFacts &entry = facts[query.stringAt(0)];
+            entry.known = true;
+            entry.path = query.stringAt(1);
+            entry.size = query.isNull(2) ? -1 : query.int64At(2);
+            entry.mtime = query.isNull(3) ? -1 : query.int64At(3);
+        }
+    }
+    return facts;
+}
+
+bool SmartFolderManager::saveMembers(int folderId, const QStringList &added, const QStringList &removed,
+                                     bool replaceAll)
+{
+    QSqlDatabase db = DatabaseManager::instance().database();
+    if (!db.transaction()) {
+        emit folderError(QString("系统|智能文件夹|保存失败|%1").arg(db.lastError().text()));
+        return false;
+    }
+
+    QString error;
+    if (replaceAll) {
+        SqlStatement clear = DatabaseManager::instance().statement(
+            "DELETE FROM smart_folder_members WHERE folder_id = ?");
+        clear.bind(0, folderId);
+        if (!clear.exec()) {
+            error = clear.errorText();
+        }
+    }
+    for (int i = 0; error.isEmpty() && i < added.size(); ++i) {
+        SqlStatement insert = DatabaseManager::instance().statement(
+            "INSERT OR IGNORE INTO smart_folder_members (folder_id, file_id) "
+            "SELECT ?, id FROM files WHERE identity = ?");
+        insert.bind(0, folderId).bind(1, added.at(i));
+        if (!insert.exec()) {
+            error = insert.errorText();
+        }
+    }
+    for (int i = 0; error.isEmpty() && i < removed.size(); ++i) {
+        SqlStatement remove = DatabaseManager::instance().statement(
+            "DELETE FROM smart_folder_members WHERE folder_id = ? "
+            "AND file_id = (SELECT id FROM files WHERE identity = ?)");
+        remove.bind(0, folderId).bind(1, removed.at(i));
+        if (!remove.exec()) {
+            error = remove.errorText();
+        }
+    }
+
+    if (error.isEmpty() && db.commit()) {
+        return true;
+    }
+    db.rollback();
+    emit folderError(QString("系统|智能文件夹|保存失败|%1").arg(error.isEmpty() ? db.lastError().text() : error));
+    return false;
+}
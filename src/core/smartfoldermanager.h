@@ -0,0 +1,115 @@
+#ifndef SMARTFOLDERMANAGER_H
+#define SMARTFOLDERMANAGER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QDate>
+#include "tagquery.h"
+
+class QTimer;
+class Tag;
+
+// 智能文件夹：保存的查询（标签表达式 + 大小、修改时间、扩展名条件）及其物化的结果集
+//
+// 结果集保存在 smart_folder_members 中，启动时读入内存，数量随时可取。之后不再整体重算：
+//   - 标签变化（TagManager 的 fileTagsChanged / filesTagsChanged）与扫描写入的文件
+//     （DatabaseManager::filesUpserted）只对涉及的文件逐个重新判断，差异写回数据库；
+//   - 新建、修改定义或删除了表达式中的标签时整体重算该文件夹；
+//   - 表达式中的标签改名时按解析结果（标签ID）以新名称重写保存的表达式，成员不变；
+//   - 含"最近 N 天修改"条件的文件夹随日期推移失效，每天整体重算一次。
+// 只能在 GUI 线程使用。
+class SmartFolderManager : public QObject
+{
+    Q_OBJECT
+    // 每项为 {id, name, count, tagQuery, minSize, maxSize, modifiedWithinDays, extensions}
+    Q_PROPERTY(QVariantList folders READ folders NOTIFY foldersChanged)
+
+public:
+    // 未设置的条件为 -1 或空
+    struct Definition {
+        int id = -1;
+        QString name;
+        QString tagQuery;
+        qint64 minSize = -1;
+        qint64 maxSize = -1;
+        int modifiedWithinDays = -1;
+        QStringList extensions;  // 小写，不含点
+    };
+
+    static SmartFolderManager& instance();
+
+    QVariantList folders();
+
+public slots:
+    // 返回新文件夹的ID，失败返回 -1
+    Q_INVOKABLE int createFolder(const QString &name, const QString &tagQuery,
+                                 qint64 minSize = -1, qint64 maxSize = -1,
+                                 int modifiedWithinDays = -1, const QStringList &extensions = QStringList());
+    Q_INVOKABLE bool updateFolder(int folderId, const QString &name, const QString &tagQuery,
+                                  qint64 minSize = -1, qint64 maxSize = -1,
+                                  int modifiedWithinDays = -1, const QStringList &extensions = QStringList());
+    Q_INVOKABLE bool removeFolder(int folderId);
+
+    Q_INVOKABLE QStringList folderFiles(int folderId);
+    Q_INVOKABLE int folderCount(int folderId);
+    // 整体重算一个文件夹
+    Q_INVOKABLE bool refreshFolder(int folderId);
+
+signals:
+    void foldersChanged();
+    void folderCountChanged(int folderId, int count);
+    void folderError(const QString &message);
+
+private slots:
+    void onFilesChanged(const QStringList &fileIds);
+    void onFileChanged(const QString &fileId);
+    void onTagRemoved(int tagId);
+    void onTagUpdated(Tag *tag);
+    void refreshExpiredFolders();
+
+private:
+    explicit SmartFolderManager(QObject *parent = nullptr);
+    ~SmartFolderManager() = default;
+
+    SmartFolderManager(const SmartFolderManager&) = delete;
+    SmartFolderManager& operator=(const SmartFolderManager&) = delete;
+
+    struct Folder {
+        Definition definition;
+        TagQuery::NodePtr query;  // 表达式为空时为空指针，不按标签筛选
+        QSet<QString> members;
+        QDate refreshedOn;
+    };
+
+    // files 表中与判断相关的列，文件不在表中时 known 为 false
+    struct FileFacts {
+        bool known = false;
+        QString path;
+        qint64 size = -1;
+        qint64 mtime = -1;
+    };
+
+    void ensureLoaded();
+    static bool references(const TagQuery::NodePtr &node, int tagId);
+    bool validate(Definition &definition, TagQuery::NodePtr *query);
+    // tagIds 为空指针时不判断标签条件（候选文件已由标签查询得出）
+    bool matches(const Folder &folder, const FileFacts &facts, const QSet<int> *tagIds, qint64 now) const;
+    QHash<QString, FileFacts> loadFacts(const QStringList &fileIds) const;
+    bool saveMembers(int folderId, const QStringList &added, const QStringList &removed, bool replaceAll);
+
+    QMap<int, Folder> m_folders;
+    bool m_loaded;
+    QTimer *m_dayTimer;
+
+    // 按文件标识查询 files 表时每条语句的参数数
+    static const int LOOKUP_CHUNK = 500;
+    // 检查日期变化的间隔
+    static const int DAY_CHECK_INTERVAL_MS = 60 * 60 * 1000;
+};
+
+#endif // SMARTFOLDERMANAGER_H
@@ -0,0 +1,177 @@
+#include "sqlstatement.h"
+
+// STL
+#include <utility>
+
+// Qt SQL
+#include <QSqlError>
+
+SqlStatement::SqlStatement(const QSharedPointer<QSqlQuery> &query, bool prepared)
+    : m_query(query)
+    , m_prepared(prepared && query)
+{
+}
+
+SqlStatement::~SqlStatement()
+{
+    if (m_query) {
+        m_query->finish();
+    }
+}
+
+SqlStatement::SqlStatement(SqlStatement &&other) noexcept
+    : m_query(std::move(other.m_query))
+    , m_prepared(other.m_prepared)
+{
+    other.m_prepared = false;
+}
+
+SqlStatement &SqlStatement::operator=(SqlStatement &&other) noexcept
+{
+    if (this != &other) {
+        if (m_query) {
+            m_query->finish();
+        }
+        m_query = std::move(other.m_query);
+        m_prepared = other.m_prepared;
+        other.m_prepared = false;
+    }
+    return *this;
+}
+
+SqlStatement &SqlStatement::bind(int index, int value)
+{
+    if (m_prepared) {
+        m_query->bindValue(index, value);
+    }
+    return *this;
+}
+
+SqlStatement &SqlStatement::bind(int index, qint64 value)
+{
+    if (m_prepared) {
+        m_query->bindValue(index, value);
+    }
+    return *this;
+}
+
+SqlStatement &SqlStatement::bind(int index, double value)
+{
+    if (m_prepared) {
+        m_query->bindValue(index, value);
+    }
+    return *this;
+}
+
+SqlStatement &SqlStatement::bind(int index, const QString &value)
+{
+    if (m_prepared) {
+        m_query->bindValue(index, value);
+    }
+    return *this;
+}
+
+SqlStatement &SqlStatement::bind(int index, const QDateTime &value)
+{
+    if (m_prepared) {
+        m_query->bindValue(index, value);
+    }
+    return *this;
+}
+
+SqlStatement &SqlStatement::bind(int index, const QByteArray &value)
+{
+    if (m_prepared) {
+        m_query->bindValue(index, value);
+    }
+    return *this;
+}
+
+SqlStatement &SqlStatement::bindNull(int index)
+{
+    if (m_prepared) {
+        m_query->bindValue(index, QVariant());
+    }
+    return *this;
+}
+
+SqlStatement &SqlStatement::bindVariant(int index, const QVariant &value)
+{
+    if (m_prepared) {
+        m_query->bindValue(index, value);
+    }
+    return *this;
+}
+
+bool SqlStatement::exec()
+{
+    return m_prepared && m_query->exec();
+}
+
+bool SqlStatement::next()
+{
+    return m_prepared && m_query->next();
+}
+
+bool SqlStatement::isNull(int column) const
+{
+    return !m_prepared || m_query->isNull(column);
+}
+
+int SqlStatement::intAt(int column) const
+{
+    return m_prepared ? m_query->value(column).toInt() : 0;
+}
+
+qint64 SqlStatement::int64At(int column) const
+{
+    return m_prepared ? m_query->value(column).toLongLong() : 0;
+}
+
+double SqlStatement::doubleAt(int column) const
+{
+    return m_prepared ? m_query->value(column).toDouble() : 0.0;
+}
+
+QString SqlStatement::stringAt(int column) const
+{
+    return m_prepared ? m_query->value(column).toString() : QString();
+}
+
+QDateTime SqlStatement::dateTimeAt(int column) const
+{
+    return m_prepared ? m_query->value(column).toDateTime() : QDateTime();
+}
+
+QByteArray SqlStatement::blobAt(int column) const
+{
+    return m_prepared ? m_query->value(column).toByteArray() : QByteArray();
+}
+
+qint64 SqlStatement::lastInsertId() const
+{
+    return m_prepared ? m_query->lastInsertId().toLongLong() : -1;
+}
+
+int SqlStatement::rowsAffected() const
+{
+    return m_prepared ? m_query->numRowsAffected() : -1;
+}
+
+QString SqlStatement::errorText() const
+{
+    return m_query ? m_query->lastError().text() : QString("语句未准备");
+}
+
+QString SqlStatement::placeholders(int count, const QString &item)
+{
+    QString result;
+    result.reserve(qMax(0, count) * (item.size() + 2));
+    for (int i = 0; i < count; ++i) {
+        if (i > 0) {
+            result += QLatin1String(", ");
+        }
+        result += item;
+    }
+    return result;
+}
@@ -0,0 +1,62 @@
+#ifndef SQLSTATEMENT_H
+#define SQLSTATEMENT_H
+
+#include <QString>
+#include <QByteArray>
+#include <QDateTime>
+#include <QSharedPointer>
+#include <QSqlQuery>
+
+// 缓存中的预编译语句，由 DatabaseManager::statement() 取得
+// 参数按位置绑定、列按下标读取，各个类型有各自的重载，调用方不需要自己构造 QVariant，
+// 也不再按列名查找。语句属于取得它的线程的连接，只能在该线程内使用；
+// 同一条 SQL 在本对象使用完之前不要再次通过 statement() 获取，两者共用同一个底层语句。
+// 析构时重置语句：未读完的 SELECT 会一直占用读事务，使该连接看不到其他连接之后提交的数据。
+class SqlStatement
+{
+public:
+    SqlStatement() = default;
+    SqlStatement(const QSharedPointer<QSqlQuery> &query, bool prepared);
+    ~SqlStatement();
+
+    SqlStatement(SqlStatement &&other) noexcept;
+    SqlStatement &operator=(SqlStatement &&other) noexcept;
+    SqlStatement(const SqlStatement &) = delete;
+    SqlStatement &operator=(const SqlStatement &) = delete;
+
+    bool isPrepared() const { return m_prepared; }
+
+    SqlStatement &bind(int index, int value);
+    SqlStatement &bind(int index, qint64 value);
+    SqlStatement &bind(int index, double value);
+    SqlStatement &bind(int index, const QString &value);
+    SqlStatement &bind(int index, const QDateTime &value);
+    SqlStatement &bind(int index, const QByteArray &value);
+    SqlStatement &bindNull(int index);
+    // 类型在编译期不确定时使用
+    SqlStatement &bindVariant(int index, const QVariant &value);
+
+    bool exec();
+    bool next();
+
+    bool isNull(int column) const;
+    int intAt(int column) const;
+    qint64 int64At(int column) const;
+    double doubleAt(int column) const;
+    QString stringAt(int column) const;
+    QDateTime dateTimeAt(int column) const;
+    QByteArray blobAt(int column) const;
+
+    qint64 lastInsertId() const;
+    int rowsAffected() const;
+    QString errorText() const;
+
+    // 多行语句或 IN 列表的占位符，item 重复 count 次并以逗号分隔，如 "(?, ?), (?, ?)"
+    static QString placeholders(int count, const QString &item = QStringLiteral("?"));
+
+private:
+    QSharedPointer<QSqlQuery> m_query;
+    bool m_prepared = false;
+};
+
+#endif // SQLSTATEMENT_H
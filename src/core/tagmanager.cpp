@@ -1,12 +1,19 @@
 #include "tagmanager.h"
 #include "databasemanager.h"
+#include "tagquery.h"
 
 // Qt Core
+#include <QCoreApplication>
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QSet>
+#include <QThread>
+
+// STL
+#include <algorithm>
 
 // Qt SQL
 #include <QSqlQuery>
@@ -20,10 +27,39 @@
 #include <windows.h>
 #endif
 
+namespace {
+
+const char *const SELECT_TAGS_SQL =
+    "SELECT id, name, color, description, created_at, updated_at, parent_id FROM tags";
+
+// 按 SELECT_TAGS_SQL 的列顺序填充标签字段
+void assignTagRow(Tag *tag, const SqlStatement &query)
+{
+    tag->setId(query.intAt(0));
+    tag->setName(query.stringAt(1));
+    tag->setColor(QColor(query.stringAt(2)));
+    tag->setDescription(query.stringAt(3));
+    tag->setCreatedAt(query.dateTimeAt(4));
+    tag->setUpdatedAt(query.dateTimeAt(5));
+    tag->setParentId(query.isNull(6) ? -1 : query.intAt(6));
+}
+
+} // namespace
+
 TagManager::TagManager(QObject *parent)
     : QObject(parent)
     , m_cacheInitialized(false)
+    , m_writer(new DatabaseWriter(this))
 {
+    connect(m_writer, &DatabaseWriter::writeFailed, this, &TagManager::onWriteFailed);
+    connect(m_writer, &DatabaseWriter::drained, this, &TagManager::onWriterDrained);
+    m_writer->start();
+    
+    // 退出前提交剩余的写入，写线程连接需在数据库关闭前释放
+    if (QCoreApplication::instance()) {
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit,
+                m_writer, &DatabaseWriter::stop);
+    }
 }
 
 TagManager& TagManager::instance()
@@ -38,54 +74,61 @@ void TagManager::loadTagsCache()
         return;
     }
 
-    QSqlDatabase db = DatabaseManager::instance().database();
-    QSqlQuery query(db);
+    SqlStatement query = DatabaseManager::instance().statement(SELECT_TAGS_SQL);
     
-    if (query.exec("SELECT id, name, color, description, created_at, updated_at FROM tags")) {
+    if (query.exec()) {
         while (query.next()) {
             auto tag = QSharedPointer<Tag>::create();
-            tag->setId(query.value(0).toInt());
-            tag->setName(query.value(1).toString());
-            tag->setColor(QColor(query.value(2).toString()));
-            tag->setDescription(query.value(3).toString());
-            tag->setCreatedAt(query.value(4).toDateTime());
-            tag->setUpdatedAt(query.value(5).toDateTime());
+            assignTagRow(tag.data(), query);
             
             m_tagsCache.insert(tag->id(), tag);
         }
     } else {
-        emit tagError(QString("系统|标签|加载失败|%1").arg(query.lastError().text()));
+        emit tagError(QString("系统|标签|加载失败|%1").arg(query.errorText()));
     }
     
     m_cacheInitialized = true;
 }
 
-bool TagManager::addTag(const QString &name, const QColor &color, const QString &description)
+bool TagManager::addTag(const QString &name, const QColor &color, const QString &description, int parentId)
 {
-    QSqlDatabase db = DatabaseManager::instance().database();
-    QSqlQuery query(db);
+    loadTagsCache();
+    if (parentId > 0 && !m_tagsCache.contains(parentId)) {
+        emit tagError(QString("系统|标签|添加失败|父标签不存在: %1").arg(parentId));
+        return false;
+    }
     
-    query.prepare("INSERT INTO tags (name, color, description, created_at, updated_at) VALUES (?, ?, ?, ?, ?)");
+    // 闭包表由插入触发器维护
+    SqlStatement query = DatabaseManager::instance().statement(
+        "INSERT INTO tags (name, color, description, created_at, updated_at, parent_id) "
+        "VALUES (?, ?, ?, ?, ?, ?)");
     
-    query.addBindValue(name);
-    query.addBindValue(color.name(QColor::HexRgb));
-    query.addBindValue(description);
     QDateTime now = QDateTime::currentDateTime();
-    query.addBindValue(now);
-    query.addBindValue(now);
+    query.bind(0, name)
+         .bind(1, color.name(QColor::HexRgb))
+         .bind(2, description)
+         .bind(3, now)
+         .bind(4, now);
+    if (parentId > 0) {
+        query.bind(5, parentId);
+    } else {
+        query.bindNull(5);
+    }
     
     if (!query.exec()) {
-        emit tagError(QString("系统|标签|添加失败|%1").arg(query.lastError().text()));
+        emit tagError(QString("系统|标签|添加失败|%1").arg(query.errorText()));
         return false;
     }
     
-    int newTagId = query.lastInsertId().toInt();
+    int newTagId = int(query.lastInsertId());
+    DatabaseManager::instance().indexTag(newTagId, name, description);
     
     auto tag = QSharedPointer<Tag>::create();
     tag->setId(newTagId);
     tag->setName(name);
     tag->setColor(color);
     tag->setDescription(description);
+    tag->setParentId(parentId > 0 ? parentId : -1);
     tag->setCreatedAt(now);
     tag->setUpdatedAt(now);
     
@@ -99,38 +142,36 @@ bool TagManager::addTag(const QString &name, const QColor &color, const QString
 
 bool TagManager::removeTag(int tagId)
 {
-    QSqlDatabase db = DatabaseManager::instance().database();
-    QSqlQuery query(db);
+    // 删除标签前先提交排队中的写入，避免外键冲突
+    m_writer->flush();
     
-    query.prepare("DELETE FROM tags WHERE id = ?");
-    query.addBindValue(tagId);
+    SqlStatement query = DatabaseManager::instance().statement("DELETE FROM tags WHERE id = ?");
+    query.bind(0, tagId);
     
     if (!query.exec()) {
-        emit tagError(QString("系统|标签|删除失败|%1").arg(query.lastError().text()));
+        emit tagError(QString("系统|标签|删除失败|%1").arg(query.errorText()));
         return false;
     }
     
-    m_tagsCache.remove(tagId);
+    const QSharedPointer<Tag> removed = m_tagsCache.take(tagId);
+    reparentCachedChildren(tagId, removed ? removed->parentId() : -1);
+    m_index.removeTag(tagId);
     emit tagRemoved(tagId);
     return true;
 }
 
 bool TagManager::updateTag(int tagId, const QString &name, const QColor &color, const QString &description)
 {
-    QSqlDatabase db = DatabaseManager::instance().database();
-    QSqlQuery query(db);
-    
-    query.prepare("UPDATE tags SET name = ?, color = ?, description = ?, "
-                 "updated_at = CURRENT_TIMESTAMP WHERE id = ?");
-    query.addBindValue(name);
-    query.addBindValue(color.name());
-    query.addBindValue(description);
-    query.addBindValue(tagId);
+    SqlStatement query = DatabaseManager::instance().statement(
+        "UPDATE tags SET name = ?, color = ?, description = ?, "
+        "updated_at = CURRENT_TIMESTAMP WHERE id = ?");
+    query.bind(0, name).bind(1, color.name()).bind(2, description).bind(3, tagId);
     
     if (!query.exec()) {
-        emit tagError(QString("系统|标签|更新失败|%1").arg(query.lastError().text()));
+        emit tagError(QString("系统|标签|更新失败|%1").arg(query.errorText()));
         return false;
     }
+    DatabaseManager::instance().indexTag(tagId, name, description);
     
     if (m_tagsCache.contains(tagId)) {
         auto tag = m_tagsCache[tagId];
@@ -147,17 +188,14 @@ bool TagManager::updateTag(int tagId, const QString &name, const QColor &color,
 
 bool TagManager::addFileTag(const QString &fileId, int tagId)
 {
-    QSqlDatabase db = DatabaseManager::instance().database();
-    QSqlQuery query(db);
-    
-    query.prepare("INSERT OR IGNORE INTO file_tags (file_id, tag_id) VALUES (?, ?)");
-    query.addBindValue(fileId);
-    query.addBindValue(tagId);
-    
-    if (!query.exec()) {
-        emit tagError(QString("系统|标签|添加文件标签失败|%1").arg(query.lastError().text()));
+    if (!validateFileTagArguments(fileId, tagId, "添加")) {
         return false;
     }
+
+    // 先更新内存索引，再交给写线程异步提交；索引须已加载，否则之后的加载会覆盖这次改动
+    ensureIndexLoaded();
+    m_index.add(fileId, tagId);
+    m_writer->enqueue(DatabaseWriter::Command{DatabaseWriter::Command::AddTag, fileId, tagId});
     
     emit fileTagsChanged(fileId);
     return true;
@@ -165,17 +203,13 @@ bool TagManager::addFileTag(const QString &fileId, int tagId)
 
 bool TagManager::removeFileTag(const QString &fileId, int tagId)
 {
-    QSqlDatabase db = DatabaseManager::instance().database();
-    QSqlQuery query(db);
-    
-    query.prepare("DELETE FROM file_tags WHERE file_id = ? AND tag_id = ?");
-    query.addBindValue(fileId);
-    query.addBindValue(tagId);
-    
-    if (!query.exec()) {
-        emit tagError(QString("系统|标签|移除文件标签失败|%1").arg(query.lastError().text()));
+    if (!validateFileTagArguments(fileId, tagId, "移除")) {
         return false;
     }
+
+    ensureIndexLoaded();
+    m_index.remove(fileId, tagId);
+    m_writer->enqueue(DatabaseWriter::Command{DatabaseWriter::Command::RemoveTag, fileId, tagId});
     
     emit fileTagsChanged(fileId);
     return true;
@@ -183,21 +217,125 @@ bool TagManager::removeFileTag(const QString &fileId, int tagId)
 
 bool TagManager::clearFileTags(const QString &fileId)
 {
-    QSqlDatabase db = DatabaseManager::instance().database();
-    QSqlQuery query(db);
-    
-    query.prepare("DELETE FROM file_tags WHERE file_id = ?");
-    query.addBindValue(fileId);
-    
-    if (!query.exec()) {
-        emit tagError(QString("系统|标签|清除文件标签失败|%1").arg(query.lastError().text()));
+    // 清除不涉及具体标签，只检查文件标识
+    if (fileId.isEmpty()) {
+        emit tagError("系统|标签|清除失败|文件ID为空");
         return false;
     }
+
+    ensureIndexLoaded();
+    m_index.removeFile(fileId);
+    m_writer->enqueue(DatabaseWriter::Command{DatabaseWriter::Command::ClearFile, fileId, -1});
     
     emit fileTagsChanged(fileId);
     return true;
 }
 
+bool TagManager::validateFileTagArguments(const QString &fileId, int tagId, const QString &action)
+{
+    if (fileId.isEmpty()) {
+        emit tagError(QString("系统|标签|%1失败|文件ID为空").arg(action));
+        return false;
+    }
+    if (tagId <= 0) {
+        emit tagError(QString("系统|标签|%1失败|无效的标签ID: %2").arg(action).arg(tagId));
+        return false;
+    }
+
+    loadTagsCache();
+    if (!m_tagsCache.contains(tagId)) {
+        emit tagError(QString("系统|标签|%1失败|标签不存在: %2").arg(action).arg(tagId));
+        return false;
+    }
+    return true;
+}
+
+bool TagManager::validateBulkArguments(const QStringList &fileIds, const QList<int> &tagIds,
+                                       const QString &action)
+{
+    if (fileIds.isEmpty() || tagIds.isEmpty()) {
+        emit tagError(QString("系统|标签|%1失败|文件或标签列表为空").arg(action));
+        return false;
+    }
+
+    loadTagsCache();
+    for (int tagId : tagIds) {
+        if (!m_tagsCache.contains(tagId)) {
+            emit tagError(QString("系统|标签|%1失败|标签不存在: %2").arg(action).arg(tagId));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TagManager::addTagsToFiles(const QStringList &fileIds, const QList<int> &tagIds)
+{
+    return applyBulk(fileIds, tagIds, DatabaseWriter::Command::AddTag);
+}
+
+bool TagManager::removeTagsFromFiles(const QStringList &fileIds, const QList<int> &tagIds)
+{
+    return applyBulk(fileIds, tagIds, DatabaseWriter::Command::RemoveTag);
+}
+
+bool TagManager::applyBulk(const QStringList &fileIds, const QList<int> &tagIds,
+                           DatabaseWriter::Command::Type type)
+{
+    const bool adding = type == DatabaseWriter::Command::AddTag;
+    if (!validateBulkArguments(fileIds, tagIds, adding ? "批量添加" : "批量移除")) {
+        return false;
+    }
+
+    // 去重，避免同一批次内的重复行
+    QStringList uniqueFileIds = fileIds;
+    uniqueFileIds.removeDuplicates();
+    uniqueFileIds.removeAll(QString());
+    const QList<int> uniqueTagIds = QSet<int>(tagIds.begin(), tagIds.end()).values();
+
+    // 写线程把整批操作合并进一个事务，并按块复用多行预编译语句
+    ensureIndexLoaded();
+    QVector<DatabaseWriter::Command> commands;
+    commands.reserve(uniqueFileIds.size() * uniqueTagIds.size());
+    for (const QString &fileId : uniqueFileIds) {
+        for (int tagId : uniqueTagIds) {
+            if (adding) {
+                m_index.add(fileId, tagId);
+            } else {
+                m_index.remove(fileId, tagId);
+            }
+            commands.append(DatabaseWriter::Command{type, fileId, tagId});
+        }
+    }
+    m_writer->enqueue(commands);
+
+    emit filesTagsChanged(uniqueFileIds);
+    return true;
+}
+
+void TagManager::onWriteFailed(const QString &message, const QStringList &fileIds)
+{
+    emit tagError(QString("系统|标签|写入失败|%1").arg(message));
+
+    // 乐观更新的内存状态已与数据库不一致，写线程排空后重新加载索引，这里不等待
+    m_staleFiles.append(fileIds);
+    if (!m_writer->hasPendingWrites()) {
+        onWriterDrained();
+    }
+}
+
+void TagManager::onWriterDrained()
+{
+    if (m_staleFiles.isEmpty()) {
+        return;
+    }
+    QStringList fileIds;
+    fileIds.swap(m_staleFiles);
+    fileIds.removeDuplicates();
+    m_index.clear();
+    ensureIndexLoaded();
+    emit filesTagsChanged(fileIds);
+}
+
 bool TagManager::addTagToFileById(const QString &fileId, int tagId)
 {
     if (fileId.isEmpty()) {
@@ -225,6 +363,9 @@ bool TagManager::deleteTag(int tagId)
         return false;
     }
     
+    // 删除标签前先提交排队中的写入，避免外键冲突
+    m_writer->flush();
+    
     DatabaseManager& db = DatabaseManager::instance();
     
     if (!db.execute("DELETE FROM file_tags WHERE tag_id = ?", {tagId})) {
@@ -237,9 +378,9 @@ bool TagManager::deleteTag(int tagId)
         return false;
     }
     
-    if (m_tagsCache.contains(tagId)) {
-        m_tagsCache.remove(tagId);
-    }
+    const QSharedPointer<Tag> removed = m_tagsCache.take(tagId);
+    reparentCachedChildren(tagId, removed ? removed->parentId() : -1);
+    m_index.removeTag(tagId);
     
     emit tagDeleted(tagId);
     emit tagRemoved(tagId);
@@ -250,52 +391,110 @@ bool TagManager::deleteTag(int tagId)
 
 QList<Tag*> TagManager::getFileTags(const QString &fileId)
 {
-    QList<Tag*> tags;
-    QSqlDatabase db = DatabaseManager::instance().database();
-    QSqlQuery query(db);
+    // 返回缓存中共享的 Tag 对象，不再为每行新建
+    return getFileTagsById(fileId);
+}
+
+QStringList TagManager::getFilesByTag(int tagId, bool includeDescendants)
+{
+    ensureIndexLoaded();
+    if (!includeDescendants) {
+        return m_index.identities(m_index.filesWithTag(tagId));
+    }
     
-    query.prepare("SELECT t.* FROM tags t "
-                 "INNER JOIN file_tags ft ON ft.tag_id = t.id "
-                 "WHERE ft.file_id = ?");
-    query.addBindValue(fileId);
+    QSet<int> files;
+    for (int descendantId : getDescendantTagIds(tagId)) {
+        files.unite(m_index.filesWithTag(descendantId));
+    }
+    return m_index.identities(files);
+}
+
+QList<int> TagManager::getDescendantTagIds(int tagId)
+{
+    // 按主键前缀查闭包表，与层级深度和标签总数无关
+    QList<int> tagIds;
+    SqlStatement query = DatabaseManager::instance().statement(
+        "SELECT descendant_id FROM tag_closure WHERE ancestor_id = ?");
+    query.bind(0, tagId);
     
     if (!query.exec()) {
-        qWarning() << "获取文件标签失败:" << query.lastError().text();
-        return tags;
+        emit tagError(QString("系统|标签|查询失败|%1").arg(query.errorText()));
+        return tagIds;
     }
-    
     while (query.next()) {
-        auto tag = new Tag(this);
-        tag->setId(query.value("id").toInt());
-        tag->setName(query.value("name").toString());
-        tag->setColor(query.value("color").toString());
-        tag->setDescription(query.value("description").toString());
-        tags.append(tag);
+        tagIds.append(query.intAt(0));
     }
-    
-    return tags;
+    return tagIds;
 }
 
-QStringList TagManager::getFilesByTag(int tagId)
+bool TagManager::moveTag(int tagId, int parentId)
 {
-    QStringList fileIds;
-    QSqlDatabase db = DatabaseManager::instance().database();
-    QSqlQuery query(db);
+    return moveTags({tagId}, parentId);
+}
+
+bool TagManager::moveTags(const QList<int> &tagIds, int parentId)
+{
+    loadTagsCache();
+    for (int tagId : tagIds) {
+        if (!m_tagsCache.contains(tagId)) {
+            emit tagError(QString("系统|标签|移动失败|标签不存在: %1").arg(tagId));
+            return false;
+        }
+    }
+    if (parentId > 0 && !m_tagsCache.contains(parentId)) {
+        emit tagError(QString("系统|标签|移动失败|父标签不存在: %1").arg(parentId));
+        return false;
+    }
     
-    query.prepare("SELECT DISTINCT file_id FROM file_tags "
-                 "WHERE tag_id = ?");
-    query.addBindValue(tagId);
+    // 每次更新由触发器对整棵子树做集合式的闭包重连，全部移动在一个事务中完成；
+    // 形成环时触发器中止语句，整批回滚
+    QSqlDatabase db = DatabaseManager::instance().database();
+    if (!db.transaction()) {
+        emit tagError(QString("系统|标签|移动失败|%1").arg(db.lastError().text()));
+        return false;
+    }
     
-    if (!query.exec()) {
-        qWarning() << "获取标签文件失败:" << query.lastError().text();
-        return fileIds;
+    SqlStatement query = DatabaseManager::instance().statement(
+        "UPDATE tags SET parent_id = ?, updated_at = CURRENT_TIMESTAMP WHERE id = ?");
+    for (int tagId : tagIds) {
+        if (parentId > 0) {
+            query.bind(0, parentId);
+        } else {
+            query.bindNull(0);
+        }
+        query.bind(1, tagId);
+        if (!query.exec()) {
+            emit tagError(QString("系统|标签|移动失败|%1").arg(query.errorText()));
+            db.rollback();
+            return false;
+        }
     }
     
-    while (query.next()) {
-        fileIds.append(query.value("file_id").toString());
+    if (!db.commit()) {
+        emit tagError(QString("系统|标签|移动失败|%1").arg(db.lastError().text()));
+        db.rollback();
+        return false;
     }
     
-    return fileIds;
+    const QDateTime now = QDateTime::currentDateTime();
+    for (int tagId : tagIds) {
+        const auto &tag = m_tagsCache[tagId];
+        tag->setParentId(parentId > 0 ? parentId : -1);
+        tag->setUpdatedAt(now);
+        emit tagUpdated(tag.data());
+    }
+    emit tagsChanged();
+    return true;
+}
+
+void TagManager::reparentCachedChildren(int tagId, int parentId)
+{
+    for (const auto &tag : m_tagsCache) {
+        if (tag->parentId() == tagId) {
+            tag->setParentId(parentId);
+            emit tagUpdated(tag.data());
+        }
+    }
 }
 
 QVector<Tag*> TagManager::getAllTags()
@@ -327,55 +526,128 @@ Tag* TagManager::getTagByName(const QString &name)
 
 QList<QPair<QString, int>> TagManager::getTagStats()
 {
-    QList<QPair<QString, int>> stats;
-    QSqlDatabase db = DatabaseManager::instance().database();
-    QSqlQuery query(db);
-    
-    query.prepare(
-        "SELECT t.name, COUNT(ft.file_id) as count "
-        "FROM tags t "
-        "LEFT JOIN file_tags ft ON t.id = ft.tag_id "
-        "GROUP BY t.id, t.name "
-        "ORDER BY count DESC"
-    );
+    // 直接取内存索引中各标签的文件数，已包含尚未提交的写入，不需要等待写线程
+    loadTagsCache();
+    ensureIndexLoaded();
+    const QHash<int, qint64> counts = m_index.cardinality();
     
-    if (query.exec()) {
-        while (query.next()) {
-            stats.append({
-                query.value(0).toString(),
-                query.value(1).toInt()
-            });
-        }
+    QList<QPair<QString, int>> stats;
+    stats.reserve(m_tagsCache.size());
+    for (auto it = m_tagsCache.cbegin(); it != m_tagsCache.cend(); ++it) {
+        stats.append({it.value()->name(), int(counts.value(it.key(), 0))});
     }
+    std::stable_sort(stats.begin(), stats.end(), [](const auto &a, const auto &b) {
+        return a.second > b.second;
+    });
     
     return stats;
 }
 
 QStringList TagManager::getRecentFiles(int limit)
 {
+    // 只读已提交的记录，不等待写线程；合并窗口内刚标记的文件下次读取时出现
     QStringList files;
-    QSqlDatabase db = DatabaseManager::instance().database();
-    QSqlQuery query(db);
     
-    query.prepare(
-        "SELECT DISTINCT file_id "
-        "FROM file_tags "
-        "ORDER BY created_at DESC "
+    // recent_files 按 seq 顺序保存最近标记的文件，倒序读取前 limit 行即可
+    SqlStatement query = DatabaseManager::instance().statement(
+        "SELECT f.identity "
+        "FROM recent_files r JOIN files f ON f.id = r.file_id "
+        "ORDER BY r.seq DESC "
         "LIMIT ?"
     );
-    query.addBindValue(limit);
+    query.bind(0, limit);
     
     if (query.exec()) {
         while (query.next()) {
-            files.append(query.value(0).toString());
+            files.append(query.stringAt(0));
         }
     }
     
     return files;
 }
 
+void TagManager::ensureIndexLoaded()
+{
+    if (m_index.isLoaded()) {
+        return;
+    }
+
+    // 不等待写线程：已写入内存但尚未提交的操作在加载完成后重放
+    QVector<FileTagIndex::Change> pending;
+    const QVector<DatabaseWriter::Command> commands = m_writer->pendingCommands();
+    pending.reserve(commands.size());
+    for (const DatabaseWriter::Command &command : commands) {
+        switch (command.type) {
+        case DatabaseWriter::Command::AddTag:
+            pending.append({FileTagIndex::Change::Add, command.fileId, command.tagId});
+            break;
+        case DatabaseWriter::Command::RemoveTag:
+            pending.append({FileTagIndex::Change::Remove, command.fileId, command.tagId});
+            break;
+        case DatabaseWriter::Command::ClearFile:
+            pending.append({FileTagIndex::Change::RemoveFile, command.fileId, -1});
+            break;
+        }
+    }
+
+    QString error;
+    if (!m_index.load(DatabaseManager::instance().database(), pending, &error)) {
+        emit tagError(QString("系统|标签|索引加载失败|%1").arg(error));
+    }
+}
+
+qint64 TagManager::streamQueryFiles(const QString &expression,
+                                    const std::function<bool(const QString &)> &sink)
+{
+    QSqlDatabase db = DatabaseManager::instance().database();
+    const bool onGuiThread = QThread::currentThread() == thread();
+
+    // 标签缓存只在 GUI 线程访问，后台线程通过自己的连接解析标签名
+    QString error;
+    TagQuery::NodePtr root = TagQuery::parse(expression, [this, onGuiThread](const QString &name) {
+        if (onGuiThread) {
+            Tag *tag = getTagByName(name);
+            return tag ? tag->id() : -1;
+        }
+        SqlStatement query = DatabaseManager::instance().statement("SELECT id FROM tags WHERE name = ?");
+        query.bind(0, name);
+        return query.exec() && query.next() ? query.intAt(0) : -1;
+    }, &error);
+
+    if (!root) {
+        emit tagError(QString("系统|标签|查询失败|%1").arg(error));
+        return -1;
+    }
+
+    ensureIndexLoaded();
+    // 仍有未提交的写入时数据库落后于索引，只能在内存中求值
+    TagQuery plan(root, m_index.cardinality(), m_index.fileCount(), !m_writer->hasPendingWrites());
+
+    TagQuery::Source source;
+    source.filesWithTag = [this](int tagId) { return m_index.filesWithTag(tagId); };
+    source.allTaggedFiles = [this]() { return m_index.allFiles(); };
+    source.identity = [this](int handle) { return m_index.identity(handle); };
+
+    qint64 count = plan.execute(db, source, sink, &error);
+    if (count < 0) {
+        emit tagError(QString("系统|标签|查询失败|%1").arg(error));
+    }
+    return count;
+}
+
+QStringList TagManager::queryFiles(const QString &expression)
+{
+    QStringList fileIds;
+    streamQueryFiles(expression, [&fileIds](const QString &fileId) {
+        fileIds.append(fileId);
+        return true;
+    });
+    return fileIds;
+}
+
 TagManager::~TagManager()
 {
+    m_writer->stop();
     clearCache();
 }
 
@@ -385,47 +657,138 @@ void TagManager::clearCache()
     m_cacheInitialized = false;
 }
 
+void TagManager::reloadFromDatabase()
+{
+    // QML 持有的是缓存里 Tag 对象的裸指针，不能整体丢弃缓存：
+    // 已有标签原地更新，新标签插入，只移除数据库中确实不存在的标签
+    SqlStatement query = DatabaseManager::instance().statement(SELECT_TAGS_SQL);
+    if (!query.exec()) {
+        emit tagError(QString("系统|标签|加载失败|%1").arg(query.errorText()));
+        return;
+    }
+
+    QSet<int> present;
+    QList<Tag*> added;
+    QList<Tag*> updated;
+    while (query.next()) {
+        const int tagId = query.intAt(0);
+        present.insert(tagId);
+
+        auto it = m_tagsCache.find(tagId);
+        if (it == m_tagsCache.end()) {
+            auto tag = QSharedPointer<Tag>::create();
+            assignTagRow(tag.data(), query);
+            m_tagsCache.insert(tagId, tag);
+            added.append(tag.data());
+            continue;
+        }
+
+        Tag *tag = it.value().data();
+        if (tag->updatedAt() != query.dateTimeAt(5) || tag->name() != query.stringAt(1)
+            || tag->color() != QColor(query.stringAt(2)) || tag->description() != query.stringAt(3)
+            || tag->parentId() != (query.isNull(6) ? -1 : query.intAt(6))) {
+            assignTagRow(tag, query);
+            updated.append(tag);
+        }
+    }
+
+    QList<int> removed;
+    for (auto it = m_tagsCache.cbegin(); it != m_tagsCache.cend(); ++it) {
+        if (!present.contains(it.key())) {
+            removed.append(it.key());
+        }
+    }
+    m_cacheInitialized = true;
+
+    // 文件标签关系随导入整体替换，索引下次访问时重新加载（未提交的写入会被重放）
+    m_index.clear();
+
+    for (Tag *tag : added) {
+        emit tagAdded(tag);
+    }
+    for (Tag *tag : updated) {
+        emit tagUpdated(tag);
+    }
+    for (int tagId : removed) {
+        QSharedPointer<Tag> gone = m_tagsCache.take(tagId);
+        emit tagRemoved(tagId);
+    }
+    emit tagsChanged();
+}
+
+void TagManager::forgetFiles(const QStringList &fileIds)
+{
+    if (fileIds.isEmpty()) {
+        return;
+    }
+    
+    for (const QString &fileId : fileIds) {
+        m_index.removeFile(fileId);
+    }
+    emit filesTagsChanged(fileIds);
+}
+
 bool TagManager::isTagNameExists(const QString &name) const {
-    QSqlQuery query(DatabaseManager::instance().database());
-    query.prepare("SELECT COUNT(*) FROM tags WHERE name = ?");
-    query.addBindValue(name);
+    SqlStatement query = DatabaseManager::instance().statement("SELECT COUNT(*) FROM tags WHERE name = ?");
+    query.bind(0, name);
     
     if (query.exec() && query.next()) {
-        return query.value(0).toInt() > 0;
+        return query.intAt(0) > 0;
     }
     return false;
 }
 
 QVector<Tag*> TagManager::getFileTagsById(const QString &fileId)
 {
+    // 确保标签缓存已加载
+    loadTagsCache();
+    
+    const QList<int> tagIds = getFileTagIds(fileId);
     QVector<Tag*> tags;
-    QSqlDatabase db = DatabaseManager::instance().database();
-    QSqlQuery query(db);
+    tags.reserve(tagIds.size());
+    for (int tagId : tagIds) {
+        // 从缓存中获取标签对象
+        auto it = m_tagsCache.constFind(tagId);
+        if (it != m_tagsCache.cend()) {
+            tags.append(it->data());
+        }
+    }
+    
+    return tags;
+}
+
+QList<int> TagManager::getFileTagIds(const QString &fileId)
+{
+    ensureIndexLoaded();
+    const QSet<int> tagIdSet = m_index.tagsOfFile(fileId);
+    QList<int> tagIds(tagIdSet.begin(), tagIdSet.end());
+    std::sort(tagIds.begin(), tagIds.end());
+    return tagIds;
+}
+
+QVector<Tag*> TagManager::suggestTags(const QString &fileId, const QString &filePath, int limit)
+{
+    QVector<Tag*> tags;
+    if (fileId.isEmpty()) {
+        return tags;
+    }
     
-    // 确保标签缓存已加载
     loadTagsCache();
+    ensureIndexLoaded();
     
-    query.prepare(
-        "SELECT t.id FROM tags t "
-        "INNER JOIN file_tags ft ON t.id = ft.tag_id "
-        "WHERE ft.file_id = ?"
-    );
-    query.addBindValue(fileId);
+    // 本次会话中新标记的文件在索引里没有路径，由调用方提供后参与目录与扩展名统计
+    if (!filePath.isEmpty()) {
+        m_index.setLocation(fileId, QDir::fromNativeSeparators(filePath));
+    }
     
-    if (query.exec()) {
-        while (query.next()) {
-            int tagId = query.value("id").toInt();
-            
-            // 从缓存中获取标签对象
-            if (m_tagsCache.contains(tagId)) {
-                Tag* tag = m_tagsCache[tagId].data();
-                tags.append(tag);
-            }
+    const QVector<FileTagIndex::Suggestion> suggestions = m_index.suggest(fileId, limit);
+    tags.reserve(suggestions.size());
+    for (const FileTagIndex::Suggestion &suggestion : suggestions) {
+        auto it = m_tagsCache.constFind(suggestion.tagId);
+        if (it != m_tagsCache.cend()) {
+            tags.append(it->data());
         }
-    } else {
-        qWarning() << "Failed to execute query:" << query.lastError().text();
     }
-    
     return tags;
 }
 
@@ -5,7 +5,10 @@
 #include <QVector>
 #include <QHash>
 #include <QSharedPointer>
+#include <functional>
 #include "../models/tag.h"
+#include "filetagindex.h"
+#include "databasewriter.h"
 
 #ifdef Q_OS_WIN
 #include <windows.h>
@@ -20,13 +23,20 @@ public:
     
 public slots:
     // 标签操作
-    bool addTag(const QString &name, const QColor &color = Qt::blue, const QString &description = QString());
+    bool addTag(const QString &name, const QColor &color = Qt::blue, const QString &description = QString(),
+                int parentId = -1);
     bool removeTag(int tagId);
     bool updateTag(int tagId, const QString &name, const QColor &color, const QString &description);
     
+    // 标签层级：parentId 为 -1 表示移到顶层，整棵子树随之移动；不允许移到自己的子树下
+    Q_INVOKABLE bool moveTag(int tagId, int parentId);
+    Q_INVOKABLE bool moveTags(const QList<int> &tagIds, int parentId);
+    // 返回标签自身及其全部后代的ID
+    Q_INVOKABLE QList<int> getDescendantTagIds(int tagId);
+    
     // 文件标签操作（只保留基于fileId的方法）
     QList<Tag*> getFileTags(const QString &fileId);
-    QStringList getFilesByTag(int tagId);
+    QStringList getFilesByTag(int tagId, bool includeDescendants = false);
     
     // 查询操作
     QVector<Tag*> getAllTags();
@@ -35,7 +45,12 @@ public slots:
     
     // 数据库查询
     QList<QPair<QString, int>> getTagStats();  // 获取每个标签的使用次数
-    QStringList getRecentFiles(int limit = 10);  // 获取最近标记的文件
+    QStringList getRecentFiles(int limit = 10);  // 获取最近标记的文件（最多保留最近 1000 个）
+    
+    // 布尔标签查询，如 "(holiday OR travel) AND NOT blurry"
+    Q_INVOKABLE QStringList queryFiles(const QString &expression);
+    // 流式返回匹配的 fileId，sink 返回 false 时提前结束；返回输出数量，失败返回 -1
+    qint64 streamQueryFiles(const QString &expression, const std::function<bool(const QString &)> &sink);
     
     Q_INVOKABLE bool isTagNameExists(const QString &name) const;
     Q_INVOKABLE bool deleteTag(int tagId);
@@ -44,22 +59,39 @@ public slots:
     Q_INVOKABLE bool addTagToFileById(const QString &fileId, int tagId);
     Q_INVOKABLE bool removeTagFromFileById(const QString &fileId, int tagId);
     Q_INVOKABLE QVector<Tag*> getFileTagsById(const QString &fileId);
+    Q_INVOKABLE QList<int> getFileTagIds(const QString &fileId);
     Q_INVOKABLE QVector<QString> getFilesByTagId(int tagId);
+    // 标签建议：综合文件已有标签的共现、同目录与同扩展名文件的标签，全部在内存索引中计算
+    Q_INVOKABLE QVector<Tag*> suggestTags(const QString &fileId, const QString &filePath = QString(), int limit = 8);
     
     // 基础文件标签操作
     bool addFileTag(const QString &fileId, int tagId);
     bool removeFileTag(const QString &fileId, int tagId);
     bool clearFileTags(const QString &fileId);
+    
+    // 批量文件标签操作（单事务、分块多行写入，只发出一次变更通知）
+    Q_INVOKABLE bool addTagsToFiles(const QStringList &fileIds, const QList<int> &tagIds);
+    Q_INVOKABLE bool removeTagsFromFiles(const QStringList &fileIds, const QList<int> &tagIds);
+    
+    // 数据库被外部直接修改（如导入）后，原地刷新标签缓存并丢弃文件标签索引，下次访问时重新加载
+    void reloadFromDatabase();
+    // 文件及其关联已从数据库中删除（如孤儿回收），同步内存索引并发出变更通知
+    void forgetFiles(const QStringList &fileIds);
 
 signals:
     void tagAdded(Tag* tag);
     void tagRemoved(int tagId);
     void tagUpdated(Tag* tag);
     void fileTagsChanged(const QString &fileId);
+    void filesTagsChanged(const QStringList &fileIds);  // 批量操作的合并通知
     void tagError(const QString &message);
     void tagsChanged();
     void tagDeleted(int tagId);
 
+private slots:
+    void onWriteFailed(const QString &message, const QStringList &fileIds);
+    void onWriterDrained();
+
 private:
     explicit TagManager(QObject *parent = nullptr);
     ~TagManager();
@@ -72,9 +104,29 @@ private:
     void loadTagsCache();
     void clearCache();
     
+    // 文件标签索引，首次读取时加载
+    void ensureIndexLoaded();
+    
     QHash<int, QSharedPointer<Tag>> m_tagsCache;
     bool m_cacheInitialized;
     
+    FileTagIndex m_index;
+    // 写入失败的文件：索引与数据库不一致，等写线程排空后重新加载并通知
+    QStringList m_staleFiles;
+    
+    // 文件标签写入由独立线程合并提交
+    DatabaseWriter *m_writer;
+    
+    // 入队前确认文件标识非空、标签存在；无效的操作会让写线程整批回滚
+    bool validateFileTagArguments(const QString &fileId, int tagId, const QString &action);
+    bool validateBulkArguments(const QStringList &fileIds, const QList<int> &tagIds,
+                               const QString &action);
+    bool applyBulk(const QStringList &fileIds, const QList<int> &tagIds,
+                   DatabaseWriter::Command::Type type);
+    
+    // 标签删除后，数据库触发器已把其子标签挂到它的父标签下，缓存同步这一变化
+    void reparentCachedChildren(int tagId, int parentId);
+    
     bool ensureFileIdentifier(const QString &filePath);
     void migrateOldData(); // 数据迁移
 };
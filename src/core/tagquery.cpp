@@ -0,0 +1,642 @@
+#include "tagquery.h"
+
+// Qt Core
+#include <QStringList>
+
+// Qt SQL
+#include <QSqlQuery>
+#include <QSqlError>
+
+// STL
+#include <algorithm>
+
+namespace {
+
+struct Token {
+    enum Kind { Name, And, Or, Not, LParen, RParen, End };
+    Kind kind;
+    QString text;
+};
+
+bool tokenize(const QString &expression, QVector<Token> &tokens, QString *error)
+{
+    static const QString specialChars = QStringLiteral("()&|!\"");
+    const int length = expression.size();
+    int i = 0;
+
+    while (i < length) {
+        const QChar c = expression.at(i);
+        if (c.isSpace()) {
+            ++i;
+        } else if (c == '(') {
+            tokens.append({Token::LParen, QString()});
+            ++i;
+        } else if (c == ')') {
+            tokens.append({Token::RParen, QString()});
+            ++i;
+        } else if (c == '&' || c == '|') {
+            tokens.append({c == '&' ? Token::And : Token::Or, QString()});
+            // 兼容 && 与 || 写法
+            i += (i + 1 < length && expression.at(i + 1) == c) ? 2 : 1;
+        } else if (c == '!') {
+            tokens.append({Token::Not, QString()});
+            ++i;
+        } else if (c == '"') {
+            QString name;
+            bool closed = false;
+            ++i;
+            while (i < length) {
+                const QChar ch = expression.at(i++);
+                if (ch == '\\' && i < length) {
+                    name.append(expression.at(i++));
+                } else if (ch == '"') {
+                    closed = true;
+                    break;
+                } else {
+                    name.append(ch);
+                }
+            }
+            if (!closed) {
+                *error = "引号未闭合";
+                return false;
+            }
+            tokens.append({Token::Name, name});
+        } else {
+            const int start = i;
+            while (i < length && !expression.at(i).isSpace() && !specialChars.contains(expression.at(i))) {
+                ++i;
+            }
+            const QString word = expression.mid(start, i - start);
+            const QString upper = word.toUpper();
+            if (upper == "AND") {
+                tokens.append({Token::And, QString()});
+            } else if (upper == "OR") {
+                tokens.append({Token::Or, QString()});
+            } else if (upper == "NOT") {
+                tokens.append({Token::Not, QString()});
+            } else {
+                tokens.append({Token::Name, word});
+            }
+        }
+    }
+
+    tokens.append({Token::End, QString()});
+    return true;
+}
+
+// 递归下降解析，优先级 NOT > AND > OR
+class Parser
+{
+public:
+    Parser(const QVector<Token> &tokens, const TagQuery::TagResolver &resolver)
+        : m_tokens(tokens), m_resolver(resolver), m_pos(0) {}
+
+    TagQuery::NodePtr parse()
+    {
+        TagQuery::NodePtr root = parseOr();
+        if (root && peek().kind != Token::End) {
+            return fail("表达式末尾存在多余内容");
+        }
+        return root;
+    }
+
+    QString error() const { return m_error; }
+
+private:
+    const Token &peek() const { return m_tokens.at(m_pos); }
+    const Token &take() { return m_tokens.at(m_pos++); }
+
+    TagQuery::NodePtr fail(const QString &message)
+    {
+        if (m_error.isEmpty()) {
+            m_error = message;
+        }
+        return TagQuery::NodePtr();
+    }
+
+    TagQuery::NodePtr makeNode(TagQuery::Node::Type type)
+    {
+        auto node = TagQuery::NodePtr::create();
+        node->type = type;
+        return node;
+    }
+
+    TagQuery::NodePtr parseOr()
+    {
+        TagQuery::NodePtr left = parseAnd();
+        if (!left || peek().kind != Token::Or) {
+            return left;
+        }
+
+        TagQuery::NodePtr node = makeNode(TagQuery::Node::Or);
+        node->children.append(left);
+        while (peek().kind == Token::Or) {
+            take();
+            TagQuery::NodePtr right = parseAnd();
+            if (!right) {
+                return TagQuery::NodePtr();
+            }
+            node->children.append(right);
+        }
+        return node;
+    }
+
+    TagQuery::NodePtr parseAnd()
+    {
+        TagQuery::NodePtr left = parseUnary();
+        if (!left) {
+            return left;
+        }
+
+        TagQuery::NodePtr node;
+        while (true) {
+            const Token::Kind kind = peek().kind;
+            const bool implicitAnd = kind == Token::Name || kind == Token::Not || kind == Token::LParen;
+            if (kind != Token::And && !implicitAnd) {
+                break;
+            }
+            if (kind == Token::And) {
+                take();
+            }
+
+            TagQuery::NodePtr right = parseUnary();
+            if (!right) {
+                return TagQuery::NodePtr();
+            }
+            if (!node) {
+                node = makeNode(TagQuery::Node::And);
+                node->children.append(left);
+            }
+            node->children.append(right);
+        }
+        return node ? node : left;
+    }
+
+    TagQuery::NodePtr parseUnary()
+    {
+        if (peek().kind == Token::Not) {
+            take();
+            TagQuery::NodePtr child = parseUnary();
+            if (!child) {
+                return TagQuery::NodePtr();
+            }
+            TagQuery::NodePtr node = makeNode(TagQuery::Node::Not);
+            node->children.append(child);
+            return node;
+        }
+        return parsePrimary();
+    }
+
+    TagQuery::NodePtr parsePrimary()
+    {
+        const Token &token = take();
+        switch (token.kind) {
+            case Token::LParen: {
+                TagQuery::NodePtr inner = parseOr();
+                if (!inner) {
+                    return TagQuery::NodePtr();
+                }
+                if (take().kind != Token::RParen) {
+                    return fail("括号不匹配");
+                }
+                return inner;
+            }
+            case Token::Name: {
+                const int tagId = m_resolver(token.text);
+                if (tagId < 0) {
+                    return fail(QString("标签不存在: %1").arg(token.text));
+                }
+                TagQuery::NodePtr node = makeNode(TagQuery::Node::Term);
+                node->tagId = tagId;
+                return node;
+            }
+            case Token::End:
+                return fail("表达式不完整");
+            default:
+                return fail("缺少标签名");
+        }
+    }
+
+    const QVector<Token> &m_tokens;
+    const TagQuery::TagResolver &m_resolver;
+    int m_pos;
+    QString m_error;
+};
+
+const QString UNIVERSE_SQL = QStringLiteral("SELECT file_id FROM file_tags");
+
+// 标签名与 tokenize 的规则对应：含空白或特殊字符、为空或与运算符同名时加引号
+QString quoteName(const QString &name)
+{
+    static const QString specialChars = QStringLiteral("()&|!\"\\");
+    const QString upper = name.toUpper();
+    bool needsQuotes = name.isEmpty() || upper == "AND" || upper == "OR" || upper == "NOT";
+    for (int i = 0; !needsQuotes && i < name.size(); ++i) {
+        needsQuotes = name.at(i).isSpace() || specialChars.contains(name.at(i));
+    }
+    if (!needsQuotes) {
+        return name;
+    }
+
+    QString quoted = name;
+    quoted.replace('\\', QStringLiteral("\\\\")).replace('"', QStringLiteral("\\\""));
+    return '"' + quoted + '"';
+}
+
+} // namespace
+
+TagQuery::NodePtr TagQuery::parse(const QString &expression, const TagResolver &resolver, QString *error)
+{
+    QString message;
+    QVector<Token> tokens;
+    NodePtr root;
+
+    if (tokenize(expression, tokens, &message)) {
+        Parser parser(tokens, resolver);
+        root = parser.parse();
+        message = parser.error();
+    }
+
+    if (!root && error) {
+        *error = message;
+    }
+    return root;
+}
+
+QString TagQuery::format(const NodePtr &node, const std::function<QString(int tagId)> &nameOf)
+{
+    if (!node) {
+        return QString();
+    }
+    if (node->type == Node::Term) {
+        return quoteName(nameOf(node->tagId));
+    }
+
+    // 子表达式优先级低于当前运算符时加括号，优先级 NOT > AND > OR
+    auto operand = [&nameOf](const NodePtr &child, Node::Type parent) {
+        const QString text = format(child, nameOf);
+        const bool lower = (parent == Node::Not && (child->type == Node::And || child->type == Node::Or))
+                        || (parent == Node::And && child->type == Node::Or);
+        return lower ? '(' + text + ')' : text;
+    };
+
+    if (node->type == Node::Not) {
+        return node->children.isEmpty() ? QString() : "NOT " + operand(node->children.first(), Node::Not);
+    }
+
+    QStringList parts;
+    for (const NodePtr &child : node->children) {
+        parts.append(operand(child, node->type));
+    }
+    return parts.join(node->type == Node::And ? QStringLiteral(" AND ") : QStringLiteral(" OR "));
+}
+
+TagQuery::TagQuery(const NodePtr &root, const QHash<int, qint64> &cardinality, qint64 universe,
+                   bool allowSql)
+    : m_cardinality(cardinality)
+    , m_universe(universe)
+    , m_strategy(Strategy::InMemory)
+{
+    m_root = normalize(root);
+    if (!m_root) {
+        return;
+    }
+
+    estimate(m_root);
+
+    qint64 totalWork = work(m_root);
+    if (needsUniverse(m_root)) {
+        totalWork += m_universe;
+    }
+    m_strategy = (!allowSql || totalWork <= IN_MEMORY_WORK_LIMIT) ? Strategy::InMemory : Strategy::Sql;
+}
+
+TagQuery::NodePtr TagQuery::normalize(const NodePtr &node) const
+{
+    if (!node || node->type == Node::Term) {
+        return node;
+    }
+
+    if (node->type == Node::Not) {
+        NodePtr child = normalize(node->children.first());
+        // NOT NOT x => x
+        if (child->type == Node::Not) {
+            return child->children.first();
+        }
+        auto result = NodePtr::create();
+        result->type = Node::Not;
+        result->children.append(child);
+        return result;
+    }
+
+    // 展平同类嵌套: a AND (b AND c) => AND(a, b, c)
+    auto result = NodePtr::create();
+    result->type = node->type;
+    for (const NodePtr &child : node->children) {
+        NodePtr normalized = normalize(child);
+        if (normalized->type == node->type) {
+            result->children.append(normalized->children);
+        } else {
+            result->children.append(normalized);
+        }
+    }
+    return result->children.size() == 1 ? result->children.first() : result;
+}
+
+void TagQuery::estimate(const NodePtr &node) const
+{
+    switch (node->type) {
+        case Node::Term:
+            node->estimate = m_cardinality.value(node->tagId, 0);
+            break;
+
+        case Node::Not:
+            estimate(node->children.first());
+            node->estimate = qMax<qint64>(0, m_universe - node->children.first()->estimate);
+            break;
+
+        case Node::Or: {
+            qint64 total = 0;
+            for (const NodePtr &child : node->children) {
+                estimate(child);
+                total += child->estimate;
+            }
+            node->estimate = qMin(total, m_universe);
+            std::sort(node->children.begin(), node->children.end(),
+                      [](const NodePtr &a, const NodePtr &b) { return a->estimate < b->estimate; });
+            break;
+        }
+
+        case Node::And: {
+            qint64 smallest = m_universe;
+            for (const NodePtr &child : node->children) {
+                estimate(child);
+                smallest = qMin(smallest, child->estimate);
+            }
+            node->estimate = smallest;
+
+            // 基数小的正向项先求交集，NOT 项最后作为差集
+            std::stable_sort(node->children.begin(), node->children.end(),
+                             [](const NodePtr &a, const NodePtr &b) {
+                                 const bool aNot = a->type == Node::Not;
+                                 const bool bNot = b->type == Node::Not;
+                                 if (aNot != bNot) {
+                                     return !aNot;
+                                 }
+                                 return a->estimate < b->estimate;
+                             });
+            break;
+        }
+    }
+}
+
+qint64 TagQuery::work(const NodePtr &node) const
+{
+    if (node->type == Node::Term) {
+        return node->estimate;
+    }
+
+    qint64 total = 0;
+    for (const NodePtr &child : node->children) {
+        total += work(child);
+    }
+    return total;
+}
+
+bool TagQuery::needsUniverse(const NodePtr &node) const
+{
+    switch (node->type) {
+        case Node::Term:
+            return false;
+        case Node::Not:
+            return true;
+        case Node::And:
+            // 全部为 NOT 项的交集需要以全集为起点
+            if (node->children.first()->type == Node::Not) {
+                return true;
+            }
+            for (const NodePtr &child : node->children) {
+                if (child->type != Node::Not && needsUniverse(child)) {
+                    return true;
+                }
+                if (child->type == Node::Not && needsUniverse(child->children.first())) {
+                    return true;
+                }
+            }
+            return false;
+        case Node::Or:
+            for (const NodePtr &child : node->children) {
+                if (needsUniverse(child)) {
+                    return true;
+                }
+            }
+            return false;
+    }
+    return false;
+}
+
+QString TagQuery::toSubSelect(const NodePtr &node, QVariantList &binds) const
+{
+    // 复合查询的成员必须是简单 SELECT，嵌套的复合查询需要包一层子查询
+    if (node->type == Node::Term) {
+        return toSql(node, binds);
+    }
+    return QString("SELECT file_id FROM (%1)").arg(toSql(node, binds));
+}
+
+QString TagQuery::toSql(const NodePtr &node, QVariantList &binds) const
+{
+    switch (node->type) {
+        case Node::Term:
+            binds.append(node->tagId);
+            return QStringLiteral("SELECT file_id FROM file_tags WHERE tag_id = ?");
+
+        case Node::Not:
+            return UNIVERSE_SQL + " EXCEPT " + toSubSelect(node->children.first(), binds);
+
+        case Node::Or: {
+            QStringList parts;
+            for (const NodePtr &child : node->children) {
+                parts.append(toSubSelect(child, binds));
+            }
+            return parts.join(" UNION ");
+        }
+
+        case Node::And: {
+            QStringList positives;
+            QStringList negatives;
+            for (const NodePtr &child : node->children) {
+                if (child->type == Node::Not) {
+                    negatives.append(toSubSelect(child->children.first(), binds));
+                } else {
+                    positives.append(toSubSelect(child, binds));
+                }
+            }
+
+            QString sql = positives.isEmpty() ? UNIVERSE_SQL : positives.join(" INTERSECT ");
+            for (const QString &negative : negatives) {
+                sql += " EXCEPT " + negative;
+            }
+            return sql;
+        }
+    }
+    return QString();
+}
+
+bool TagQuery::matches(const NodePtr &node, const QSet<int> &tagIds)
+{
+    if (!node || tagIds.isEmpty()) {
+        return false;
+    }
+
+    switch (node->type) {
+        case Node::Term:
+            return tagIds.contains(node->tagId);
+
+        case Node::Not:
+            return !matches(node->children.first(), tagIds);
+
+        case Node::Or:
+            for (const NodePtr &child : node->children) {
+                if (matches(child, tagIds)) {
+                    return true;
+                }
+            }
+            return false;
+
+        case Node::And:
+            for (const NodePtr &child : node->children) {
+                if (!matches(child, tagIds)) {
+                    return false;
+                }
+            }
+            return true;
+    }
+    return false;
+}
+
+QSet<int> TagQuery::evaluate(const NodePtr &node, const Source &source) const
+{
+    switch (node->type) {
+        case Node::Term:
+            return source.filesWithTag(node->tagId);
+
+        case Node::Not: {
+            QSet<int> result = source.allTaggedFiles();
+            result.subtract(evaluate(node->children.first(), source));
+            return result;
+        }
+
+        case Node::Or: {
+            QSet<int> result;
+            for (const NodePtr &child : node->children) {
+                result.unite(evaluate(child, source));
+            }
+            return result;
+        }
+
+        case Node::And: {
+            QSet<int> result;
+            bool started = false;
+            for (const NodePtr &child : node->children) {
+                if (started && result.isEmpty()) {
+                    break;
+                }
+
+                if (child->type == Node::Not) {
+                    if (!started) {
+                        result = source.allTaggedFiles();
+                        started = true;
+                    }
+                    result.subtract(evaluate(child->children.first(), source));
+                } else if (!started) {
+                    result = evaluate(child, source);
+                    started = true;
+                } else {
+                    result.intersect(evaluate(child, source));
+                }
+            }
+            return result;
+        }
+    }
+    return QSet<int>();
+}
+
+qint64 TagQuery::execute(QSqlDatabase db, const Source &source, const FileSink &sink, QString *error) const
+{
+    if (!m_root) {
+        if (error) {
+            *error = "查询计划为空";
+        }
+        return -1;
+    }
+
+    qint64 delivered = 0;
+
+    if (m_strategy == Strategy::InMemory) {
+        const QSet<int> result = evaluate(m_root, source);
+        for (int handle : result) {
+            ++delivered;
+            if (!sink(source.identity(handle))) {
+                break;
+            }
+        }
+        return delivered;
+    }
+
+    // 复合查询只在整数键上运算，最后一步才换回文件标识
+    QVariantList binds;
+    const QString sql = QString("SELECT identity FROM files WHERE id IN (%1)").arg(toSql(m_root, binds));
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.prepare(sql)) {
+        if (error) {
+            *error = query.lastError().text();
+        }
+        return -1;
+    }
+    for (const QVariant &bind : binds) {
+        query.addBindValue(bind);
+    }
+    if (!query.exec()) {
+        if (error) {
+            *error = query.lastError().text();
+        }
+        return -1;
+    }
+
+    while (query.next()) {
+        ++delivered;
+        if (!sink(query.value(0).toString())) {
+            break;
+        }
+    }
+    return delivered;
+}
+
+QString TagQuery::describe() const
+{
+    if (!m_root) {
+        return QString();
+    }
+    return QString("%1 via %2")
+        .arg(describe(m_root),
+             m_strategy == Strategy::InMemory ? QStringLiteral("memory") : QStringLiteral("sql"));
+}
+
+QString TagQuery::describe(const NodePtr &node) const
+{
+    if (node->type == Node::Term) {
+        return QString("#%1[%2]").arg(node->tagId).arg(node->estimate);
+    }
+
+    QStringList parts;
+    for (const NodePtr &child : node->children) {
+        parts.append(describe(child));
+    }
+
+    const QString name = node->type == Node::And ? QStringLiteral("AND")
+                       : node->type == Node::Or ? QStringLiteral("OR") : QStringLiteral("NOT");
+    return QString("%1(%2)[%3]").arg(name, parts.join(", ")).arg(node->estimate);
+}
@@ -0,0 +1,84 @@
+#ifndef TAGQUERY_H
+#define TAGQUERY_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QVariant>
+#include <QSharedPointer>
+#include <QSqlDatabase>
+#include <functional>
+
+// 标签布尔查询
+// 表达式示例: (holiday OR travel) AND NOT blurry
+//   - 运算符 AND / OR / NOT 不区分大小写，也可写作 & / | / !
+//   - 两个相邻的项之间省略运算符时按 AND 处理
+//   - 含空格或特殊字符的标签名用双引号括起来，如 "my tag"
+// 规划阶段按标签基数对交集排序，并根据估算工作量在内存求值与 SQL 复合查询之间选择。
+class TagQuery
+{
+public:
+    struct Node {
+        enum Type { Term, And, Or, Not };
+        Type type = Term;
+        int tagId = -1;
+        QVector<QSharedPointer<Node>> children;
+        qint64 estimate = 0;  // 规划后估算的结果行数
+    };
+    using NodePtr = QSharedPointer<Node>;
+
+    enum class Strategy { InMemory, Sql };
+
+    // 标签名解析，返回 -1 表示标签不存在
+    using TagResolver = std::function<int(const QString &name)>;
+    // 逐个接收匹配的 fileId，返回 false 时停止
+    using FileSink = std::function<bool(const QString &fileId)>;
+
+    // 内存求值所需的数据来源，集合中是文件句柄，输出前通过 identity 转回文件标识
+    struct Source {
+        std::function<QSet<int>(int tagId)> filesWithTag;
+        std::function<QSet<int>()> allTaggedFiles;
+        std::function<QString(int handle)> identity;
+    };
+
+    // 解析失败返回空指针，并通过 error 返回原因
+    static NodePtr parse(const QString &expression, const TagResolver &resolver, QString *error);
+    // 把解析结果按当前标签名写回表达式，parse 的逆操作；标签改名后用于更新保存的表达式
+    static QString format(const NodePtr &node, const std::function<QString(int tagId)> &nameOf);
+
+    // 根据每个标签的关联数量和已标记文件总数生成执行计划，allowSql 为 false 时始终在内存中求值
+    TagQuery(const NodePtr &root, const QHash<int, qint64> &cardinality, qint64 universe,
+             bool allowSql = true);
+
+    Strategy strategy() const { return m_strategy; }
+    qint64 estimatedRows() const { return m_root ? m_root->estimate : 0; }
+    QString describe() const;
+
+    // 执行查询并流式输出结果，返回输出的数量，失败返回 -1
+    qint64 execute(QSqlDatabase db, const Source &source, const FileSink &sink, QString *error) const;
+
+    // 判断一个文件的标签集合是否满足表达式，与集合求值一致：没有标签的文件不属于全集，NOT 也不匹配
+    static bool matches(const NodePtr &node, const QSet<int> &tagIds);
+
+    // 估算工作量不超过此值时在内存中求值，否则交给 SQLite 的 INTERSECT/EXCEPT
+    static const qint64 IN_MEMORY_WORK_LIMIT = 200000;
+
+private:
+    NodePtr normalize(const NodePtr &node) const;
+    void estimate(const NodePtr &node) const;
+    qint64 work(const NodePtr &node) const;
+    bool needsUniverse(const NodePtr &node) const;
+
+    QString toSql(const NodePtr &node, QVariantList &binds) const;
+    QString toSubSelect(const NodePtr &node, QVariantList &binds) const;
+    QSet<int> evaluate(const NodePtr &node, const Source &source) const;
+    QString describe(const NodePtr &node) const;
+
+    NodePtr m_root;
+    QHash<int, qint64> m_cardinality;
+    qint64 m_universe;
+    Strategy m_strategy;
+};
+
+#endif // TAGQUERY_H
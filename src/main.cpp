@@ -9,9 +9,16 @@
 #include <QtQuickControls2/QQuickStyle>
 #include <QDir>
 #include <QStandardPaths>
+#include <QTimer>
 #include "core/databasemanager.h"
 #include "core/tagmanager.h"
+#include "core/databasebackup.h"
+#include "core/orphancollector.h"
+#include "core/smartfoldermanager.h"
+#include "core/similarityindex.h"
 #include "utils/logger.h"
+#include "utils/thumbnailprovider.h"
+#include "utils/placeholder.h"
 
 Q_DECLARE_METATYPE(QVector<FileData>)
 
@@ -61,7 +68,21 @@ int main(int argc, char *argv[])
             Q_UNUSED(scriptEngine)
             return &TagManager::instance();
         });
+    qmlRegisterSingletonType<SmartFolderManager>("FileManager", 1, 0, "SmartFolderManager",
+        [](QQmlEngine *engine, QJSEngine *scriptEngine) -> QObject* {
+            Q_UNUSED(engine)
+            Q_UNUSED(scriptEngine)
+            return &SmartFolderManager::instance();
+        });
+    qmlRegisterSingletonType<SimilarityIndex>("FileManager", 1, 0, "SimilarityIndex",
+        [](QQmlEngine *engine, QJSEngine *scriptEngine) -> QObject* {
+            Q_UNUSED(engine)
+            Q_UNUSED(scriptEngine)
+            return &SimilarityIndex::instance();
+        });
     qmlRegisterType<Tag>("FileManager", 1, 0, "Tag");
+    qmlRegisterType<DatabaseBackup>("FileManager", 1, 0, "DatabaseBackup");
+    qmlRegisterType<OrphanCollector>("FileManager", 1, 0, "OrphanCollector");
     qRegisterMetaType<Tag*>();
     qRegisterMetaType<QVector<Tag*>>();
 
@@ -75,6 +96,9 @@ int main(int argc, char *argv[])
     engine.addImportPath("qrc:/qml");
     engine.addImportPath("qrc:/qml/dialogs");
     engine.addImportPath("qrc:/qml/settings");
+    // 预览图从缩略图包中读取，引擎接管提供器的所有权
+    engine.addImageProvider(ThumbnailProvider::PROVIDER_ID, new ThumbnailProvider);
+    engine.addImageProvider(PlaceholderProvider::PROVIDER_ID, new PlaceholderProvider);
     const QUrl url(u"qrc:/qml/main.qml"_qs);
     QObject::connect(&engine, &QQmlApplicationEngine::objectCreated,
                      &app, [url](QObject *obj, const QUrl &objUrl) {
@@ -83,6 +107,17 @@ int main(int argc, char *argv[])
     }, Qt::QueuedConnection);
     engine.load(url);
     
+    // 启动一分钟后在后台回收孤儿关联，避开启动时的目录扫描；
+    // 之后定期运行，处理期间登记的扫描和到期的缺失文件
+    OrphanCollector orphanCollector;
+    QTimer orphanTimer;
+    orphanTimer.setInterval(30 * 60 * 1000);
+    QObject::connect(&orphanTimer, &QTimer::timeout, &orphanCollector, &OrphanCollector::collect);
+    QTimer::singleShot(60 * 1000, &orphanCollector, [&orphanCollector, &orphanTimer]() {
+        orphanCollector.collect();
+        orphanTimer.start();
+    });
+    
     appLogger->info("应用程序初始化完成");
 
     int result = app.exec();
@@ -23,6 +23,7 @@ FileData::FileData(const FileData &other)
     , m_relativePath(other.m_relativePath)
     , m_previewPath(other.m_previewPath)
     , m_previewLoading(other.m_previewLoading)
+    , m_placeholder(other.m_placeholder)
 {
 }
 
@@ -40,6 +41,7 @@ FileData& FileData::operator=(const FileData &other)
         m_relativePath = other.m_relativePath;
         m_previewPath = other.m_previewPath;
         m_previewLoading = other.m_previewLoading;
+        m_placeholder = other.m_placeholder;
     }
     return *this;
 }
@@ -57,6 +59,7 @@ FileData::FileData(FileData &&other) noexcept
     m_relativePath = std::move(other.m_relativePath);
     m_previewPath = std::move(other.m_previewPath);
     m_previewLoading = other.m_previewLoading;
+    m_placeholder = std::move(other.m_placeholder);
     
     other.setParent(nullptr);
 }
@@ -75,6 +78,7 @@ FileData& FileData::operator=(FileData &&other) noexcept
         m_relativePath = std::move(other.m_relativePath);
         m_previewPath = std::move(other.m_previewPath);
         m_previewLoading = other.m_previewLoading;
+        m_placeholder = std::move(other.m_placeholder);
         
         other.setParent(nullptr);
     }
@@ -153,6 +157,14 @@ void FileData::setPreviewLoading(bool loading)
     }
 }
 
+void FileData::setPlaceholder(const QByteArray &placeholder)
+{
+    if (m_placeholder != placeholder) {
+        m_placeholder = placeholder;
+        emit placeholderChanged();
+    }
+}
+
 void FileData::clearPreview()
 {
     m_preview = QImage();  // 清除预览图像
@@ -5,6 +5,7 @@
 #include <QString>
 #include <QDateTime>
 #include <QImage>
+#include <QByteArray>
 
 class FileData : public QObject
 {
@@ -56,6 +57,9 @@ public:
     void setPreviewPath(const QString &path);
     bool previewLoading() const { return m_previewLoading; }
     void setPreviewLoading(bool loading);
+    // 低清占位图数据（Placeholder::encode），缩略图读出前显示
+    QByteArray placeholder() const { return m_placeholder; }
+    void setPlaceholder(const QByteArray &placeholder);
 
     void setFileName(const QString &fileName);
     void setFileIcon(const QString &fileIcon);
@@ -84,6 +88,7 @@ signals:
     void relativePathChanged();
     void previewPathChanged();
     void previewLoadingChanged();
+    void placeholderChanged();
 
 private:
     QString m_fileName;
@@ -96,6 +101,7 @@ private:
     QString m_relativePath;
     QString m_previewPath;
     bool m_previewLoading = false;
+    QByteArray m_placeholder;
     QImage m_preview;
     bool m_previewGenerated = false;
 };
@@ -6,7 +6,10 @@
 #include <QDebug>
 #include <algorithm>
 #include <QRegularExpression>
+#include <QtMath>
 #include <QImageReader>
+#include "../utils/thumbnailstore.h"
+#include "../utils/placeholder.h"
 
 FileListModel::FileListModel(QObject *parent)
     : QAbstractListModel(parent)
@@ -50,15 +53,19 @@ QVariant FileListModel::data(const QModelIndex &index, int role) const
             return file->modifiedDate().toString("yyyy-MM-dd hh:mm:ss");
         case PreviewPathRole: {
             QString path = file->previewPath();
-            // if (!path.isEmpty()) {
-            //     qDebug() << "返回预览路径:" << file->fileName() << path;
-            // }
+            // 缩略图按层级保存，取与当前图标大小和质量相符的一级
+            if (!path.isEmpty()) {
+                path += "/" + QString::number(previewLevel());
+            }
             return path;
         }
         case PreviewLoadingRole:
             return file->previewLoading();
         case FileIdRole:
             return file->fileId();
+        case PlaceholderRole:
+            // 数据直接编码在 URL 中，由 PlaceholderProvider 同步解码
+            return Placeholder::urlFor(file->placeholder());
         default:
             return defaultValue(role);
     }
@@ -132,7 +139,8 @@ QHash<int, QByteArray> FileListModel::roleNames() const
         {IndexRole, "index"},
         {PreviewPathRole, "previewPath"},
         {PreviewLoadingRole, "previewLoading"},
-        {FileIdRole, "fileId"}
+        {FileIdRole, "fileId"},
+        {PlaceholderRole, "placeholder"}
     };
 }
 
@@ -144,6 +152,14 @@ FileData* FileListModel::getFileData(int index) const {
     return m_filteredFiles[index].data();
 }
 
+QSharedPointer<FileData> FileListModel::fileAt(int row) const {
+    if (row < 0 || row >= m_filteredFiles.size()) {
+        return QSharedPointer<FileData>();
+    }
+    
+    return m_filteredFiles.at(row);
+}
+
 void FileListModel::setSortRole(SortRole role)
 {
     if (m_sortRole != role) {
@@ -259,6 +275,8 @@ QVariant FileListModel::defaultValue(int role) const
             return QString();
         case PreviewLoadingRole:
             return false;
+        case PlaceholderRole:
+            return QString();
         default:
             return QVariant();
     }
@@ -365,19 +383,37 @@ void FileListModel::setIconSize(int size)
 {
     qDebug() << "FileListModel::setIconSize:" << size;
     if (m_iconSize != size) {
+        const int previousLevel = previewLevel();
         m_iconSize = size;
         emit iconSizeChanged();
-        // 发送提示信号
-        emit restartRequired();
+        // 缩略图各层级都已生成，只在层级变化时切换来源
+        if (previewLevel() != previousLevel) {
+            refreshPreviews();
+        }
+    }
+}
+
+int FileListModel::previewLevel() const
+{
+    // 低质量允许轻微放大，高质量为高分屏留出两倍像素
+    double factor = 1.0;
+    if (m_previewQuality == "low") {
+        factor = 0.75;
+    } else if (m_previewQuality == "high") {
+        factor = 2.0;
     }
+    return ThumbnailStore::levelFor(qCeil(m_iconSize * factor));
 }
 
 void FileListModel::setPreviewQuality(const QString &quality)
 {
     if (m_previewQuality != quality) {
+        const int previousLevel = previewLevel();
         m_previewQuality = quality;
         emit previewQualityChanged();
         // 更新预览
-        refreshPreviews();
+        if (previewLevel() != previousLevel) {
+            refreshPreviews();
+        }
     }
 }
@@ -36,7 +36,8 @@ public:
         IndexRole,
         PreviewPathRole,
         PreviewLoadingRole,
-        FileIdRole
+        FileIdRole,
+        PlaceholderRole
     };
 
     enum SortRole {
@@ -63,6 +64,7 @@ public:
     QString previewQuality() const { return m_previewQuality; }
 
     Q_INVOKABLE FileData* getFileData(int index) const;
+    QSharedPointer<FileData> fileAt(int row) const;
     QString getFileId(const QString &filePath) const;
     void updateFiles(const QVector<QSharedPointer<FileData>>& newFiles);
     Q_INVOKABLE void refreshPreviews();
@@ -116,6 +118,8 @@ private:
     QString m_previewQuality = "medium";
     
     void initialize();
+    // 当前图标大小与预览质量对应的缩略图层级
+    int previewLevel() const;
     void sort();
     bool matchesFilter(const QString &fileName) const;
 };
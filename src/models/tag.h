@@ -13,6 +13,7 @@ class Tag : public QObject
     Q_PROPERTY(QString name READ name WRITE setName NOTIFY nameChanged)
     Q_PROPERTY(QColor color READ color WRITE setColor NOTIFY colorChanged)
     Q_PROPERTY(QString description READ description WRITE setDescription NOTIFY descriptionChanged)
+    Q_PROPERTY(int parentId READ parentId WRITE setParentId NOTIFY parentIdChanged)
 
 public:
     explicit Tag(QObject *parent = nullptr);
@@ -49,6 +50,15 @@ public:
         }
     }
     
+    // 父标签ID，-1 表示顶层标签
+    int parentId() const { return m_parentId; }
+    void setParentId(int parentId) { 
+        if (m_parentId != parentId) {
+            m_parentId = parentId; 
+            emit parentIdChanged();
+        }
+    }
+    
     QDateTime createdAt() const { return m_createdAt; }
     void setCreatedAt(const QDateTime &dt) { m_createdAt = dt; }
     
@@ -60,12 +70,14 @@ signals:
     void nameChanged();
     void colorChanged();
     void descriptionChanged();
+    void parentIdChanged();
 
 private:
     int m_id{-1};
     QString m_name;
     QColor m_color{Qt::blue};
     QString m_description;
+    int m_parentId{-1};
     QDateTime m_createdAt;
     QDateTime m_updatedAt;
 };
@@ -0,0 +1,294 @@
+#include "embeddedpreview.h"
+#include <QBuffer>
+#include <QFile>
+#include <QImageReader>
+#include <QSet>
+#include <QTransform>
+#include <QVector>
+
+namespace {
+
+// 只读取文件开头这么多字节来解析目录
+const qint64 HEADER_BYTES = 512 * 1024;
+// 读取候选预览开头这么多字节来获取尺寸
+const qint64 PROBE_BYTES = 64 * 1024;
+// 单张预览的大小上限
+const qint64 MAX_PREVIEW_BYTES = 32LL * 1024 * 1024;
+// 最多解析的 IFD 数与候选数，防止损坏文件中的环和超长链表
+const int MAX_IFDS = 16;
+const int MAX_CANDIDATES = 8;
+
+struct Candidate {
+    qint64 offset;
+    qint64 length;
+};
+
+// 在文件头缓冲区中按 TIFF 字节序读取，偏移相对于 TIFF 头；越界时返回 0
+class TiffReader {
+public:
+    TiffReader(const QByteArray &data, qint64 base)
+        : m_data(data)
+        , m_base(base)
+        , m_littleEndian(false)
+        , m_valid(false) {
+        if (!inRange(0, 8)) {
+            return;
+        }
+        const char *header = data.constData() + base;
+        if (header[0] == 'I' && header[1] == 'I') {
+            m_littleEndian = true;
+        } else if (header[0] != 'M' || header[1] != 'M') {
+            return;
+        }
+        m_valid = u16(2) == 42;
+    }
+
+    bool isValid() const { return m_valid; }
+
+    quint16 u16(qint64 offset) const {
+        if (!inRange(offset, 2)) {
+            return 0;
+        }
+        const uchar *p = reinterpret_cast<const uchar *>(m_data.constData() + m_base + offset);
+        return m_littleEndian ? quint16(p[0] | p[1] << 8) : quint16(p[0] << 8 | p[1]);
+    }
+
+    quint32 u32(qint64 offset) const {
+        if (!inRange(offset, 4)) {
+            return 0;
+        }
+        const uchar *p = reinterpret_cast<const uchar *>(m_data.constData() + m_base + offset);
+        return m_littleEndian ? quint32(p[0]) | quint32(p[1]) << 8 | quint32(p[2]) << 16 | quint32(p[3]) << 24
+                              : quint32(p[0]) << 24 | quint32(p[1]) << 16 | quint32(p[2]) << 8 | quint32(p[3]);
+    }
+
+    // 遍历 IFD 链与 SubIFD，收集内嵌 JPEG；第一个 IFD 中的方向写入 orientation
+    void collect(QVector<Candidate> *candidates, int *orientation) const {
+        QVector<quint32> queue = {u32(4)};
+        QSet<quint32> visited;
+        bool first = true;
+        while (!queue.isEmpty() && visited.size() < MAX_IFDS) {
+            const quint32 ifd = queue.takeFirst();
+            if (ifd == 0 || visited.contains(ifd) || !inRange(ifd, 2)) {
+                continue;
+            }
+            visited.insert(ifd);
+
+            const int count = u16(ifd);
+            if (!inRange(ifd + 2, qint64(count) * 12 + 4)) {
+                continue;
+            }
+
+            quint32 jpegOffset = 0;
+            quint32 jpegLength = 0;
+            quint32 stripOffset = 0;
+            quint32 stripLength = 0;
+            quint32 compression = 0;
+            quint32 subfileType = 1;
+            for (int i = 0; i < count; ++i) {
+                const qint64 entry = ifd + 2 + qint64(i) * 12;
+                const quint16 tag = u16(entry);
+                const quint16 type = u16(entry + 2);
+                const quint32 n = u32(entry + 4);
+                // SHORT 类型的值在前两个字节
+                const quint32 value = type == 3 ? u16(entry + 8) : u32(entry + 8);
+                switch (tag) {
+                case 0x00FE: subfileType = value; break;
+                case 0x0103: compression = value; break;
+                case 0x0111: if (n == 1) stripOffset = value; break;
+                case 0x0117: if (n == 1) stripLength = value; break;
+                case 0x0112: if (first) *orientation = int(value); break;
+                case 0x0201: jpegOffset = value; break;
+                case 0x0202: jpegLength = value; break;
+                case 0x014A:
+                    if (n == 1) {
+                        queue.append(value);
+                    } else {
+                        for (quint32 k = 0; k < n && k < quint32(MAX_IFDS); ++k) {
+                            queue.append(u32(qint64(value) + k * 4));
+                        }
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            if (jpegOffset && jpegLength) {
+                candidates->append({m_base + jpegOffset, jpegLength});
+            }
+            // 单条带的 JPEG 压缩目录：CR2 的全尺寸预览、DNG 的预览；DNG 的主图是无损 JPEG，跳过
+            const bool primaryRaw = compression == 7 && subfileType == 0;
+            if ((compression == 6 || compression == 7) && !primaryRaw && stripOffset && stripLength) {
+                candidates->append({m_base + stripOffset, stripLength});
+            }
+
+            queue.append(u32(ifd + 2 + qint64(count) * 12));
+            first = false;
+        }
+    }
+
+    // MPF（CIPA DC-007）索引中除主图以外的图像，偏移相对于 MPF 的 TIFF 头
+    void collectMpf(QVector<Candidate> *candidates) const {
+        const quint32 ifd = u32(4);
+        const int count = u16(ifd);
+        for (int i = 0; i < count; ++i) {
+            const qint64 entry = ifd + 2 + qint64(i) * 12;
+            if (u16(entry) != 0xB002) {
+                continue;
+            }
+            const quint32 bytes = u32(entry + 4);
+            const quint32 table = u32(entry + 8);
+            for (quint32 k = 0; k + 16 <= bytes && k / 16 < quint32(MAX_CANDIDATES); k += 16) {
+                const quint32 size = u32(qint64(table) + k + 4);
+                const quint32 offset = u32(qint64(table) + k + 8);
+                if (offset && size) {
+                    candidates->append({m_base + offset, size});
+                }
+            }
+        }
+    }
+
+private:
+    bool inRange(qint64 offset, qint64 size) const {
+        return offset >= 0 && m_base + offset + size <= m_data.size();
+    }
+
+    const QByteArray &m_data;
+    qint64 m_base;
+    bool m_littleEndian;
+    bool m_valid;
+};
+
+// 遍历 JPEG 开头的标记段，解析 APP1 中的 EXIF 与 APP2 中的 MPF
+void collectFromJpeg(const QByteArray &head, QVector<Candidate> *candidates, int *orientation) {
+    const uchar *data = reinterpret_cast<const uchar *>(head.constData());
+    qint64 pos = 2;
+    while (pos + 4 <= head.size() && data[pos] == 0xFF) {
+        const uchar marker = data[pos + 1];
+        // 图像数据开始，后面没有元数据段
+        if (marker == 0xDA || marker == 0xD9) {
+            break;
+        }
+        const qint64 length = data[pos + 2] << 8 | data[pos + 3];
+        const qint64 payload = pos + 4;
+        if (marker == 0xE1 && head.mid(payload, 6) == QByteArray("Exif\0\0", 6)) {
+            TiffReader reader(head, payload + 6);
+            if (reader.isValid()) {
+                reader.collect(candidates, orientation);
+            }
+        } else if (marker == 0xE2 && head.mid(payload, 4) == QByteArray("MPF\0", 4)) {
+            TiffReader reader(head, payload + 4);
+            if (reader.isValid()) {
+                reader.collectMpf(candidates);
+            }
+        }
+        pos += 2 + length;
+    }
+}
+
+// 只读取候选开头的一小段来获取尺寸
+QSize probe(QFile &file, const Candidate &candidate) {
+    if (!file.seek(candidate.offset)) {
+        return QSize();
+    }
+    QByteArray prefix = file.read(qMin(candidate.length, PROBE_BYTES));
+    if (prefix.size() < 2 || uchar(prefix[0]) != 0xFF || uchar(prefix[1]) != 0xD8) {
+        return QSize();
+    }
+    QBuffer buffer(&prefix);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer, "jpeg");
+    return reader.size();
+}
+
+} // namespace
+
+QImage EmbeddedPreview::load(const QString &path, int dimension, bool requireDimension) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QImage();
+    }
+
+    const QByteArray head = file.read(HEADER_BYTES);
+    QVector<Candidate> candidates;
+    int orientation = 1;
+    if (head.size() > 4 && uchar(head[0]) == 0xFF && uchar(head[1]) == 0xD8) {
+        collectFromJpeg(head, &candidates, &orientation);
+    } else {
+        TiffReader reader(head, 0);
+        if (reader.isValid()) {
+            reader.collect(&candidates, &orientation);
+        }
+    }
+
+    // 足够大的候选中取最小的一张，否则记下最大的一张
+    const qint64 fileSize = file.size();
+    Candidate best{0, 0};
+    QSize bestSize;
+    Candidate largest{0, 0};
+    QSize largestSize;
+    for (int i = 0; i < candidates.size() && i < MAX_CANDIDATES; ++i) {
+        const Candidate &candidate = candidates[i];
+        if (candidate.offset + candidate.length > fileSize || candidate.length > MAX_PREVIEW_BYTES) {
+            continue;
+        }
+        const QSize size = probe(file, candidate);
+        if (!size.isValid()) {
+            continue;
+        }
+        const int longSide = qMax(size.width(), size.height());
+        if (longSide >= dimension && (!bestSize.isValid() || longSide < qMax(bestSize.width(), bestSize.height()))) {
+            best = candidate;
+            bestSize = size;
+        }
+        if (!largestSize.isValid() || longSide > qMax(largestSize.width(), largestSize.height())) {
+            largest = candidate;
+            largestSize = size;
+        }
+    }
+    if (!bestSize.isValid()) {
+        if (requireDimension || !largestSize.isValid()) {
+            return QImage();
+        }
+        best = largest;
+        bestSize = largestSize;
+    }
+
+    if (!file.seek(best.offset)) {
+        return QImage();
+    }
+    QByteArray jpeg = file.read(best.length);
+    QBuffer buffer(&jpeg);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer, "jpeg");
+
+    // 与普通图片相同：按两倍目标尺寸做 DCT 缩小解码，再平滑缩放
+    const QSize targetSize = bestSize.width() <= dimension && bestSize.height() <= dimension
+        ? bestSize : bestSize.scaled(dimension, dimension, Qt::KeepAspectRatio);
+    const QSize decodeSize = targetSize * 2;
+    if (decodeSize.width() < bestSize.width() && decodeSize.height() < bestSize.height()) {
+        reader.setScaledSize(decodeSize);
+    }
+    QImage image = reader.read();
+    if (image.isNull()) {
+        return QImage();
+    }
+    if (image.size() != targetSize) {
+        image = image.scaled(targetSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    return applyOrientation(image, orientation);
+}
+
+QImage EmbeddedPreview::applyOrientation(const QImage &image, int orientation) {
+    switch (orientation) {
+    case 2: return image.mirrored(true, false);
+    case 3: return image.mirrored(true, true);
+    case 4: return image.mirrored(false, true);
+    case 5: return image.transformed(QTransform().rotate(90)).mirrored(true, false);
+    case 6: return image.transformed(QTransform().rotate(90));
+    case 7: return image.transformed(QTransform().rotate(90)).mirrored(false, true);
+    case 8: return image.transformed(QTransform().rotate(270));
+    default: return image;
+    }
+}
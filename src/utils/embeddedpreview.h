@@ -0,0 +1,15 @@
+#pragma once
+#include <QImage>
+#include <QString>
+
+// 读取文件内嵌的 JPEG 预览，不解码原图
+// 只解析文件头部（JPEG 的 EXIF/MPF 段，或 CR2/NEF/ARW/DNG 的 TIFF 目录），
+// 再按偏移读取选中的那一张预览，并按 EXIF 方向旋转。
+namespace EmbeddedPreview {
+    // 取长边不小于 dimension 的最小一张预览，解码后不超过 dimension；
+    // 都不够大时 requireDimension 为 true 返回空，否则取最大的一张
+    QImage load(const QString &path, int dimension, bool requireDimension);
+
+    // 按 EXIF 方向（1-8）把图像转为正向
+    QImage applyOrientation(const QImage &image, int orientation);
+}
@@ -4,11 +4,18 @@
 namespace FileTypes {
     // 图片文件格式
     const QStringList IMAGE_EXTENSIONS = {
-        "jpg", "jpeg", "png", "gif", "bmp", "webp", "tiff", "svg", "ico"
+        "jpg", "jpeg", "png", "gif", "bmp", "webp", "tiff", "svg", "ico",
+        "cr2", "nef", "arw", "dng"
     };
     
     const QStringList IMAGE_FILTERS = {
-        "*.jpg", "*.jpeg", "*.png", "*.gif", "*.bmp", "*.webp", "*.tiff", "*.svg", "*.ico"
+        "*.jpg", "*.jpeg", "*.png", "*.gif", "*.bmp", "*.webp", "*.tiff", "*.svg", "*.ico",
+        "*.cr2", "*.nef", "*.arw", "*.dng"
+    };
+    
+    // 基于 TIFF 结构、带内嵌 JPEG 预览的相机 RAW 格式
+    const QStringList RAW_EXTENSIONS = {
+        "cr2", "nef", "arw", "dng"
     };
     
     // 视频文件格式
@@ -61,6 +68,10 @@ namespace FileTypes {
         return IMAGE_EXTENSIONS.contains(extension.toLower());
     }
     
+    inline bool isRawFile(const QString &extension) {
+        return RAW_EXTENSIONS.contains(extension.toLower());
+    }
+    
     inline bool isVideoFile(const QString &extension) {
         return VIDEO_EXTENSIONS.contains(extension.toLower());
     }
@@ -0,0 +1,103 @@
+#include "perceptualhash.h"
+#include <QtMath>
+#include <algorithm>
+#include <array>
+
+namespace {
+
+const int DCT_SIZE = 32;
+const int HASH_SIZE = 8;
+
+// 缩放为 width x height 的灰度值
+void grayscale(const QImage &image, int width, int height, float *out) {
+    const QImage small = image.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+                              .convertToFormat(QImage::Format_Grayscale8);
+    for (int y = 0; y < height; ++y) {
+        const uchar *line = small.constScanLine(y);
+        for (int x = 0; x < width; ++x) {
+            out[y * width + x] = line[x];
+        }
+    }
+}
+
+// DCT-II 的前 8 个基函数在 32 个采样点上的取值，按行连续存放便于编译器向量化
+const std::array<float, HASH_SIZE * DCT_SIZE> &cosineTable() {
+    static const std::array<float, HASH_SIZE * DCT_SIZE> table = [] {
+        std::array<float, HASH_SIZE * DCT_SIZE> values{};
+        for (int u = 0; u < HASH_SIZE; ++u) {
+            for (int x = 0; x < DCT_SIZE; ++x) {
+                values[u * DCT_SIZE + x] = float(qCos((2 * x + 1) * u * M_PI / (2 * DCT_SIZE)));
+            }
+        }
+        return values;
+    }();
+    return table;
+}
+
+} // namespace
+
+quint64 PerceptualHash::dHash(const QImage &image) {
+    if (image.isNull()) {
+        return 0;
+    }
+    float pixels[(HASH_SIZE + 1) * HASH_SIZE];
+    grayscale(image, HASH_SIZE + 1, HASH_SIZE, pixels);
+
+    quint64 hash = 0;
+    for (int y = 0; y < HASH_SIZE; ++y) {
+        for (int x = 0; x < HASH_SIZE; ++x) {
+            const float *row = pixels + y * (HASH_SIZE + 1);
+            hash = hash << 1 | (row[x] < row[x + 1] ? 1 : 0);
+        }
+    }
+    return hash;
+}
+
+quint64 PerceptualHash::pHash(const QImage &image) {
+    if (image.isNull()) {
+        return 0;
+    }
+    float pixels[DCT_SIZE * DCT_SIZE];
+    grayscale(image, DCT_SIZE, DCT_SIZE, pixels);
+    const std::array<float, HASH_SIZE * DCT_SIZE> &table = cosineTable();
+
+    // 可分离的二维 DCT：先对每行求前 8 个系数，再对这些列求前 8 个系数
+    float rows[DCT_SIZE * HASH_SIZE];
+    for (int y = 0; y < DCT_SIZE; ++y) {
+        const float *line = pixels + y * DCT_SIZE;
+        for (int u = 0; u < HASH_SIZE; ++u) {
+            const float *basis = table.data() + u * DCT_SIZE;
+            float sum = 0;
+            for (int x = 0; x < DCT_SIZE; ++x) {
+                sum += line[x] * basis[x];
+            }
+            rows[y * HASH_SIZE + u] = sum;
+        }
+    }
+
+    float coefficients[HASH_SIZE * HASH_SIZE];
+    for (int v = 0; v < HASH_SIZE; ++v) {
+        const float *basis = table.data() + v * DCT_SIZE;
+        float sums[HASH_SIZE] = {};
+        for (int y = 0; y < DCT_SIZE; ++y) {
+            const float *row = rows + y * HASH_SIZE;
+            for (int u = 0; u < HASH_SIZE; ++u) {
+                sums[u] += row[u] * basis[y];
+            }
+        }
+        std::copy(sums, sums + HASH_SIZE, coefficients + v * HASH_SIZE);
+    }
+
+    // 直流分量只反映整体亮度，不参与中位数
+    float sorted[HASH_SIZE * HASH_SIZE - 1];
+    std::copy(coefficients + 1, coefficients + HASH_SIZE * HASH_SIZE, sorted);
+    const int middle = (HASH_SIZE * HASH_SIZE - 1) / 2;
+    std::nth_element(sorted, sorted + middle, sorted + HASH_SIZE * HASH_SIZE - 1);
+    const float median = sorted[middle];
+
+    quint64 hash = 0;
+    for (int i = 0; i < HASH_SIZE * HASH_SIZE; ++i) {
+        hash = hash << 1 | (coefficients[i] > median ? 1 : 0);
+    }
+    return hash;
+}
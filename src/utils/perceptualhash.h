@@ -0,0 +1,15 @@
+#pragma once
+#include <QImage>
+#include <QtGlobal>
+
+// 64 位感知哈希，用于查找相似图片
+// dHash 比较 9x8 灰度图中相邻像素的明暗；pHash 取 32x32 灰度图 DCT 的左上 8x8 低频系数与中位数比较。
+// 两者都在已解码的缩略图上计算，距离为汉明距离。
+namespace PerceptualHash {
+    quint64 dHash(const QImage &image);
+    quint64 pHash(const QImage &image);
+
+    inline int distance(quint64 a, quint64 b) {
+        return qPopulationCount(a ^ b);
+    }
+}
@@ -0,0 +1,182 @@
+#include "placeholder.h"
+#include <QVector>
+#include <QtMath>
+#include <array>
+
+namespace {
+
+// 每个方向的余弦分量数
+const int COMPONENTS = 4;
+// 编码前把缩略图缩到的长边
+const int SAMPLE_SIZE = 32;
+// 宽、高、直流分量 RGB、交流分量的幅度、交流分量 15 x RGB
+const int HEADER_BYTES = 6;
+const int ENCODED_BYTES = HEADER_BYTES + (COMPONENTS * COMPONENTS - 1) * 3;
+
+const std::array<float, 256> &srgbToLinearTable() {
+    static const std::array<float, 256> table = [] {
+        std::array<float, 256> values{};
+        for (int i = 0; i < 256; ++i) {
+            const float v = i / 255.0f;
+            values[i] = v <= 0.04045f ? v / 12.92f : float(qPow((v + 0.055f) / 1.055f, 2.4f));
+        }
+        return values;
+    }();
+    return table;
+}
+
+int linearToSrgb(float value) {
+    const float v = qBound(0.0f, value, 1.0f);
+    const float srgb = v <= 0.0031308f ? v * 12.92f : 1.055f * float(qPow(v, 1.0f / 2.4f)) - 0.055f;
+    return qBound(0, qRound(srgb * 255.0f), 255);
+}
+
+// 保留符号的开方，使小幅度的交流分量量化后仍有足够的精度
+float signedSqrt(float value) {
+    return value < 0 ? -qSqrt(-value) : qSqrt(value);
+}
+
+// 各方向的余弦基在 size 个采样点上的取值，按分量连续存放
+QVector<float> basis(int size) {
+    QVector<float> values(COMPONENTS * size);
+    for (int c = 0; c < COMPONENTS; ++c) {
+        for (int x = 0; x < size; ++x) {
+            values[c * size + x] = float(qCos(M_PI * c * (x + 0.5) / size));
+        }
+    }
+    return values;
+}
+
+} // namespace
+
+QByteArray Placeholder::encode(const QImage &image) {
+    if (image.isNull()) {
+        return QByteArray();
+    }
+    const QImage sample = image.scaled(SAMPLE_SIZE, SAMPLE_SIZE, Qt::KeepAspectRatio, Qt::SmoothTransformation)
+                              .convertToFormat(QImage::Format_RGB32);
+    const int width = sample.width();
+    const int height = sample.height();
+    const std::array<float, 256> &linear = srgbToLinearTable();
+    const QVector<float> basisX = basis(width);
+    const QVector<float> basisY = basis(height);
+
+    // factors[(j * COMPONENTS + i) * 3 + channel]
+    float factors[COMPONENTS * COMPONENTS * 3] = {};
+    for (int y = 0; y < height; ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(sample.constScanLine(y));
+        for (int x = 0; x < width; ++x) {
+            const float r = linear[qRed(line[x])];
+            const float g = linear[qGreen(line[x])];
+            const float b = linear[qBlue(line[x])];
+            for (int j = 0; j < COMPONENTS; ++j) {
+                const float by = basisY[j * height + y];
+                for (int i = 0; i < COMPONENTS; ++i) {
+                    const float weight = basisX[i * width + x] * by;
+                    float *factor = factors + (j * COMPONENTS + i) * 3;
+                    factor[0] += r * weight;
+                    factor[1] += g * weight;
+                    factor[2] += b * weight;
+                }
+            }
+        }
+    }
+
+    float maximum = 0;
+    for (int k = 0; k < COMPONENTS * COMPONENTS; ++k) {
+        const float scale = (k == 0 ? 1.0f : 2.0f) / (width * height);
+        for (int c = 0; c < 3; ++c) {
+            factors[k * 3 + c] *= scale;
+            if (k > 0) {
+                maximum = qMax(maximum, qAbs(factors[k * 3 + c]));
+            }
+        }
+    }
+
+    QByteArray data(ENCODED_BYTES, Qt::Uninitialized);
+    data[0] = char(width);
+    data[1] = char(height);
+    for (int c = 0; c < 3; ++c) {
+        data[2 + c] = char(linearToSrgb(factors[c]));
+    }
+    const int quantizedMaximum = qBound(1, qCeil(maximum * 255.0f), 255);
+    data[5] = char(quantizedMaximum);
+    const float range = quantizedMaximum / 255.0f;
+    for (int k = 1; k < COMPONENTS * COMPONENTS; ++k) {
+        for (int c = 0; c < 3; ++c) {
+            const float normalized = signedSqrt(qBound(-1.0f, factors[k * 3 + c] / range, 1.0f));
+            data[HEADER_BYTES + (k - 1) * 3 + c] = char(qRound(normalized * 127.0f) + 128);
+        }
+    }
+    return data;
+}
+
+QImage Placeholder::decode(const QByteArray &data) {
+    if (data.size() != ENCODED_BYTES) {
+        return QImage();
+    }
+    const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+    const int width = bytes[0];
+    const int height = bytes[1];
+    if (width <= 0 || height <= 0 || width > SAMPLE_SIZE || height > SAMPLE_SIZE) {
+        return QImage();
+    }
+
+    const std::array<float, 256> &linear = srgbToLinearTable();
+    float factors[COMPONENTS * COMPONENTS * 3];
+    for (int c = 0; c < 3; ++c) {
+        factors[c] = linear[bytes[2 + c]];
+    }
+    const float range = bytes[5] / 255.0f;
+    for (int k = 1; k < COMPONENTS * COMPONENTS; ++k) {
+        for (int c = 0; c < 3; ++c) {
+            const float normalized = (int(bytes[HEADER_BYTES + (k - 1) * 3 + c]) - 128) / 127.0f;
+            factors[k * 3 + c] = normalized * qAbs(normalized) * range;
+        }
+    }
+
+    const QVector<float> basisX = basis(width);
+    const QVector<float> basisY = basis(height);
+    QImage image(width, height, QImage::Format_RGB32);
+    for (int y = 0; y < height; ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            float rgb[3] = {};
+            for (int j = 0; j < COMPONENTS; ++j) {
+                const float by = basisY[j * height + y];
+                for (int i = 0; i < COMPONENTS; ++i) {
+                    const float weight = basisX[i * width + x] * by;
+                    const float *factor = factors + (j * COMPONENTS + i) * 3;
+                    rgb[0] += factor[0] * weight;
+                    rgb[1] += factor[1] * weight;
+                    rgb[2] += factor[2] * weight;
+                }
+            }
+            line[x] = qRgb(linearToSrgb(rgb[0]), linearToSrgb(rgb[1]), linearToSrgb(rgb[2]));
+        }
+    }
+    return image;
+}
+
+QString Placeholder::urlFor(const QByteArray &data) {
+    if (data.isEmpty()) {
+        return QString();
+    }
+    return QStringLiteral("image://%1/%2").arg(QLatin1String(PlaceholderProvider::PROVIDER_ID),
+        QString::fromLatin1(data.toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals)));
+}
+
+PlaceholderProvider::PlaceholderProvider()
+    : QQuickImageProvider(QQuickImageProvider::Image) {
+}
+
+QImage PlaceholderProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize) {
+    Q_UNUSED(requestedSize)
+    // 保持原始的小尺寸，由 Image 平滑放大，放大本身就是所需的模糊效果
+    const QImage image = Placeholder::decode(QByteArray::fromBase64(
+        id.toLatin1(), QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals));
+    if (size) {
+        *size = image.size();
+    }
+    return image;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <QByteArray>
+#include <QImage>
+#include <QQuickImageProvider>
+#include <QString>
+
+// 低清占位图：与 BlurHash 相同的思路，把图像在线性 RGB 空间做 4x4 的余弦变换，
+// 只保留这 16 个系数，共 51 字节，随文件元数据保存在 files 表中。
+// 缩略图尚未读出时先显示占位图解码出的模糊小图，整个过程不涉及磁盘读取。
+namespace Placeholder {
+    // 在缩略图上计算，图像为空时返回空
+    QByteArray encode(const QImage &image);
+    // 解码为长边不超过 32 像素、保持原图宽高比的小图
+    QImage decode(const QByteArray &data);
+    // 图像提供器的 URL，数据直接编码在 URL 中
+    QString urlFor(const QByteArray &data);
+}
+
+// image://placeholder/<base64url 数据>，在 GUI 侧同步解码。
+// 32x32 像素 x 16 个分量 x 3 个通道，每次约 4.9 万次乘加；
+// QML 的 Image 按 URL 缓存解码结果，同一占位图滚动回来时不会重复解码
+class PlaceholderProvider : public QQuickImageProvider {
+public:
+    static constexpr const char *PROVIDER_ID = "placeholder";
+
+    PlaceholderProvider();
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+};
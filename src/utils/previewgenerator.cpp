@@ -2,13 +2,19 @@
 #include <QDir>
 #include <QStandardPaths>
 #include <QImage>
-#include <QCryptographicHash>
+#include <QImageReader>
+#include <QBuffer>
 #include <QtConcurrent>
 #include <QDebug>
-#include <QElapsedTimer>
-#include <QTimer>
+#include <QSet>
+#include <QThread>
+#include <QThreadStorage>
 #include "filetypes.h"
 #include "spritegenerator.h"
+#include "thumbnailprovider.h"
+#include "embeddedpreview.h"
+#include "perceptualhash.h"
+#include "placeholder.h"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -17,272 +23,468 @@ extern "C" {
 #include <libavutil/imgutils.h>
 }
 
-PreviewGenerator::PreviewGenerator(QObject *parent) : QObject(parent) {
-    connect(&m_watcher, &QFutureWatcher<QString>::finished, this, [this]() {
-        QString previewPath = m_watcher.result();
-        auto fileData = m_currentFile.lock();
-        if (fileData) {
-            fileData->setPreviewPath(previewPath);
-            fileData->setPreviewLoading(false);
-        }
-    });
+namespace {
+
+// 解码器本身支持缩小解码的格式：JPEG 在 DCT 阶段按 1/2、1/4、1/8 缩小，SVG 直接按目标尺寸渲染。
+// 其他内置格式即使声明支持 ScaledSize 也是整图解码后再缩放，省不了内存。
+const QList<QByteArray> NATIVE_SCALED_FORMATS = {"jpeg", "jpg", "svg", "svgz"};
+
+// 超过这个像素字节数的大图，插件支持 ScaledSize 时直接按目标尺寸读取：WebP 等插件由解码库缩小解码，
+// 其余插件也在内部缩放后立即释放整图，省去 scaled() 时整图与结果同时存在的那份内存。
+// 内置的 PNG/TIFF 等插件不支持按区域读取，不再尝试条带解码。
+const qint64 FULL_DECODE_LIMIT = 64LL * 1024 * 1024;
+
+// 工作线程复用的视频解码资源，线程结束时由 QThreadStorage 释放
+struct VideoDecodeContext {
+    SwsContext *sws = nullptr;
+    // 指纹帧的目标尺寸与格式固定，单独缓存，避免与预览的缩放上下文来回重建
+    SwsContext *fingerprintSws = nullptr;
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
     
-    ensureCacheDirectory();
+    ~VideoDecodeContext() {
+        sws_freeContext(sws);
+        sws_freeContext(fingerprintSws);
+        av_frame_free(&frame);
+        av_packet_free(&packet);
+    }
+};
+
+QThreadStorage<VideoDecodeContext *> videoContexts;
+
+// 单个文件的解复用器与解码器，离开作用域时释放
+struct DemuxScope {
+    AVFormatContext *format = nullptr;
+    AVCodecContext *codec = nullptr;
+    
+    ~DemuxScope() {
+        avcodec_free_context(&codec);
+        avformat_close_input(&format);
+    }
+};
+
+// 找关键帧时最多读取的数据包数
+const int MAX_VIDEO_PACKETS = 2000;
+// 视频指纹：在时长内均匀取这么多个位置，各解一个关键帧。
+// 位置随时长按比例变化，只对重新编码、缩放等不改变时长的副本有效，对截取过的副本无效
+const int FINGERPRINT_FRAMES = 8;
+// 指纹帧直接缩放成 pHash 所需的灰度图
+const int FINGERPRINT_SIZE = 32;
+
+// 定位到 timestamp（AV_TIME_BASE 单位）之前最近的关键帧并解码，结果在 frame 中
+bool decodeKeyframeAt(DemuxScope &scope, int videoStream, VideoDecodeContext *context, int64_t timestamp) {
+    if (av_seek_frame(scope.format, -1, timestamp, AVSEEK_FLAG_BACKWARD) < 0) {
+        return false;
+    }
+    avcodec_flush_buffers(scope.codec);
+    
+    AVPacket *packet = context->packet;
+    bool decoded = false;
+    for (int packets = 0; !decoded && packets < MAX_VIDEO_PACKETS && av_read_frame(scope.format, packet) >= 0; ++packets) {
+        if (packet->stream_index == videoStream && (packet->flags & AV_PKT_FLAG_KEY)) {
+            // 送入一个关键帧后立即排空，帧级多线程也不必等待后续数据包
+            if (avcodec_send_packet(scope.codec, packet) >= 0) {
+                avcodec_send_packet(scope.codec, nullptr);
+                decoded = avcodec_receive_frame(scope.codec, context->frame) >= 0;
+            }
+            // 排空后解码器进入结束状态，需要重置才能继续送包
+            avcodec_flush_buffers(scope.codec);
+        }
+        av_packet_unref(packet);
+    }
+    return decoded;
 }
 
-void PreviewGenerator::generatePreview(QSharedPointer<FileData> fileData) {
-    if (!fileData) {
-        qWarning() << "PreviewGenerator: Null fileData pointer";
-        return;
+// 在时长内均匀取若干位置，各解一个关键帧并计算 pHash，按时间顺序返回
+QVector<quint64> fingerprintVideo(DemuxScope &scope, int videoStream, VideoDecodeContext *context, int64_t duration) {
+    QVector<quint64> frames;
+    frames.reserve(FINGERPRINT_FRAMES);
+    AVFrame *frame = context->frame;
+    QImage gray(FINGERPRINT_SIZE, FINGERPRINT_SIZE, QImage::Format_Grayscale8);
+    int64_t lastPts = AV_NOPTS_VALUE;
+    
+    // 沿用同一个解复用器与解码器，按时间顺序定位，只解关键帧
+    for (int i = 0; i < FINGERPRINT_FRAMES; ++i) {
+        const int64_t timestamp = duration * (2 * i + 1) / (2 * FINGERPRINT_FRAMES);
+        if (!decodeKeyframeAt(scope, videoStream, context, timestamp)) {
+            continue;
+        }
+        // 关键帧间隔较长时相邻位置会落到同一帧
+        if (frame->pts != AV_NOPTS_VALUE && frame->pts == lastPts) {
+            av_frame_unref(frame);
+            continue;
+        }
+        lastPts = frame->pts;
+        
+        context->fingerprintSws = sws_getCachedContext(context->fingerprintSws,
+            frame->width, frame->height, AVPixelFormat(frame->format),
+            FINGERPRINT_SIZE, FINGERPRINT_SIZE, AV_PIX_FMT_GRAY8,
+            SWS_AREA, nullptr, nullptr, nullptr);
+        if (!context->fingerprintSws) {
+            av_frame_unref(frame);
+            break;
+        }
+        uint8_t *destination[4] = {gray.bits(), nullptr, nullptr, nullptr};
+        int destinationLinesize[4] = {int(gray.bytesPerLine()), 0, 0, 0};
+        sws_scale(context->fingerprintSws, frame->data, frame->linesize, 0, frame->height,
+                  destination, destinationLinesize);
+        av_frame_unref(frame);
+        frames.append(PerceptualHash::pHash(gray));
     }
+    return frames;
+}
+
+} // namespace
+
+PreviewGenerator::PreviewGenerator(QObject *parent)
+    : QObject(parent)
+    , m_maxJobs(qBound(MIN_WORKERS, QThread::idealThreadCount() / 2, MAX_WORKERS)) {
+}
+
+QThreadPool &PreviewGenerator::workerPool() {
+    static QThreadPool pool;
+    static const bool configured = [] {
+        pool.setMaxThreadCount(qBound(MIN_WORKERS, QThread::idealThreadCount() / 2, MAX_WORKERS) + 1);
+        return true;
+    }();
+    Q_UNUSED(configured)
+    return pool;
+}
+
+PreviewGenerator::~PreviewGenerator() {
+    // 生成任务引用本对象；已排队的结果在对象销毁后不会再投递
+    m_pending.clear();
+    workerPool().waitForDone();
+}
+
+void PreviewGenerator::schedule(const QVector<QSharedPointer<FileData>> &files) {
+    m_pending.clear();
     
-    QString hash = QCryptographicHash::hash(fileData->filePath().toUtf8(), QCryptographicHash::Md5).toHex();
-    QString cachePath = m_cacheDir + "/" + hash + ".jpg";
+    QSet<QString> queued;
+    for (const auto &fileData : files) {
+        if (!fileData || !fileData->previewPath().isEmpty()) {
+            continue;
+        }
+        
+        const QString type = fileData->fileType().toLower();
+        if (!FileTypes::isImageFile(type) && !FileTypes::isVideoFile(type)) {
+            continue;
+        }
+        
+        const QString filePath = fileData->filePath();
+        auto inFlight = m_inFlight.find(filePath);
+        if (inFlight != m_inFlight.end()) {
+            // 同一路径已在生成中，只登记等待者
+            inFlight->append(fileData);
+            continue;
+        }
+        if (queued.contains(filePath)) {
+            continue;
+        }
+        
+        // 只查内存中的索引，不访问磁盘；缺任何一级都重新生成整组，
+        // 否则模型请求的层级可能恰好不在
+        const ThumbnailStore::Key key = keyFor(*fileData);
+        if (ThumbnailStore::instance().containsLevels(key)) {
+            fileData->setPreviewPath(ThumbnailProvider::urlFor(key));
+            // 库中没有占位图（缩略图早于占位图生成，或写库前程序退出），从已缓存的最小一级补算
+            if (fileData->placeholder().isEmpty() && !fileData->fileId().isEmpty()) {
+                backfillPlaceholder(fileData, key);
+            }
+            continue;
+        }
+        
+        m_pending.append(fileData);
+        queued.insert(filePath);
+    }
     
-    if (QFile::exists(cachePath)) {
-        fileData->setPreviewPath(cachePath);
+    dispatch();
+}
+
+void PreviewGenerator::backfillPlaceholder(const QSharedPointer<FileData> &fileData, const ThumbnailStore::Key &key) {
+    const QString identity = fileData->fileId();
+    if (m_placeholderJobs.contains(identity)) {
         return;
     }
-    
-    QString filePath = fileData->filePath();
-    m_currentFile = fileData;
-    fileData->setPreviewLoading(true);
-    
-    QFuture<QString> future = QtConcurrent::run([this, fileData]() {
-        if (!fileData) return QString();
+    m_placeholderJobs.insert(identity);
+    
+    // 读取与编码都在工作线程中进行，64 像素的一级只有几 KB
+    const QWeakPointer<FileData> waiter = fileData;
+    const ThumbnailStore::Key smallest = key.level(ThumbnailStore::LEVELS[0]);
+    workerPool().start([this, waiter, identity, smallest]() {
+        const QImage image = QImage::fromData(ThumbnailStore::instance().read(smallest));
+        const QByteArray placeholder = Placeholder::encode(image);
+        QMetaObject::invokeMethod(this, [this, waiter, identity, placeholder]() {
+            m_placeholderJobs.remove(identity);
+            if (placeholder.isEmpty()) {
+                return;
+            }
+            if (auto fileData = waiter.toStrongRef()) {
+                fileData->setPlaceholder(placeholder);
+            }
+            emit placeholderReady(identity, placeholder);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void PreviewGenerator::cancelPending() {
+    m_pending.clear();
+}
+
+void PreviewGenerator::dispatch() {
+    while (!m_pending.isEmpty() && m_inFlight.size() < m_maxJobs) {
+        QSharedPointer<FileData> fileData = m_pending.takeFirst().toStrongRef();
+        if (!fileData) {
+            continue;
+        }
+        
+        const QString filePath = fileData->filePath();
+        const ThumbnailStore::Key key = keyFor(*fileData);
+        m_inFlight[filePath].append(fileData);
+        fileData->setPreviewLoading(true);
         
-        QString fileType = QFileInfo(fileData->filePath()).suffix().toLower();
-        try {
-            if (FileTypes::isImageFile(fileType)) {
-                return generateImagePreview(fileData->filePath());
-            } else if (FileTypes::isVideoFile(fileType)) {
-                return generateVideoPreview(fileData->filePath());
+        workerPool().start([this, filePath, key]() {
+            JobResult result;
+            try {
+                result = generate(filePath, key);
+            } catch (const std::exception &e) {
+                qWarning() << "预览生成失败:" << e.what();
+            }
+            QMetaObject::invokeMethod(this, [this, filePath, result]() {
+                onJobFinished(filePath, result);
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void PreviewGenerator::onJobFinished(const QString &filePath, const JobResult &result) {
+    const QVector<QWeakPointer<FileData>> waiters = m_inFlight.take(filePath);
+    QString identity;
+    for (const auto &waiter : waiters) {
+        if (auto fileData = waiter.toStrongRef()) {
+            fileData->setPreviewPath(result.previewPath);
+            fileData->setPreviewLoading(false);
+            if (!result.placeholder.isEmpty()) {
+                fileData->setPlaceholder(result.placeholder);
+            }
+            if (identity.isEmpty()) {
+                identity = fileData->fileId();
             }
-        } catch (const std::exception &e) {
-            qWarning() << "预览生成失败:" << e.what();
         }
-        return QString();
-    });
+    }
+    // 没有文件标识的文件无法跨路径对应，不记录哈希
+    if (!identity.isEmpty() && !result.previewPath.isEmpty()) {
+        if (result.hashed) {
+            emit imageHashed(identity, result.dHash, result.pHash);
+        }
+        if (!result.fingerprint.isEmpty()) {
+            emit videoFingerprinted(identity, result.fingerprint);
+        }
+        emit placeholderReady(identity, result.placeholder);
+    }
+    dispatch();
+}
+
+ThumbnailStore::Key PreviewGenerator::keyFor(const FileData &fileData) {
+    const QString identity = fileData.fileId().isEmpty() ? fileData.filePath() : fileData.fileId();
+    return ThumbnailStore::makeKey(identity, fileData.modifiedDate(), fileData.fileSize());
+}
+
+PreviewGenerator::JobResult PreviewGenerator::generate(const QString &filePath, const ThumbnailStore::Key &key) {
+    QString fileType = QFileInfo(filePath).suffix().toLower();
+    const bool isImage = FileTypes::isImageFile(fileType);
+    QImage preview;
+    int quality = 90;
+    JobResult result;
+    if (isImage) {
+        preview = generateImagePreview(filePath);
+    } else if (FileTypes::isVideoFile(fileType)) {
+        preview = generateVideoPreview(filePath, &result.fingerprint);
+        quality = 95;
+    }
+    if (preview.isNull()) {
+        return result;
+    }
     
-    QTimer::singleShot(5000, this, [this, fileData]() {
-        if (fileData && fileData->previewLoading()) {
-            fileData->setPreviewLoading(false);
-            fileData->setPreviewPath(QString());
+    // 从大到小逐级减半缩放，每级都基于上一级，按从小到大的顺序写入
+    QVector<QPair<ThumbnailStore::Key, QByteArray>> levels(ThumbnailStore::LEVEL_COUNT);
+    QImage level = preview;
+    for (int i = ThumbnailStore::LEVEL_COUNT - 1; i >= 0; --i) {
+        const int dimension = ThumbnailStore::LEVELS[i];
+        if (level.width() > dimension || level.height() > dimension) {
+            level = level.scaled(dimension, dimension, Qt::KeepAspectRatio, Qt::SmoothTransformation);
         }
-    });
+        
+        QBuffer buffer(&levels[i].second);
+        buffer.open(QIODevice::WriteOnly);
+        if (!level.save(&buffer, "JPG", quality)) {
+            qWarning() << "预览图编码失败:" << filePath;
+            return result;
+        }
+        levels[i].first = key.level(dimension);
+    }
     
-    m_watcher.setFuture(future);
+    if (!ThumbnailStore::instance().write(levels)) {
+        qWarning() << "预览图保存失败:" << filePath;
+        return result;
+    }
+    result.previewPath = ThumbnailProvider::urlFor(key);
+    result.placeholder = Placeholder::encode(level);
+    
+    // 哈希只看 32x32 以内的灰度图，在最小一级上计算即可
+    if (isImage) {
+        result.hashed = true;
+        result.dHash = PerceptualHash::dHash(level);
+        result.pHash = PerceptualHash::pHash(level);
+    }
+    return result;
 }
 
-QString PreviewGenerator::generateImagePreview(const QString &path) {
-    QImage image(path);
-    if (image.isNull()) {
-        return QString();
+QImage PreviewGenerator::generateImagePreview(const QString &path) {
+    // 相机 RAW 直接使用内嵌预览；JPEG 只在内嵌预览足够大（如 MPF 预览图）时使用
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    if (FileTypes::isRawFile(suffix) || suffix == "jpg" || suffix == "jpeg") {
+        QImage embedded = EmbeddedPreview::load(path, PREVIEW_SIZE, !FileTypes::isRawFile(suffix));
+        if (!embedded.isNull()) {
+            return embedded;
+        }
     }
     
-    QSize targetSize(240, 240);
-    QImage scaled = image.scaled(targetSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    QImageReader reader(path);
+    // 按 EXIF 方向旋转；缩小解码的尺寸以旋转前为准
+    reader.setAutoTransform(true);
+    const QSize sourceSize = reader.size();
+    // 小图不放大
+    const QSize targetSize = !sourceSize.isValid() ? QSize(PREVIEW_SIZE, PREVIEW_SIZE)
+        : sourceSize.width() <= PREVIEW_SIZE && sourceSize.height() <= PREVIEW_SIZE ? sourceSize
+        : sourceSize.scaled(PREVIEW_SIZE, PREVIEW_SIZE, Qt::KeepAspectRatio);
+    
+    QImage image;
+    if (sourceSize.isValid() && NATIVE_SCALED_FORMATS.contains(reader.format())) {
+        // 让解码器输出两倍目标尺寸，再平滑缩小，兼顾速度与画质
+        const QSize decodeSize = targetSize * 2;
+        if (decodeSize.width() < sourceSize.width() && decodeSize.height() < sourceSize.height()) {
+            reader.setScaledSize(decodeSize);
+        }
+        image = reader.read();
+    } else if (sourceSize.isValid()
+               && qint64(sourceSize.width()) * sourceSize.height() * 4 > FULL_DECODE_LIMIT
+               && reader.supportsOption(QImageIOHandler::ScaledSize)) {
+        reader.setScaledSize(targetSize);
+        image = reader.read();
+    } else {
+        image = reader.read();
+    }
     
-    if (scaled.isNull()) {
-        qWarning() << "图片缩放失败:" << path;
-        return QString();
+    if (image.isNull()) {
+        return QImage();
     }
     
-    QString hash = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Md5).toHex();
-    QString cachePath = m_cacheDir + "/" + hash + ".jpg";
+    if (image.width() <= PREVIEW_SIZE && image.height() <= PREVIEW_SIZE) {
+        return image;
+    }
     
-    QDir().mkpath(QFileInfo(cachePath).absolutePath());
+    QImage scaled = image.scaled(PREVIEW_SIZE, PREVIEW_SIZE, Qt::KeepAspectRatio, Qt::SmoothTransformation);
     
-    if (scaled.save(cachePath, "JPG", 90)) {
-        return cachePath;
+    if (scaled.isNull()) {
+        qWarning() << "图片缩放失败:" << path;
     }
-    
-    qWarning() << "预览图保存失败:" << cachePath;
-    return QString();
+    return scaled;
 }
 
-QString PreviewGenerator::generateVideoPreview(const QString &path) {
-    AVFormatContext *formatContext = nullptr;
-    if (avformat_open_input(&formatContext, path.toUtf8().constData(), nullptr, nullptr) < 0) {
+QImage PreviewGenerator::generateVideoPreview(const QString &path, QVector<quint64> *fingerprint) {
+    DemuxScope scope;
+    if (avformat_open_input(&scope.format, path.toUtf8().constData(), nullptr, nullptr) < 0) {
         qWarning() << "无法打开视频文件:" << path;
-        return QString();
+        return QImage();
     }
     
-    if (avformat_find_stream_info(formatContext, nullptr) < 0) {
+    if (avformat_find_stream_info(scope.format, nullptr) < 0) {
         qWarning() << "无法获取视频流信息:" << path;
-        avformat_close_input(&formatContext);
-        return QString();
-    }
-    
-    int videoStream = -1;
-    for (unsigned int i = 0; i < formatContext->nb_streams; i++) {
-        if (formatContext->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-            videoStream = i;
-            break;
-        }
+        return QImage();
     }
     
-    if (videoStream == -1) {
+    const int videoStream = av_find_best_stream(scope.format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (videoStream < 0) {
         qWarning() << "未找到视频流:" << path;
-        avformat_close_input(&formatContext);
-        return QString();
+        return QImage();
+    }
+    // 其他流的数据包由解复用器直接丢弃
+    for (unsigned int i = 0; i < scope.format->nb_streams; i++) {
+        if (int(i) != videoStream) {
+            scope.format->streams[i]->discard = AVDISCARD_ALL;
+        }
     }
     
-    AVCodecParameters *codecParams = formatContext->streams[videoStream]->codecpar;
+    AVCodecParameters *codecParams = scope.format->streams[videoStream]->codecpar;
     const AVCodec *codec = avcodec_find_decoder(codecParams->codec_id);
     if (!codec) {
         qWarning() << "未找到解码器:" << path;
-        avformat_close_input(&formatContext);
-        return QString();
+        return QImage();
     }
     
-    AVCodecContext *codecContext = avcodec_alloc_context3(codec);
-    if (!codecContext) {
-        qWarning() << "无法分配解码器上下文:" << path;
-        avformat_close_input(&formatContext);
-        return QString();
+    scope.codec = avcodec_alloc_context3(codec);
+    if (!scope.codec || avcodec_parameters_to_context(scope.codec, codecParams) < 0) {
+        qWarning() << "无法创建解码器上下文:" << path;
+        return QImage();
     }
     
-    if (avcodec_parameters_to_context(codecContext, codecParams) < 0) {
-        qWarning() << "无法复制编解码器参数:" << path;
-        avcodec_free_context(&codecContext);
-        avformat_close_input(&formatContext);
-        return QString();
-    }
-    
-    if (avcodec_open2(codecContext, codec, nullptr) < 0) {
+    // 只解关键帧，并让解码器自行使用多线程
+    scope.codec->skip_frame = AVDISCARD_NONKEY;
+    scope.codec->thread_count = 0;
+    scope.codec->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    if (avcodec_open2(scope.codec, codec, nullptr) < 0) {
         qWarning() << "无法打开解码器:" << path;
-        avcodec_free_context(&codecContext);
-        avformat_close_input(&formatContext);
-        return QString();
+        return QImage();
     }
     
-    int64_t duration = formatContext->duration;
-    int64_t seekTarget = duration > 0 ? duration / 3 : 0;
-    av_seek_frame(formatContext, -1, seekTarget, AVSEEK_FLAG_BACKWARD);
-    
-    AVFrame *frame = av_frame_alloc();
-    AVFrame *frameRGB = av_frame_alloc();
-    if (!frame || !frameRGB) {
-        qWarning() << "无法分配帧缓冲:" << path;
-        av_frame_free(&frameRGB);
-        av_frame_free(&frame);
-        avcodec_free_context(&codecContext);
-        avformat_close_input(&formatContext);
-        return QString();
+    if (!videoContexts.hasLocalData()) {
+        videoContexts.setLocalData(new VideoDecodeContext);
     }
-    
-    int width = codecContext->width;
-    int height = codecContext->height;
-    int targetWidth = 240;
-    int targetHeight = height * targetWidth / width;
-    
-    int numBytes = av_image_get_buffer_size(AV_PIX_FMT_RGB24, targetWidth, targetHeight, 1);
-    uint8_t *buffer = (uint8_t *)av_malloc(numBytes);
-    
-    if (!buffer) {
-        qWarning() << "无法分配图像缓冲区:" << path;
-        av_frame_free(&frameRGB);
-        av_frame_free(&frame);
-        avcodec_free_context(&codecContext);
-        avformat_close_input(&formatContext);
-        return QString();
+    VideoDecodeContext *context = videoContexts.localData();
+    AVFrame *frame = context->frame;
+    
+    // 向前定位到三分之一处之前最近的关键帧
+    const int64_t duration = scope.format->duration;
+    bool decoded = duration > 0 && decodeKeyframeAt(scope, videoStream, context, duration / 3);
+    if (!decoded) {
+        decoded = decodeKeyframeAt(scope, videoStream, context, 0);
     }
     
-    int ret = av_image_fill_arrays(frameRGB->data, frameRGB->linesize, buffer,
-                                 AV_PIX_FMT_RGB24, targetWidth, targetHeight, 1);
-    if (ret < 0) {
-        qWarning() << "无法设置帧缓冲区:" << path;
-        av_free(buffer);
-        av_frame_free(&frameRGB);
-        av_frame_free(&frame);
-        avcodec_free_context(&codecContext);
-        avformat_close_input(&formatContext);
-        return QString();
+    if (!decoded || frame->width <= 0 || frame->height <= 0) {
+        av_frame_unref(frame);
+        qWarning() << "无法提取视频帧:" << path;
+        return QImage();
     }
     
-    SwsContext *swsContext = sws_getContext(
-        width, height, codecContext->pix_fmt,
-        targetWidth, targetHeight, AV_PIX_FMT_RGB24,
-        SWS_LANCZOS | SWS_ACCURATE_RND,
-        nullptr, nullptr, nullptr
-    );
-    
-    if (!swsContext) {
-        qWarning() << "无法创建缩放上下文:" << path;
-        av_free(buffer);
-        av_frame_free(&frameRGB);
-        av_frame_free(&frame);
-        avcodec_free_context(&codecContext);
-        avformat_close_input(&formatContext);
-        return QString();
+    QSize targetSize(frame->width, frame->height);
+    if (targetSize.width() > PREVIEW_SIZE || targetSize.height() > PREVIEW_SIZE) {
+        targetSize.scale(PREVIEW_SIZE, PREVIEW_SIZE, Qt::KeepAspectRatio);
     }
     
-    AVPacket *packet = av_packet_alloc();
-    bool frameExtracted = false;
-    
-    while (av_read_frame(formatContext, packet) >= 0 && !frameExtracted) {
-        if (packet->stream_index == videoStream) {
-            int response = avcodec_send_packet(codecContext, packet);
-            if (response < 0) {
-                qWarning() << "发送数据包错误:" << path;
-                break;
-            }
-            
-            response = avcodec_receive_frame(codecContext, frame);
-            if (response >= 0) {
-                sws_scale(swsContext, frame->data, frame->linesize, 0, height,
-                         frameRGB->data, frameRGB->linesize);
-                
-                QImage image(frameRGB->data[0], targetWidth, targetHeight,
-                           frameRGB->linesize[0], QImage::Format_RGB888);
-                
-                QString hash = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Md5).toHex();
-                QString cachePath = m_cacheDir + "/" + hash + ".jpg";
-                
-                if (image.save(cachePath, "JPG", 95)) {
-                    frameExtracted = true;
-                    av_packet_unref(packet);
-                    
-                    av_packet_free(&packet);
-                    av_free(buffer);
-                    sws_freeContext(swsContext);
-                    av_frame_free(&frameRGB);
-                    av_frame_free(&frame);
-                    avcodec_free_context(&codecContext);
-                    avformat_close_input(&formatContext);
-                    
-                    return cachePath;
-                }
-            }
-        }
-        av_packet_unref(packet);
+    // 缩放上下文按线程缓存，尺寸与像素格式不变时直接复用
+    context->sws = sws_getCachedContext(context->sws,
+        frame->width, frame->height, AVPixelFormat(frame->format),
+        targetSize.width(), targetSize.height(), AV_PIX_FMT_RGB24,
+        SWS_AREA, nullptr, nullptr, nullptr);
+    if (!context->sws) {
+        av_frame_unref(frame);
+        qWarning() << "无法创建缩放上下文:" << path;
+        return QImage();
     }
     
-    av_packet_free(&packet);
-    av_free(buffer);
-    sws_freeContext(swsContext);
-    av_frame_free(&frameRGB);
-    av_frame_free(&frame);
-    avcodec_free_context(&codecContext);
-    avformat_close_input(&formatContext);
+    // 直接缩放到 QImage 的像素缓冲，不再经过中间缓冲区
+    QImage image(targetSize, QImage::Format_RGB888);
+    uint8_t *destination[4] = {image.bits(), nullptr, nullptr, nullptr};
+    int destinationLinesize[4] = {int(image.bytesPerLine()), 0, 0, 0};
+    sws_scale(context->sws, frame->data, frame->linesize, 0, frame->height,
+              destination, destinationLinesize);
+    av_frame_unref(frame);
     
-    qWarning() << "无法提取视频帧:" << path;
-    return QString();
-}
-
-void PreviewGenerator::ensureCacheDirectory() {
-    m_cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/previews";
-    QDir dir;
-    if (!dir.exists(m_cacheDir)) {
-        if (!dir.mkpath(m_cacheDir)) {
-            qWarning() << "缓存目录创建失败";
-        }
+    if (fingerprint && duration > 0) {
+        *fingerprint = fingerprintVideo(scope, videoStream, context, duration);
     }
-}
-
-QString PreviewGenerator::getCachePath() {
-    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/previews";
+    return image;
 }
 
 QStringList PreviewGenerator::generateVideoSprites(const QString &path, int count)
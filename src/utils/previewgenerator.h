@@ -1,33 +1,79 @@
 #pragma once
 #include <QObject>
-#include <QFuture>
-#include <QFutureWatcher>
+#include <QHash>
+#include <QSet>
+#include <QThreadPool>
+#include <QVector>
 #include <memory>
 #include <QWeakPointer>
 #include "../models/filedata.h"
 #include "filetypes.h"
 #include "spritegenerator.h"
+#include "thumbnailstore.h"
 
+// 预览调度：固定大小的线程池 + 按优先级排列的等待队列
+// 调用方按优先级（可见行在前，预取行在后）传入需要预览的文件，新的请求整体替换等待队列，
+// 滚出视野的行随之取消；同一路径在生成中时不重复提交，完成后通知所有等待它的 FileData。
+// 生成结果写入 ThumbnailStore：一次解码得到最大层级，再逐级减半生成整组缩略图；
+// FileData 的 previewPath 为不带层级的 image://thumbs/ URL。
 class PreviewGenerator : public QObject {
     Q_OBJECT
 public:
     explicit PreviewGenerator(QObject *parent = nullptr);
-    void generatePreview(QSharedPointer<FileData> fileData);
-    static QString getCachePath();
+    ~PreviewGenerator();
+    // 替换等待队列，排在前面的先生成；已有预览或缓存命中的文件立即返回
+    void schedule(const QVector<QSharedPointer<FileData>> &files);
+    // 丢弃尚未开始的任务（如切换目录），进行中的任务完成后仍写入缓存
+    void cancelPending();
+    // 预览生成与缩略图解码共用的线程池，解码任务以更高优先级排在生成任务之前
+    static QThreadPool &workerPool();
     Q_INVOKABLE QStringList generateVideoSprites(const QString &path, int count);
     double getSpriteTimestamp(const QString &spritePath) const;
 
 signals:
     void spritesGenerated(const QStringList &paths);
     void spriteProgress(int current, int total);
+    // 图片预览生成后在缩略图上算出的感知哈希，identity 为文件标识
+    void imageHashed(const QString &identity, quint64 dHash, quint64 pHash);
+    // 视频预览生成时顺带抽取的关键帧哈希，按时间顺序
+    void videoFingerprinted(const QString &identity, const QVector<quint64> &frames);
+    // 预览生成时一并计算的低清占位图
+    void placeholderReady(const QString &identity, const QByteArray &placeholder);
 
 private:
-    QString generateImagePreview(const QString &path);
-    QString generateVideoPreview(const QString &path);
-    void ensureCacheDirectory();
+    struct JobResult {
+        QString previewPath;     // 失败时为空
+        QByteArray placeholder;
+        bool hashed = false;     // 仅图片计算哈希
+        quint64 dHash = 0;
+        quint64 pHash = 0;
+        QVector<quint64> fingerprint;   // 仅视频
+    };
+
+    void dispatch();
+    // 缓存命中但没有占位图时，在工作线程中从最小一级缩略图计算，完成后发出 placeholderReady
+    void backfillPlaceholder(const QSharedPointer<FileData> &fileData, const ThumbnailStore::Key &key);
+    void onJobFinished(const QString &filePath, const JobResult &result);
+    static ThumbnailStore::Key keyFor(const FileData &fileData);
+    // 在工作线程中执行
+    JobResult generate(const QString &filePath, const ThumbnailStore::Key &key);
+    // 解码为不超过 PREVIEW_SIZE 的图像
+    QImage generateImagePreview(const QString &path);
+    // fingerprint 非空时在同一次打开中顺带抽取视频指纹
+    QImage generateVideoPreview(const QString &path, QVector<quint64> *fingerprint = nullptr);
     
-    QFutureWatcher<QString> m_watcher;
-    QString m_cacheDir;
-    QWeakPointer<FileData> m_currentFile;
+    // 同时进行的生成任务数，比线程池少一个线程留给缩略图解码
+    int m_maxJobs;
+    QVector<QWeakPointer<FileData>> m_pending;
+    // 生成中的路径 -> 等待结果的 FileData
+    QHash<QString, QVector<QWeakPointer<FileData>>> m_inFlight;
+    // 正在补算占位图的文件标识
+    QSet<QString> m_placeholderJobs;
     std::unique_ptr<SpriteGenerator> m_spriteGenerator;
+    
+    // 解码占用 CPU 较多，线程数限制在 2 到 4 之间，为界面留出余量
+    static const int MIN_WORKERS = 2;
+    static const int MAX_WORKERS = 4;
+    // 解码尺寸，即最大的缩略图层级
+    static constexpr int PREVIEW_SIZE = ThumbnailStore::LEVELS[ThumbnailStore::LEVEL_COUNT - 1];
 }; 
\ No newline at end of file
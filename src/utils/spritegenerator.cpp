@@ -5,8 +5,41 @@
 #include <QImage>
 #include <QDebug>
 #include <QThreadPool>
+#include <QThreadStorage>
+#include <QSemaphore>
+#include <QVector>
 
-SpriteGenerator::SpriteGenerator(QObject *parent) : QObject(parent), 
+namespace {
+
+// 单个文件的解复用器、解码器与读写缓冲，离开作用域时释放
+struct SpriteDemuxScope {
+    AVFormatContext *format = nullptr;
+    AVCodecContext *codec = nullptr;
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+
+    ~SpriteDemuxScope() {
+        av_frame_free(&frame);
+        av_packet_free(&packet);
+        avcodec_free_context(&codec);
+        avformat_close_input(&format);
+    }
+};
+
+// 编码线程各自缓存的格式转换上下文，同一视频的帧尺寸与格式相同，可以一直复用
+struct SwsHolder {
+    SwsContext *context = nullptr;
+
+    ~SwsHolder() {
+        sws_freeContext(context);
+    }
+};
+
+QThreadStorage<SwsHolder *> swsContexts;
+
+} // namespace
+
+SpriteGenerator::SpriteGenerator(QObject *parent) : QObject(parent),
     m_completedTasks(0), m_totalTasks(0)
 {
     ensureCacheDirectory();
@@ -22,10 +55,10 @@ SpriteGenerator::~SpriteGenerator()
 void SpriteGenerator::ensureCacheDirectory()
 {
     if (m_cacheDir.isEmpty()) {
-        m_cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) 
+        m_cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
                     + "/sprites";
     }
-    
+
     QDir dir;
     if (!dir.exists(m_cacheDir)) {
         if (!dir.mkpath(m_cacheDir)) {
@@ -36,254 +69,194 @@ void SpriteGenerator::ensureCacheDirectory()
 
 QStringList SpriteGenerator::generateSprites(const QString &videoPath, int count)
 {
-    QStringList spritePaths;
     QString hash = QCryptographicHash::hash(videoPath.toUtf8(), QCryptographicHash::Md5).toHex();
-    
-    m_completedTasks = 0;
-    m_totalTasks = count;
-    
-    // 创建并提交所有任务
-    for (int i = 0; i < count; i++) {
-        // 为每个任务创建新的 AVFormatContext
-        AVFormatContext *formatContext = nullptr;
-        if (avformat_open_input(&formatContext, videoPath.toUtf8().constData(), nullptr, nullptr) < 0) {
-            emit error("无法打开视频文件");
-            continue;
-        }
-        
-        if (avformat_find_stream_info(formatContext, nullptr) < 0) {
-            emit error("无法获取视频流信息");
-            avformat_close_input(&formatContext);
-            continue;
-        }
-        
-        int videoStream = -1;
-        for (unsigned int j = 0; j < formatContext->nb_streams; j++) {
-            if (formatContext->streams[j]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-                videoStream = j;
-                break;
-            }
-        }
-        
-        if (videoStream == -1) {
-            emit error("未找到视频流");
-            avformat_close_input(&formatContext);
-            continue;
-        }
-        
-        AVStream *stream = formatContext->streams[videoStream];
-        int64_t duration;
-        if (stream->duration != AV_NOPTS_VALUE) {
-            duration = stream->duration;
-        } else if (formatContext->duration != AV_NOPTS_VALUE) {
-            duration = av_rescale_q(formatContext->duration, AV_TIME_BASE_Q, stream->time_base);
-        } else {
-            emit error("无法获取视频时长");
-            avformat_close_input(&formatContext);
-            continue;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_completedTasks = 0;
+        m_totalTasks = count;
+    }
+    if (count <= 0) {
+        return QStringList();
+    }
+
+    // 整个过程只打开并探测一次文件
+    SpriteDemuxScope scope;
+    if (avformat_open_input(&scope.format, videoPath.toUtf8().constData(), nullptr, nullptr) < 0) {
+        emit error("无法打开视频文件");
+        return QStringList();
+    }
+
+    if (avformat_find_stream_info(scope.format, nullptr) < 0) {
+        emit error("无法获取视频流信息");
+        return QStringList();
+    }
+
+    const int videoStream = av_find_best_stream(scope.format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (videoStream < 0) {
+        emit error("未找到视频流");
+        return QStringList();
+    }
+    // 其他流的数据包由解复用器直接丢弃
+    for (unsigned int i = 0; i < scope.format->nb_streams; i++) {
+        if (int(i) != videoStream) {
+            scope.format->streams[i]->discard = AVDISCARD_ALL;
         }
-        
-        int64_t interval = duration / (count + 1);
-        int64_t timestamp = interval * (i + 1);
-        QString spritePath = m_cacheDir + "/" + hash + "_sprite_" + QString::number(i) + ".jpg";
-        spritePaths.append(spritePath);
-        
-        SpriteGeneratorTask *task = new SpriteGeneratorTask(
-            this, formatContext, videoStream, timestamp, spritePath);
-        task->setAutoDelete(true);
-        m_threadPool->start(task);
     }
-    
-    // 等待所有任务完成
-    m_threadPool->waitForDone();
-    
-    return spritePaths;
-}
 
-QString SpriteGenerator::generateSingleSprite(AVFormatContext *formatContext, 
-                                            int videoStream,
-                                            qint64 timestamp,
-                                            const QString &outputPath)
-{
-    AVStream *stream = formatContext->streams[videoStream];
-    AVCodecParameters *codecParams = stream->codecpar;
-    
-    const AVCodec *codec = avcodec_find_decoder(codecParams->codec_id);
+    AVStream *stream = scope.format->streams[videoStream];
+    int64_t duration;
+    if (stream->duration != AV_NOPTS_VALUE) {
+        duration = stream->duration;
+    } else if (scope.format->duration != AV_NOPTS_VALUE) {
+        duration = av_rescale_q(scope.format->duration, AV_TIME_BASE_Q, stream->time_base);
+    } else {
+        emit error("无法获取视频时长");
+        return QStringList();
+    }
+    const int64_t startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+
+    const AVCodec *codec = avcodec_find_decoder(stream->codecpar->codec_id);
     if (!codec) {
         emit error("无法找到解码器");
-        return QString();
+        return QStringList();
     }
-    
-    AVCodecContext *codecContext = avcodec_alloc_context3(codec);
-    if (!codecContext) {
+
+    scope.codec = avcodec_alloc_context3(codec);
+    if (!scope.codec) {
         emit error("无法创建解码器上下文");
-        return QString();
+        return QStringList();
     }
-    
-    if (avcodec_parameters_to_context(codecContext, codecParams) < 0) {
+
+    if (avcodec_parameters_to_context(scope.codec, stream->codecpar) < 0) {
         emit error("无法复制编解码器参数");
-        avcodec_free_context(&codecContext);
-        return QString();
+        return QStringList();
     }
-    
-    if (avcodec_open2(codecContext, codec, nullptr) < 0) {
+
+    // 只解关键帧，并让解码器自行使用多线程
+    scope.codec->skip_frame = AVDISCARD_NONKEY;
+    scope.codec->thread_count = 0;
+    scope.codec->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    if (avcodec_open2(scope.codec, codec, nullptr) < 0) {
         emit error("无法打开解码器");
-        avcodec_free_context(&codecContext);
-        return QString();
+        return QStringList();
     }
-    
-    int seekFlags = AVSEEK_FLAG_BACKWARD;
-    int maxRetries = 3;
-    bool seekSuccess = false;
-    
-    for (int retry = 0; retry < maxRetries && !seekSuccess; retry++) {
-        int currentFlags = seekFlags;
-        int64_t currentTimestamp = timestamp;
-        
-        if (retry == 1) {
-            currentFlags |= AVSEEK_FLAG_ANY;
-        } else if (retry == 2) {
-            currentTimestamp = av_rescale_q(av_rescale_q(timestamp, stream->time_base, AV_TIME_BASE_Q),
-                                          AV_TIME_BASE_Q, stream->time_base);
-        }
-        
-        if (av_seek_frame(formatContext, videoStream, currentTimestamp, currentFlags) >= 0) {
-            seekSuccess = true;
-            break;
+
+    // 目标时间本身递增，依次定位；每个编码任务只写自己的下标
+    const int64_t interval = duration / (count + 1);
+    QVector<QString> outputs(count);
+    QVector<char> succeeded(count, 0);
+    int64_t lastPts = AV_NOPTS_VALUE;
+    // 解码快于编码时限制排队中的帧数，每帧都占着一整张解码缓冲
+    QSemaphore inFlight(m_threadPool->maxThreadCount() * 2);
+
+    for (int i = 0; i < count; i++) {
+        const int64_t timestamp = startTime + interval * (i + 1);
+        // 定位失败时从当前位置继续向后找
+        if (av_seek_frame(scope.format, videoStream, timestamp, AVSEEK_FLAG_BACKWARD) >= 0) {
+            avcodec_flush_buffers(scope.codec);
         }
-    }
-    
-    if (!seekSuccess) {
-        emit error("无法定位到指定时间戳");
-        avcodec_free_context(&codecContext);
-        return QString();
-    }
-    
-    avcodec_flush_buffers(codecContext);
-    
-    AVFrame *frame = av_frame_alloc();
-    AVFrame *rgbFrame = av_frame_alloc();
-    AVFrame *bestFrame = av_frame_alloc();
-    AVPacket *packet = av_packet_alloc();
-    
-    SwsContext *swsContext = sws_getContext(
-        codecContext->width, codecContext->height, codecContext->pix_fmt,
-        codecContext->width, codecContext->height, AV_PIX_FMT_RGB24,
-        SWS_BILINEAR, nullptr, nullptr, nullptr
-    );
-    
-    int numBytes = av_image_get_buffer_size(AV_PIX_FMT_RGB24, codecContext->width, codecContext->height, 1);
-    uint8_t *buffer = (uint8_t *)av_malloc(numBytes);
-    av_image_fill_arrays(rgbFrame->data, rgbFrame->linesize, buffer,
-                        AV_PIX_FMT_RGB24, codecContext->width, codecContext->height, 1);
-    
-    bool frameExtracted = false;
-    int maxFramesToRead = 200;
-    int framesRead = 0;
-    int64_t bestDiff = INT64_MAX;
-    
-    while (av_read_frame(formatContext, packet) >= 0 && !frameExtracted && framesRead < maxFramesToRead) {
-        if (packet->stream_index == videoStream) {
-            int sendResult = avcodec_send_packet(codecContext, packet);
-            if (sendResult < 0) {
-                av_packet_unref(packet);
-                continue;
-            }
-            
-            while (true) {
-                int receiveResult = avcodec_receive_frame(codecContext, frame);
-                if (receiveResult == AVERROR(EAGAIN) || receiveResult == AVERROR_EOF) {
-                    break;
-                } else if (receiveResult < 0) {
-                    break;
+
+        bool decoded = false;
+        for (int packets = 0; !decoded && packets < MAX_PACKETS_PER_SPRITE
+                              && av_read_frame(scope.format, scope.packet) >= 0; ++packets) {
+            if (scope.packet->stream_index == videoStream && (scope.packet->flags & AV_PKT_FLAG_KEY)) {
+                // 送入一个关键帧后立即排空，再重置解码器以便继续送包
+                if (avcodec_send_packet(scope.codec, scope.packet) >= 0) {
+                    avcodec_send_packet(scope.codec, nullptr);
+                    decoded = avcodec_receive_frame(scope.codec, scope.frame) >= 0;
                 }
-                
-                // 计算当前帧与目标时间戳的差值
-                int64_t diff = llabs(frame->pts - timestamp);
-                if (diff < bestDiff) {
-                    av_frame_unref(bestFrame);
-                    av_frame_ref(bestFrame, frame);
-                    bestDiff = diff;
-                    
-                    if (diff < 1) {  // 如果找到足够接近的帧
-                        frameExtracted = true;
-                        break;
+                avcodec_flush_buffers(scope.codec);
+
+                // 关键帧间隔大于取样间隔时会落回上一张用过的关键帧，改取其后的下一个
+                if (decoded) {
+                    const int64_t pts = scope.frame->best_effort_timestamp;
+                    if (lastPts != AV_NOPTS_VALUE && pts != AV_NOPTS_VALUE && pts <= lastPts) {
+                        av_frame_unref(scope.frame);
+                        decoded = false;
                     }
                 }
             }
+            av_packet_unref(scope.packet);
+        }
+
+        if (!decoded) {
+            emit error("无法提取视频帧");
+            continue;
+        }
+
+        const int64_t pts = scope.frame->best_effort_timestamp;
+        if (pts != AV_NOPTS_VALUE) {
+            lastPts = pts;
         }
-        av_packet_unref(packet);
-        framesRead++;
-        
-        if (frameExtracted) break;
+        const double seconds = (pts != AV_NOPTS_VALUE ? pts - startTime : timestamp - startTime)
+                               * av_q2d(stream->time_base);
+
+        // 帧数据按引用计数管理，交给编码任务后解码器可以立即继续
+        AVFrame *owned = av_frame_alloc();
+        av_frame_move_ref(owned, scope.frame);
+        outputs[i] = m_cacheDir + "/" + hash + "_sprite_" + QString::number(i) + ".jpg";
+        const QString outputPath = outputs[i];
+        char *result = &succeeded[i];
+        inFlight.acquire();
+        m_threadPool->start([this, owned, seconds, outputPath, result, &inFlight]() {
+            *result = encodeSprite(owned, seconds, outputPath) ? 1 : 0;
+            inFlight.release();
+        });
     }
-    
-    bool saveSuccess = false;
-    if (bestDiff != INT64_MAX) {
-        int scaleResult = sws_scale(swsContext, bestFrame->data, bestFrame->linesize, 0,
-                                  codecContext->height, rgbFrame->data, rgbFrame->linesize);
-        
-        if (scaleResult > 0) {
-            QImage image(rgbFrame->data[0], 
-                        codecContext->width, 
-                        codecContext->height,
-                        rgbFrame->linesize[0], 
-                        QImage::Format_RGB888);
-            
-            saveSuccess = image.save(outputPath, "JPG", 40);
+
+    // 等待所有编码任务完成
+    m_threadPool->waitForDone();
+
+    QStringList spritePaths;
+    for (int i = 0; i < count; i++) {
+        if (succeeded[i]) {
+            spritePaths.append(outputs[i]);
         }
     }
-    
-    av_frame_free(&bestFrame);
-    av_frame_free(&frame);
-    av_frame_free(&rgbFrame);
-    av_packet_free(&packet);
-    av_free(buffer);
-    sws_freeContext(swsContext);
-    avcodec_free_context(&codecContext);
-    
-    return saveSuccess ? outputPath : QString();
+    return spritePaths;
 }
 
-double SpriteGenerator::getSpriteTimestamp(const QString &spritePath) const
+bool SpriteGenerator::encodeSprite(AVFrame *frame, double seconds, const QString &outputPath)
 {
-    return m_spriteTimestamps.value(spritePath, 0.0);
-}
+    if (!swsContexts.hasLocalData()) {
+        swsContexts.setLocalData(new SwsHolder);
+    }
+    SwsHolder *holder = swsContexts.localData();
+    holder->context = sws_getCachedContext(holder->context,
+        frame->width, frame->height, AVPixelFormat(frame->format),
+        frame->width, frame->height, AV_PIX_FMT_RGB24,
+        SWS_BILINEAR, nullptr, nullptr, nullptr);
 
-SpriteGeneratorTask::SpriteGeneratorTask(SpriteGenerator *generator,
-                                       AVFormatContext *formatContext,
-                                       int videoStream,
-                                       qint64 timestamp,
-                                       const QString &outputPath)
-    : m_generator(generator),
-      m_formatContext(formatContext),
-      m_videoStream(videoStream),
-      m_timestamp(timestamp),
-      m_outputPath(outputPath)
-{
-}
+    bool saveSuccess = false;
+    if (holder->context) {
+        // 直接转换到 QImage 的像素缓冲
+        QImage image(frame->width, frame->height, QImage::Format_RGB888);
+        uint8_t *destination[4] = {image.bits(), nullptr, nullptr, nullptr};
+        int destinationLinesize[4] = {int(image.bytesPerLine()), 0, 0, 0};
+        const int scaleResult = sws_scale(holder->context, frame->data, frame->linesize, 0, frame->height,
+                                          destination, destinationLinesize);
+        av_frame_free(&frame);
+        saveSuccess = scaleResult > 0 && image.save(outputPath, "JPG", 40);
+    } else {
+        av_frame_free(&frame);
+        emit error("无法创建缩放上下文");
+    }
 
-void SpriteGeneratorTask::run()
-{
-    QString generatedPath = m_generator->generateSingleSprite(
-        m_formatContext, m_videoStream, m_timestamp, m_outputPath);
-        
-    if (!generatedPath.isEmpty()) {
-        QMutexLocker locker(&m_generator->m_mutex);
-        double timeInSeconds = m_timestamp * 
-            av_q2d(m_formatContext->streams[m_videoStream]->time_base);
-        m_generator->m_spriteTimestamps[generatedPath] = timeInSeconds;
-        m_generator->m_completedTasks++;
-        QMetaObject::invokeMethod(m_generator, "progressChanged",
+    if (saveSuccess) {
+        QMutexLocker locker(&m_mutex);
+        m_spriteTimestamps[outputPath] = seconds;
+        m_completedTasks++;
+        QMetaObject::invokeMethod(this, "progressChanged",
                                 Qt::QueuedConnection,
-                                Q_ARG(int, m_generator->m_completedTasks),
-                                Q_ARG(int, m_generator->m_totalTasks));
+                                Q_ARG(int, m_completedTasks),
+                                Q_ARG(int, m_totalTasks));
     }
+    return saveSuccess;
 }
 
-SpriteGeneratorTask::~SpriteGeneratorTask()
+double SpriteGenerator::getSpriteTimestamp(const QString &spritePath) const
 {
-    if (m_formatContext) {
-        avformat_close_input(&m_formatContext);
-    }
-}
\ No newline at end of file
+    QMutexLocker locker(&m_mutex);
+    return m_spriteTimestamps.value(spritePath, 0.0);
+}
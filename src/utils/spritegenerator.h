@@ -5,7 +5,6 @@
 #include <QMap>
 #include <QMutex>
 #include <QThreadPool>
-#include <QRunnable>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -14,14 +13,17 @@ extern "C" {
 #include <libavutil/imgutils.h>
 }
 
-class SpriteGeneratorTask;
-
+// 视频雪碧图：在时长内均匀取 count 个位置各截一帧
+// 文件只打开、探测一次，目标时间按先后顺序访问，每个位置向前定位到最近的关键帧，
+// 由同一个只解关键帧的解码器解出。解出的帧交给线程池做像素格式转换与 JPEG 编码，
+// 解码线程随即去找下一个位置，总耗时接近 count 次关键帧解码。
 class SpriteGenerator : public QObject {
     Q_OBJECT
 public:
     explicit SpriteGenerator(QObject *parent = nullptr);
     ~SpriteGenerator();
-    
+
+    // 阻塞直到全部编码完成，返回成功生成的雪碧图路径，按时间先后排列
     QStringList generateSprites(const QString &videoPath, int count);
     double getSpriteTimestamp(const QString &spritePath) const;
     void setCacheDirectory(const QString &path) { m_cacheDir = path; }
@@ -32,35 +34,17 @@ signals:
     void error(const QString &message);
 
 private:
-    friend class SpriteGeneratorTask;
     void ensureCacheDirectory();
-    QString generateSingleSprite(AVFormatContext *formatContext, 
-                               int videoStream,
-                               qint64 timestamp,
-                               const QString &outputPath);
-                               
+    // 在线程池中执行，接管 frame 的所有权
+    bool encodeSprite(AVFrame *frame, double seconds, const QString &outputPath);
+
     QString m_cacheDir;
     QMap<QString, double> m_spriteTimestamps;
-    QMutex m_mutex;
+    mutable QMutex m_mutex;
     QThreadPool *m_threadPool;
     int m_completedTasks;
     int m_totalTasks;
-};
 
-class SpriteGeneratorTask : public QRunnable {
-public:
-    SpriteGeneratorTask(SpriteGenerator *generator,
-                       AVFormatContext *formatContext,
-                       int videoStream,
-                       qint64 timestamp,
-                       const QString &outputPath);
-    ~SpriteGeneratorTask();
-    void run() override;
-
-private:
-    SpriteGenerator *m_generator;
-    AVFormatContext *m_formatContext;
-    int m_videoStream;
-    qint64 m_timestamp;
-    QString m_outputPath;
-}; 
\ No newline at end of file
+    // 定位后找关键帧时最多读取的数据包数
+    static const int MAX_PACKETS_PER_SPRITE = 2000;
+};
@@ -0,0 +1,90 @@
+#include "thumbnailprovider.h"
+#include <QStringList>
+#include "previewgenerator.h"
+
+namespace {
+
+class ThumbnailResponse : public QQuickImageResponse {
+public:
+    explicit ThumbnailResponse(const QSize &requestedSize)
+        : m_requestedSize(requestedSize) {
+    }
+
+    // 可以在任意线程调用，finished 信号允许跨线程发出
+    void finish(const QImage &image) {
+        m_image = image;
+        if (!m_image.isNull() && m_requestedSize.isValid()
+            && (m_image.width() > m_requestedSize.width() || m_image.height() > m_requestedSize.height())) {
+            m_image = m_image.scaled(m_requestedSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+        emit finished();
+    }
+
+    QQuickTextureFactory *textureFactory() const override {
+        return QQuickTextureFactory::textureFactoryForImage(m_image);
+    }
+
+    QString errorString() const override {
+        return m_image.isNull() ? QStringLiteral("缩略图不存在") : QString();
+    }
+
+private:
+    QSize m_requestedSize;
+    QImage m_image;
+};
+
+} // namespace
+
+ThumbnailProvider::ThumbnailProvider() {
+    m_cache.setMaxCost(CACHE_KB);
+}
+
+ThumbnailProvider::~ThumbnailProvider() {
+    // 解码任务引用本对象
+    PreviewGenerator::workerPool().waitForDone();
+}
+
+QQuickImageResponse *ThumbnailProvider::requestImageResponse(const QString &id, const QSize &requestedSize) {
+    auto *response = new ThumbnailResponse(requestedSize);
+
+    QImage image;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (const QImage *cached = m_cache.object(id)) {
+            image = *cached;
+        }
+    }
+
+    if (!image.isNull()) {
+        // 调用方在返回后才连接 finished，命中时排队发出
+        QMetaObject::invokeMethod(response, [response, image]() {
+            response->finish(image);
+        }, Qt::QueuedConnection);
+        return response;
+    }
+
+    PreviewGenerator::workerPool().start([this, response, id]() {
+        response->finish(decode(id));
+    }, DECODE_PRIORITY);
+    return response;
+}
+
+QImage ThumbnailProvider::decode(const QString &id) {
+    const QStringList parts = id.split('/');
+    const ThumbnailStore::Key key = ThumbnailStore::Key::fromString(parts.value(0));
+    const int level = parts.size() > 1
+        ? ThumbnailStore::levelFor(parts.at(1).toInt())
+        : ThumbnailStore::LEVELS[ThumbnailStore::LEVEL_COUNT - 1];
+    QImage image;
+    if (key.isNull() || !image.loadFromData(ThumbnailStore::instance().read(key.level(level)), "JPG")) {
+        return QImage();
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_cache.insert(id, new QImage(image), qMax<qsizetype>(1, image.sizeInBytes() / 1024));
+    return image;
+}
+
+QString ThumbnailProvider::urlFor(const ThumbnailStore::Key &key) {
+    return QString("image://%1/%2").arg(QLatin1String(PROVIDER_ID), key.toString());
+}
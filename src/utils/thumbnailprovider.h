@@ -0,0 +1,33 @@
+#pragma once
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QQuickAsyncImageProvider>
+#include "thumbnailstore.h"
+
+// 从缩略图包中读取预览图，URL 形如 image://thumbs/<基础键>/<层级>
+// FileData 只保存不带层级的部分，由模型按当前图标大小与预览质量补上层级。
+// 解码后的图像放在按字节计量的 LRU 缓存中，命中时立即返回；未命中时在预览生成共用的线程池中
+// 以较高优先级读取并解码，排在尚未开始的生成任务之前。来回滚动的网格不再重复读盘和解码。
+class ThumbnailProvider : public QQuickAsyncImageProvider {
+public:
+    static constexpr const char *PROVIDER_ID = "thumbs";
+
+    ThumbnailProvider();
+    ~ThumbnailProvider();
+    QQuickImageResponse *requestImageResponse(const QString &id, const QSize &requestedSize) override;
+
+    // 不带层级的 URL
+    static QString urlFor(const ThumbnailStore::Key &key);
+
+private:
+    QImage decode(const QString &id);
+
+    QMutex m_mutex;
+    // 键为不含尺寸请求的 id，成本以 KB 计
+    QCache<QString, QImage> m_cache;
+
+    static const int CACHE_KB = 128 * 1024;
+    // 高于预览生成任务的线程池优先级
+    static const int DECODE_PRIORITY = 1;
+};
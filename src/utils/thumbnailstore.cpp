@@ -0,0 +1,574 @@
+#include "thumbnailstore.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <QVector>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+// 包内每条记录：magic(4) length(4) key.high(8) key.low(8)，之后是数据
+const quint32 RECORD_MAGIC = 0x4B505454;  // "TTPK"
+const int RECORD_HEADER_SIZE = 24;
+
+// 索引文件：magic(4) version(4) tick(4) activePack(4) activeSize(8) count(4) reserved(4)
+// 之后每条 key.high(8) key.low(8) pack(4) offset(4) length(4) tick(4)
+const quint32 INDEX_MAGIC = 0x58495454;   // "TTIX"
+const quint32 INDEX_VERSION = 1;
+const int INDEX_HEADER_SIZE = 32;
+const int INDEX_RECORD_SIZE = 32;
+
+// 淘汰到预算的这个比例为止，避免每次写入都触发淘汰
+const double EVICT_TARGET = 0.8;
+
+// 键的低 4 位：0 为基础键，1..LEVEL_COUNT 为层级序号加一
+const quint64 LEVEL_MASK = 0xF;
+
+} // namespace
+
+QString ThumbnailStore::Key::toString() const {
+    return QString("%1%2").arg(high, 16, 16, QLatin1Char('0')).arg(low, 16, 16, QLatin1Char('0'));
+}
+
+ThumbnailStore::Key ThumbnailStore::Key::fromString(const QString &text) {
+    Key key;
+    if (text.size() != 32) {
+        return key;
+    }
+    bool highOk = false;
+    bool lowOk = false;
+    key.high = text.left(16).toULongLong(&highOk, 16);
+    key.low = text.mid(16).toULongLong(&lowOk, 16);
+    if (!highOk || !lowOk) {
+        return Key();
+    }
+    return key;
+}
+
+ThumbnailStore::Key ThumbnailStore::Key::level(int dimension) const {
+    int index = 0;
+    while (index < LEVEL_COUNT - 1 && LEVELS[index] < dimension) {
+        ++index;
+    }
+    Key key = base();
+    key.low |= quint64(index + 1);
+    return key;
+}
+
+ThumbnailStore::Key ThumbnailStore::Key::base() const {
+    Key key = *this;
+    key.low &= ~LEVEL_MASK;
+    return key;
+}
+
+int ThumbnailStore::levelFor(int pixels) {
+    for (int level : LEVELS) {
+        if (level >= pixels) {
+            return level;
+        }
+    }
+    return LEVELS[LEVEL_COUNT - 1];
+}
+
+ThumbnailStore &ThumbnailStore::instance() {
+    static ThumbnailStore store;
+    return store;
+}
+
+ThumbnailStore::Key ThumbnailStore::makeKey(const QString &identity, const QDateTime &modified,
+                                            qint64 size) {
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(identity.toUtf8());
+    hash.addData(QByteArray::number(modified.toMSecsSinceEpoch()));
+    hash.addData(QByteArray::number(size));
+    const QByteArray digest = hash.result();
+
+    Key key;
+    key.high = qFromBigEndian<quint64>(digest.constData());
+    key.low = qFromBigEndian<quint64>(digest.constData() + 8);
+    return key.base();
+}
+
+ThumbnailStore::ThumbnailStore() {
+    m_dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails";
+    open();
+}
+
+ThumbnailStore::~ThumbnailStore() {
+    QMutexLocker locker(&m_mutex);
+    saveIndexUnlocked();
+    for (Pack *pack : std::as_const(m_packs)) {
+        closePack(pack, false);
+    }
+    m_packs.clear();
+}
+
+void ThumbnailStore::open() {
+    QMutexLocker locker(&m_mutex);
+
+    if (!QDir().mkpath(m_dir)) {
+        qWarning() << "缩略图目录创建失败:" << m_dir;
+    }
+
+    // 旧版本每个文件一个 JPEG 的缓存目录已不再使用
+    QDir legacy(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/previews");
+    if (legacy.exists()) {
+        legacy.removeRecursively();
+    }
+
+    QVector<quint32> ids;
+    const QStringList names = QDir(m_dir).entryList({"pack-*.dat"}, QDir::Files);
+    for (const QString &name : names) {
+        bool ok = false;
+        const quint32 id = name.mid(5, name.size() - 9).toUInt(&ok);
+        if (ok && id > 0) {
+            ids.append(id);
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+
+    for (int i = 0; i < ids.size(); ++i) {
+        openPack(ids[i], i == ids.size() - 1);
+    }
+
+    quint32 indexedPack = 0;
+    qint64 indexedSize = 0;
+    if (!loadIndex(&indexedPack, &indexedSize)) {
+        // 索引缺失或损坏：从包文件重建
+        m_entries.clear();
+        for (Pack *pack : std::as_const(m_packs)) {
+            pack->liveBytes = 0;
+        }
+        indexedPack = 0;
+        indexedSize = 0;
+    }
+
+    // 补上索引保存之后追加的记录
+    for (Pack *pack : std::as_const(m_packs)) {
+        if (pack->id > indexedPack) {
+            scanPack(pack, 0);
+        } else if (pack->id == indexedPack) {
+            scanPack(pack, indexedSize);
+        }
+    }
+
+    if (m_packs.isEmpty()) {
+        openPack(1, true);
+    }
+
+    enforceBudgetUnlocked();
+}
+
+bool ThumbnailStore::loadIndex(quint32 *indexedPack, qint64 *indexedSize) {
+    QFile file(m_dir + "/index.dat");
+    if (!file.open(QIODevice::ReadOnly) || file.size() < INDEX_HEADER_SIZE) {
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    const uchar *data = file.map(0, fileSize);
+    if (!data) {
+        return false;
+    }
+
+    const quint32 count = qFromLittleEndian<quint32>(data + 24);
+    if (qFromLittleEndian<quint32>(data) != INDEX_MAGIC
+        || qFromLittleEndian<quint32>(data + 4) != INDEX_VERSION
+        || fileSize != INDEX_HEADER_SIZE + qint64(count) * INDEX_RECORD_SIZE) {
+        file.unmap(const_cast<uchar *>(data));
+        return false;
+    }
+
+    m_tick = qFromLittleEndian<quint32>(data + 8);
+    *indexedPack = qFromLittleEndian<quint32>(data + 12);
+    *indexedSize = qFromLittleEndian<qint64>(data + 16);
+
+    m_entries.reserve(count);
+    const uchar *record = data + INDEX_HEADER_SIZE;
+    for (quint32 i = 0; i < count; ++i, record += INDEX_RECORD_SIZE) {
+        Key key;
+        key.high = qFromLittleEndian<quint64>(record);
+        key.low = qFromLittleEndian<quint64>(record + 8);
+        Entry entry;
+        entry.pack = qFromLittleEndian<quint32>(record + 16);
+        entry.offset = qFromLittleEndian<quint32>(record + 20);
+        entry.length = qFromLittleEndian<quint32>(record + 24);
+        entry.tick = qFromLittleEndian<quint32>(record + 28);
+
+        // 指向已删除的包或越过包尾的记录直接丢弃
+        Pack *pack = m_packs.value(entry.pack);
+        if (!pack || qint64(entry.offset) + entry.length > pack->file->size()) {
+            continue;
+        }
+        m_entries.insert(key, entry);
+        pack->liveBytes += entry.length;
+    }
+
+    file.unmap(const_cast<uchar *>(data));
+    return true;
+}
+
+void ThumbnailStore::saveIndexUnlocked() {
+    if (m_packs.isEmpty()) {
+        return;
+    }
+
+    QByteArray buffer(INDEX_HEADER_SIZE + qsizetype(m_entries.size()) * INDEX_RECORD_SIZE, Qt::Uninitialized);
+    uchar *data = reinterpret_cast<uchar *>(buffer.data());
+    Pack *active = m_packs.last();
+    qToLittleEndian<quint32>(INDEX_MAGIC, data);
+    qToLittleEndian<quint32>(INDEX_VERSION, data + 4);
+    qToLittleEndian<quint32>(m_tick, data + 8);
+    qToLittleEndian<quint32>(active->id, data + 12);
+    qToLittleEndian<qint64>(active->file->size(), data + 16);
+    qToLittleEndian<quint32>(quint32(m_entries.size()), data + 24);
+    qToLittleEndian<quint32>(0, data + 28);
+
+    uchar *record = data + INDEX_HEADER_SIZE;
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it, record += INDEX_RECORD_SIZE) {
+        qToLittleEndian<quint64>(it.key().high, record);
+        qToLittleEndian<quint64>(it.key().low, record + 8);
+        qToLittleEndian<quint32>(it->pack, record + 16);
+        qToLittleEndian<quint32>(it->offset, record + 20);
+        qToLittleEndian<quint32>(it->length, record + 24);
+        qToLittleEndian<quint32>(it->tick, record + 28);
+    }
+
+    QSaveFile file(m_dir + "/index.dat");
+    if (!file.open(QIODevice::WriteOnly) || file.write(buffer) != buffer.size() || !file.commit()) {
+        qWarning() << "缩略图索引保存失败:" << file.errorString();
+        return;
+    }
+    m_unsavedWrites = 0;
+}
+
+ThumbnailStore::Pack *ThumbnailStore::openPack(quint32 id, bool active) {
+    auto *pack = new Pack;
+    pack->id = id;
+    pack->file = new QFile(packPath(id));
+    const QIODevice::OpenMode mode = active ? QIODevice::ReadWrite : QIODevice::ReadOnly;
+    if (!pack->file->open(mode)) {
+        qWarning() << "缩略图包打开失败:" << pack->file->fileName() << pack->file->errorString();
+    }
+    m_packs.insert(id, pack);
+    return pack;
+}
+
+void ThumbnailStore::closePack(Pack *pack, bool remove) {
+    if (pack->map) {
+        pack->file->unmap(pack->map);
+    }
+    pack->file->close();
+    if (remove) {
+        pack->file->remove();
+    }
+    delete pack->file;
+    delete pack;
+}
+
+void ThumbnailStore::scanPack(Pack *pack, qint64 offset) {
+    const qint64 size = pack->file->size();
+    if (offset >= size || !ensureMapped(pack, size)) {
+        return;
+    }
+
+    while (offset + RECORD_HEADER_SIZE <= size) {
+        const uchar *header = pack->map + offset;
+        const quint32 length = qFromLittleEndian<quint32>(header + 4);
+        if (qFromLittleEndian<quint32>(header) != RECORD_MAGIC
+            || offset + RECORD_HEADER_SIZE + length > size) {
+            break;
+        }
+
+        Key key;
+        key.high = qFromLittleEndian<quint64>(header + 8);
+        key.low = qFromLittleEndian<quint64>(header + 16);
+        forgetUnlocked(key);
+
+        Entry entry;
+        entry.pack = pack->id;
+        entry.offset = quint32(offset + RECORD_HEADER_SIZE);
+        entry.length = length;
+        entry.tick = ++m_tick;
+        m_entries.insert(key, entry);
+        pack->liveBytes += length;
+
+        offset += RECORD_HEADER_SIZE + length;
+    }
+
+    // 写入中途退出留下的半条记录
+    if (offset < size && pack == m_packs.last()) {
+        pack->file->unmap(pack->map);
+        pack->map = nullptr;
+        pack->mapped = 0;
+        pack->file->resize(offset);
+    }
+}
+
+bool ThumbnailStore::ensureMapped(Pack *pack, qint64 end) {
+    if (pack->map && pack->mapped >= end) {
+        return true;
+    }
+    // 当前包追加后映射需要扩大
+    if (pack->map) {
+        pack->file->unmap(pack->map);
+        pack->map = nullptr;
+        pack->mapped = 0;
+    }
+    const qint64 size = pack->file->size();
+    if (size < end) {
+        return false;
+    }
+    pack->map = pack->file->map(0, size);
+    if (!pack->map) {
+        return false;
+    }
+    pack->mapped = size;
+    return true;
+}
+
+bool ThumbnailStore::contains(const Key &key) const {
+    QMutexLocker locker(&m_mutex);
+    return m_entries.contains(key);
+}
+
+bool ThumbnailStore::containsLevels(const Key &base) const {
+    QMutexLocker locker(&m_mutex);
+    for (int dimension : LEVELS) {
+        if (!m_entries.contains(base.level(dimension))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QByteArray ThumbnailStore::read(const Key &key) {
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return QByteArray();
+    }
+
+    Pack *pack = m_packs.value(it->pack);
+    if (!pack || !ensureMapped(pack, qint64(it->offset) + it->length)) {
+        forgetUnlocked(key);
+        return QByteArray();
+    }
+
+    // 同一文件的各层级一起刷新，淘汰时才不会只留下其中几级
+    const quint32 tick = ++m_tick;
+    for (int dimension : LEVELS) {
+        auto sibling = m_entries.find(key.level(dimension));
+        if (sibling != m_entries.end()) {
+            sibling->tick = tick;
+        }
+    }
+    // 复制出映射区，整理时包可能被删除
+    return QByteArray(reinterpret_cast<const char *>(pack->map + it->offset), it->length);
+}
+
+bool ThumbnailStore::write(const Key &key, const QByteArray &data) {
+    return write(QVector<QPair<Key, QByteArray>>{{key, data}});
+}
+
+bool ThumbnailStore::write(const QVector<QPair<Key, QByteArray>> &items) {
+    QMutexLocker locker(&m_mutex);
+    const quint32 tick = ++m_tick;
+    for (const auto &item : items) {
+        if (item.first.isNull() || item.second.isEmpty()
+            || !appendUnlocked(item.first, item.second.constData(), quint32(item.second.size()), tick)) {
+            return false;
+        }
+    }
+
+    enforceBudgetUnlocked();
+    m_unsavedWrites += items.size();
+    if (m_unsavedWrites >= SYNC_INTERVAL) {
+        saveIndexUnlocked();
+    }
+    return true;
+}
+
+bool ThumbnailStore::appendUnlocked(const Key &key, const char *data, quint32 length, quint32 tick) {
+    Pack *active = m_packs.last();
+    if (active->file->size() + RECORD_HEADER_SIZE + length > PACK_LIMIT && active->file->size() > 0) {
+        active = openPack(active->id + 1, true);
+    }
+
+    uchar header[RECORD_HEADER_SIZE];
+    qToLittleEndian<quint32>(RECORD_MAGIC, header);
+    qToLittleEndian<quint32>(length, header + 4);
+    qToLittleEndian<quint64>(key.high, header + 8);
+    qToLittleEndian<quint64>(key.low, header + 16);
+
+    QFile *file = active->file;
+    const qint64 offset = file->size();
+    if (!file->seek(offset)
+        || file->write(reinterpret_cast<const char *>(header), RECORD_HEADER_SIZE) != RECORD_HEADER_SIZE
+        || file->write(data, length) != qint64(length)
+        || !file->flush()) {
+        qWarning() << "缩略图写入失败:" << file->errorString();
+        file->resize(offset);
+        return false;
+    }
+
+    forgetUnlocked(key);
+    Entry entry;
+    entry.pack = active->id;
+    entry.offset = quint32(offset + RECORD_HEADER_SIZE);
+    entry.length = length;
+    entry.tick = tick;
+    m_entries.insert(key, entry);
+    active->liveBytes += length;
+    return true;
+}
+
+void ThumbnailStore::forgetUnlocked(const Key &key) {
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return;
+    }
+    if (Pack *pack = m_packs.value(it->pack)) {
+        pack->liveBytes -= it->length;
+    }
+    m_entries.erase(it);
+}
+
+qint64 ThumbnailStore::forgetLevelsUnlocked(const Key &base) {
+    qint64 released = 0;
+    for (int dimension : LEVELS) {
+        const Key key = base.level(dimension);
+        auto it = m_entries.constFind(key);
+        if (it != m_entries.cend()) {
+            released += it->length;
+            forgetUnlocked(key);
+        }
+    }
+    return released;
+}
+
+void ThumbnailStore::enforceBudgetUnlocked() {
+    if (totalBytesUnlocked() <= m_budget) {
+        return;
+    }
+
+    // 有效数据超出预算时按访问序号淘汰最久未用的文件，每次连同它的全部层级
+    qint64 liveBytes = 0;
+    for (const Pack *pack : std::as_const(m_packs)) {
+        liveBytes += pack->liveBytes;
+    }
+    const qint64 target = qint64(m_budget * EVICT_TARGET);
+    if (liveBytes > target) {
+        QVector<QPair<quint32, Key>> order;
+        order.reserve(m_entries.size());
+        for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+            order.append({it->tick, it.key()});
+        }
+        std::sort(order.begin(), order.end(), [](const auto &a, const auto &b) {
+            return a.first < b.first;
+        });
+        for (const auto &item : std::as_const(order)) {
+            if (liveBytes <= target) {
+                break;
+            }
+            if (!m_entries.contains(item.second)) {
+                continue;
+            }
+            // 不是层级键的条目（如旧版本留下的）没有同组条目，单独淘汰
+            if ((item.second.low & LEVEL_MASK) == 0 || (item.second.low & LEVEL_MASK) > quint64(LEVEL_COUNT)) {
+                liveBytes -= m_entries.value(item.second).length;
+                forgetUnlocked(item.second);
+            } else {
+                liveBytes -= forgetLevelsUnlocked(item.second.base());
+            }
+        }
+    }
+
+    // 淘汰只留下空洞：有效数据不足一半的包整体搬移后删除，
+    // 仍超出预算时继续从空洞比例最高的包开始整理
+    QVector<Pack *> candidates;
+    for (Pack *pack : std::as_const(m_packs)) {
+        if (pack->file->size() > pack->liveBytes) {
+            candidates.append(pack);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Pack *a, const Pack *b) {
+        return double(a->liveBytes) / a->file->size() < double(b->liveBytes) / b->file->size();
+    });
+
+    qint64 projected = totalBytesUnlocked();
+    QVector<Pack *> sparse;
+    for (Pack *pack : std::as_const(candidates)) {
+        const qint64 size = pack->file->size();
+        if (pack->liveBytes * 2 >= size && projected <= m_budget) {
+            break;
+        }
+        sparse.append(pack);
+        projected -= size - pack->liveBytes;
+    }
+    if (sparse.isEmpty()) {
+        return;
+    }
+    if (sparse.contains(m_packs.last())) {
+        openPack(m_packs.last()->id + 1, true);
+    }
+    for (Pack *pack : std::as_const(sparse)) {
+        compactUnlocked(pack);
+    }
+    saveIndexUnlocked();
+}
+
+void ThumbnailStore::compactUnlocked(Pack *pack) {
+    if (pack->liveBytes > 0 && ensureMapped(pack, pack->file->size())) {
+        QVector<Key> keys;
+        for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+            if (it->pack == pack->id) {
+                keys.append(it.key());
+            }
+        }
+        for (const Key &key : std::as_const(keys)) {
+            const Entry entry = m_entries.value(key);
+            appendUnlocked(key, reinterpret_cast<const char *>(pack->map + entry.offset),
+                           entry.length, entry.tick);
+        }
+    }
+
+    // 搬移失败的条目随包一起丢弃
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        it = it->pack == pack->id ? m_entries.erase(it) : std::next(it);
+    }
+    m_packs.remove(pack->id);
+    closePack(pack, true);
+}
+
+qint64 ThumbnailStore::totalBytesUnlocked() const {
+    qint64 total = 0;
+    for (const Pack *pack : std::as_const(m_packs)) {
+        total += pack->file->size();
+    }
+    return total;
+}
+
+QString ThumbnailStore::packPath(quint32 id) const {
+    return QString("%1/pack-%2.dat").arg(m_dir).arg(id);
+}
+
+qint64 ThumbnailStore::budget() const {
+    QMutexLocker locker(&m_mutex);
+    return m_budget;
+}
+
+void ThumbnailStore::setBudget(qint64 bytes) {
+    QMutexLocker locker(&m_mutex);
+    m_budget = qMax<qint64>(bytes, PACK_LIMIT);
+    enforceBudgetUnlocked();
+}
+
+void ThumbnailStore::sync() {
+    QMutexLocker locker(&m_mutex);
+    saveIndexUnlocked();
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <QPair>
+
+class QFile;
+
+// 缩略图打包存储
+// 缩略图追加写入少量包文件（pack-N.dat），不再每个源文件对应一个 JPEG。
+// 键由文件标识、修改时间、大小与请求尺寸共同决定，源文件改动后旧缩略图自然不再命中。
+// 每个文件保存一组边长逐级减半的缩略图（LEVELS），一次解码生成并连续写入，显示时按需取其一。
+// 索引常驻内存并以定长记录持久化为 index.dat，启动时映射读入；包文件以只读映射访问，
+// 查找与读取都不产生逐文件的系统调用。总大小超出预算时按最近访问时间淘汰，
+// 同一文件的各层级共用访问时间、一起淘汰，读到任一层级时其余层级也一定存在；
+// 有效数据不足一半的包会把剩余条目搬到当前包后整体删除。
+// 所有方法都可以跨线程调用。
+class ThumbnailStore {
+public:
+    struct Key {
+        quint64 high = 0;
+        quint64 low = 0;
+
+        bool isNull() const { return high == 0 && low == 0; }
+        bool operator==(const Key &other) const { return high == other.high && low == other.low; }
+        // 同一文件某一层级的键，低 4 位为层级序号
+        Key level(int dimension) const;
+        // 去掉层级序号后的基础键
+        Key base() const;
+        // 32 位十六进制文本，用于图像提供器的 URL
+        QString toString() const;
+        static Key fromString(const QString &text);
+    };
+
+    // 缩略图层级（边长像素），从小到大
+    static constexpr int LEVELS[] = {64, 128, 256, 512};
+    static constexpr int LEVEL_COUNT = int(sizeof(LEVELS) / sizeof(LEVELS[0]));
+    // 不小于 pixels 的最小层级，超出时返回最大层级
+    static int levelFor(int pixels);
+
+    static ThumbnailStore &instance();
+    // 文件的基础键，identity 优先使用文件标识，没有时使用路径
+    static Key makeKey(const QString &identity, const QDateTime &modified, qint64 size);
+
+    bool contains(const Key &key) const;
+    // 基础键对应的各层级是否都在
+    bool containsLevels(const Key &base) const;
+    // 返回编码后的图像数据并刷新访问时间，未命中返回空
+    QByteArray read(const Key &key);
+    bool write(const Key &key, const QByteArray &data);
+    // 一次写入多条，在包内相邻存放
+    bool write(const QVector<QPair<Key, QByteArray>> &items);
+
+    qint64 budget() const;
+    void setBudget(qint64 bytes);
+    // 把索引写回磁盘
+    void sync();
+
+private:
+    ThumbnailStore();
+    ~ThumbnailStore();
+    ThumbnailStore(const ThumbnailStore &) = delete;
+    ThumbnailStore &operator=(const ThumbnailStore &) = delete;
+
+    struct Entry {
+        quint32 pack = 0;
+        quint32 offset = 0;  // 数据起始位置（记录头之后）
+        quint32 length = 0;
+        quint32 tick = 0;    // 最近访问序号
+    };
+
+    struct Pack {
+        quint32 id = 0;
+        QFile *file = nullptr;
+        uchar *map = nullptr;
+        qint64 mapped = 0;
+        qint64 liveBytes = 0;
+    };
+
+    void open();
+    bool loadIndex(quint32 *indexedPack, qint64 *indexedSize);
+    void saveIndexUnlocked();
+    Pack *openPack(quint32 id, bool active);
+    void closePack(Pack *pack, bool remove);
+    // 从 offset 开始扫描包内记录补全索引，遇到损坏的尾部时截断当前包
+    void scanPack(Pack *pack, qint64 offset);
+    bool ensureMapped(Pack *pack, qint64 end);
+    bool appendUnlocked(const Key &key, const char *data, quint32 length, quint32 tick);
+    void forgetUnlocked(const Key &key);
+    // 淘汰同一文件的全部层级，返回释放的数据量
+    qint64 forgetLevelsUnlocked(const Key &base);
+    void enforceBudgetUnlocked();
+    void compactUnlocked(Pack *pack);
+    qint64 totalBytesUnlocked() const;
+    QString packPath(quint32 id) const;
+
+    mutable QMutex m_mutex;
+    QString m_dir;
+    QHash<Key, Entry> m_entries;
+    QMap<quint32, Pack *> m_packs;   // 按编号排序，最后一个为当前写入的包
+    quint32 m_tick = 0;
+    qint64 m_budget = DEFAULT_BUDGET;
+    int m_unsavedWrites = 0;
+
+    static constexpr qint64 DEFAULT_BUDGET = 1024LL * 1024 * 1024;
+    // 单个包的上限，控制整理时一次搬移的数据量
+    static constexpr qint64 PACK_LIMIT = 64LL * 1024 * 1024;
+    // 每写入这么多条后顺带保存一次索引，异常退出时最多需要重扫这部分
+    static const int SYNC_INTERVAL = 256;
+};
+
+inline size_t qHash(const ThumbnailStore::Key &key, size_t seed = 0) {
+    return qHash(key.low ^ key.high, seed);
+}